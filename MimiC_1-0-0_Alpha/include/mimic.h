@@ -35,6 +35,12 @@
   #define MIMIC_HAS_FPU         0
 #endif
 
+// Current core from the SIO CPUID register (same address on both chips).
+// Cheap enough for per-core state in code that doesn't pull in the SDK.
+#ifndef MIMIC_CORE_ID
+  #define MIMIC_CORE_ID()       (*(volatile const uint32_t*)0xD0000000u)
+#endif
+
 // ============================================================================
 // MEMORY LAYOUT
 // ============================================================================
@@ -51,6 +57,8 @@
   #define MIMIC_MAX_MEM_BLOCKS  64
 #endif
 
+#define MIMIC_CORE1_STACK       (8 * 1024)  // Compiler recursion needs > 2KB
+
 #define MIMIC_MEM_ALIGN         32
 #define MIMIC_MIN_BLOCK_SPLIT   64
 #define MIMIC_KERNEL_RESERVE    (8 * 1024)
@@ -68,12 +76,18 @@
 #define MIMI_ARCH_RISCV         2
 #define MIMI_ARCH_THUMB         0   // Alias for Cortex-M0+
 
+// Header flags
+#define MIMI_FLAG_RECURSIVE     0x01    // Call graph has a cycle; stack is a guess
+#define MIMI_FLAG_HEAP_HINT     0x02    // heap_request is exact, even if 0
+#define MIMI_FLAG_EXTERN_CALLS  0x04    // Calls a function defined in another unit
+
 // Section IDs
 #define MIMI_SECT_NULL          0
 #define MIMI_SECT_TEXT          1
 #define MIMI_SECT_RODATA        2
 #define MIMI_SECT_DATA          3
 #define MIMI_SECT_BSS           4
+#define MIMI_SECT_PIO           5
 
 // Binary header - 64 bytes
 typedef struct __attribute__((packed)) {
@@ -98,7 +112,8 @@ typedef struct __attribute__((packed)) {
     
     char     name[16];
     
-    uint32_t _reserved[2];
+    uint32_t pio_size;          // PIO programs, between .rodata and .data
+    uint32_t _reserved;
 } MimiHeader;
 
 // Relocation types
@@ -123,6 +138,22 @@ typedef struct __attribute__((packed)) {
 #define MIMI_SYM_EXTERN         2
 #define MIMI_SYM_SYSCALL        3
 
+// PIO program - 8 bytes, followed by length 16-bit instructions. The PIO
+// section is a sequence of these, numbered from 0 in order.
+#define MIMI_PIO_MAX_INSTR      32
+#define MIMI_PIO_SIDESET_OPT    0x01
+#define MIMI_PIO_SIDESET_PINDIRS 0x02
+
+typedef struct __attribute__((packed)) {
+    uint8_t  length;            // Instructions that follow
+    int8_t   origin;            // Fixed load offset, -1 = anywhere
+    uint8_t  wrap_target;
+    uint8_t  wrap;
+    uint8_t  sideset_bits;      // Excluding the enable bit of an optional side-set
+    uint8_t  sideset_flags;
+    uint16_t _pad;
+} MimiPioProgram;
+
 // Symbol entry - 24 bytes
 typedef struct __attribute__((packed)) {
     char     name[16];
@@ -145,6 +176,10 @@ typedef enum {
     TASK_STATE_ZOMBIE
 } MimicTaskState;
 
+// Kernel thread body - called once per time slice from the scheduler.
+// Return MIMIC_ERR_BUSY to be rescheduled, anything else to exit.
+typedef int (*MimicKThreadFn)(void* arg);
+
 typedef struct {
     uintptr_t base;
     uint32_t  total_size;
@@ -153,6 +188,8 @@ typedef struct {
     uint32_t  text_size;
     uint32_t  rodata_start;
     uint32_t  rodata_size;
+    uint32_t  pio_start;
+    uint32_t  pio_size;
     uint32_t  data_start;
     uint32_t  data_size;
     uint32_t  bss_start;
@@ -162,6 +199,7 @@ typedef struct {
     uint32_t  heap_size;
     uint32_t  heap_used;
     
+    uint32_t  guard_start;          // MIMIC_STACK_GUARD bytes below the stack
     uint32_t  stack_top;
     uint32_t  stack_size;
 } MimicTaskMem;
@@ -176,6 +214,9 @@ typedef struct {
     void*           entry;
     MimicTaskMem    mem;
     
+    MimicKThreadFn  kthread;        // Non-NULL for kernel threads
+    void*           kthread_arg;
+    
     uint32_t        wake_time;
     uint32_t        time_slice;
     uint32_t        total_time_us;
@@ -223,6 +264,8 @@ typedef struct {
 #define MIMIC_SYS_PUTCHAR       30
 #define MIMIC_SYS_GETCHAR       31
 #define MIMIC_SYS_PUTS          32
+#define MIMIC_SYS_OUT_WRITE     33  // (buf, len) -> bytes accepted
+#define MIMIC_SYS_OUT_MODE      34  // (MIMIC_OUT_*) -> previous mode
 
 #define MIMIC_SYS_GPIO_INIT     40
 #define MIMIC_SYS_GPIO_DIR      41
@@ -230,24 +273,207 @@ typedef struct {
 #define MIMIC_SYS_GPIO_GET      43
 #define MIMIC_SYS_GPIO_PULL     44
 
-#define MIMIC_SYS_PWM_INIT      50
-#define MIMIC_SYS_PWM_SET_WRAP  51
-#define MIMIC_SYS_PWM_SET_LEVEL 52
-#define MIMIC_SYS_PWM_ENABLE    53
+#define MIMIC_SYS_PWM_INIT      50  // (pin) -> slice
+#define MIMIC_SYS_PWM_SET_WRAP  51  // (pin, wrap)
+#define MIMIC_SYS_PWM_SET_LEVEL 52  // (pin, level)
+#define MIMIC_SYS_PWM_ENABLE    53  // (pin, on)
+
+#define MIMIC_SYS_ADC_INIT      60  // (pin, or 0 for none)
+#define MIMIC_SYS_ADC_SELECT    61  // (input)
+#define MIMIC_SYS_ADC_READ      62  // () -> 12-bit sample
+#define MIMIC_SYS_ADC_TEMP      63  // () -> die temperature, milli-degrees C
+#define MIMIC_SYS_ADC_STREAM    64  // (uint16_t* ring, samples, rate_hz)
+#define MIMIC_SYS_ADC_POS       65  // (timeout_ms) -> samples written so far
+#define MIMIC_SYS_ADC_STOP      66
+
+// SPI/I2C reads and writes start a DMA transfer straight between the
+// peripheral and the user buffer and return a handle at once. IO_WAIT
+// blocks until it finishes and returns the byte count (or an error).
+#define MIMIC_SYS_SPI_INIT      70  // (port, baud, sck | mosi << 8 | miso << 16)
+#define MIMIC_SYS_SPI_WRITE     71  // (port, buf, len) -> handle
+#define MIMIC_SYS_SPI_READ      72  // (port, buf, len) -> handle
+#define MIMIC_SYS_SPI_TRANSFER  73  // (port, tx, rx, len) -> handle
+
+#define MIMIC_SYS_I2C_INIT      80  // (port, baud, sda | scl << 8)
+#define MIMIC_SYS_I2C_WRITE     81  // (port, addr, buf, len) -> handle
+#define MIMIC_SYS_I2C_READ      82  // (port, addr, buf, len) -> handle
+
+#define MIMIC_SYS_IO_WAIT       85  // (handle, timeout_ms) -> bytes moved
+
+#define MIMIC_SYS_PERF_READ     90  // (first id, uint32_t* out, count) -> count
+
+#define MIMIC_SYS_CHAN_OPEN     100 // (name, size, role) -> channel id
+#define MIMIC_SYS_CHAN_MAP      101 // (id) -> MimicChanRing*
+#define MIMIC_SYS_CHAN_WAIT     102 // (id, timeout_ms) -> bytes ready
+#define MIMIC_SYS_CHAN_NOTIFY   103 // (id) wake the peer if it waits
+#define MIMIC_SYS_CHAN_CLOSE    104 // (id)
+
+#define MIMIC_SYS_IRQ_ATTACH    110 // (source, param, handler) -> irq id
+#define MIMIC_SYS_IRQ_DETACH    111 // (id)
+#define MIMIC_SYS_IRQ_WAIT      112 // (id, timeout_ms) -> event data
+
+#define MIMIC_SYS_PIO_CLAIM     120 // (pio, or -1 for any) -> state machine
+#define MIMIC_SYS_PIO_LOAD      121 // (sm, const MimicPioConfig*) -> program offset
+#define MIMIC_SYS_PIO_PUT       122 // (sm, const uint32_t* words, count) -> io handle
+#define MIMIC_SYS_PIO_GET       123 // (sm, uint32_t* words, count) -> io handle
+#define MIMIC_SYS_PIO_RELEASE   124 // (sm)
+
+// ============================================================================
+// TASK PRIORITIES (lower value = higher priority)
+// ============================================================================
+
+#define MIMIC_PRIO_REALTIME     0
+#define MIMIC_PRIO_USER         10
+#define MIMIC_PRIO_BACKGROUND   200
+#define MIMIC_PRIO_IDLE         255
+
+#define MIMIC_KTHREAD_SLICE_US  2000    // Budget before a kthread should yield
+
+// ============================================================================
+// BOOT
+// ============================================================================
+
+// At reset the kernel mounts the card once and starts every .mimi listed
+// in the autorun file (one path per line, '#' comments) before anything
+// else; USB and the shell banner come up afterwards on a kernel thread.
+// Anything printed before then is held in RAM and replayed once the host
+// is connected.
+
+#define MIMIC_AUTORUN_FILE      "/mimic/autorun"
+#define MIMIC_AUTORUN_MAX       8       // Programs started at boot
+#define MIMIC_AUTORUN_LIST      512     // Bytes of the autorun file read
+#define MIMIC_CONSOLE_POLL_MS   20      // Host connection poll while booting
+#define MIMIC_BOOT_LOG_SIZE     2048    // Early output held for the console
+
+// ============================================================================
+// MEMORY PROTECTION
+// ============================================================================
+
+// Task images are laid out code | data | bss | heap | guard | stack. While
+// a task is current the MPU makes the guard inaccessible and everything
+// from .data up non-executable, and user code runs on its own stack (PSP),
+// so an overflow faults on the spot and the task is killed.
+
+#if MIMIC_TARGET_RP2350
+  #define MIMIC_STACK_GUARD     32      // PMSAv8 granule
+#else
+  #define MIMIC_STACK_GUARD     256     // Smallest ARMv6-M region
+#endif
+
+// Stacks are painted at load so the deepest use can be read back later
+// ('tasks -v'). Build with MIMIC_STACK_PAINT=0 to drop the fill and scan.
+#ifndef MIMIC_STACK_PAINT
+  #define MIMIC_STACK_PAINT     1
+#endif
+#define MIMIC_STACK_PAINT_WORD  0x5AC75AC7u
+#define MIMIC_STACK_MARGIN      64      // Kept above the peak in suggestions
 
-#define MIMIC_SYS_ADC_INIT      60
-#define MIMIC_SYS_ADC_SELECT    61
-#define MIMIC_SYS_ADC_READ      62
-#define MIMIC_SYS_ADC_TEMP      63
+// ============================================================================
+// PERIPHERAL I/O
+// ============================================================================
 
-#define MIMIC_SYS_SPI_INIT      70
-#define MIMIC_SYS_SPI_WRITE     71
-#define MIMIC_SYS_SPI_READ      72
-#define MIMIC_SYS_SPI_TRANSFER  73
+// ADC streaming free-runs the converter into a user ring of 16-bit
+// samples with no CPU involvement per sample. ADC_POS returns the total
+// written so far; sample n lives at ring[n % samples]. A reader that falls
+// more than one ring behind has lost data. With a timeout, ADC_POS first
+// waits for the next half of the ring to fill.
 
-#define MIMIC_SYS_I2C_INIT      80
-#define MIMIC_SYS_I2C_WRITE     81
-#define MIMIC_SYS_I2C_READ      82
+#define MIMIC_IO_MAX_XFERS      4       // DMA transfers in flight
+#define MIMIC_IO_SD_SPI         0       // SPI port owned by the SD card
+#define MIMIC_ADC_MAX_RATE      500000  // Samples per second
+
+// ============================================================================
+// TASK OUTPUT
+// ============================================================================
+
+// Task console output (PUTCHAR, PUTS, OUT_WRITE) goes into a per-task
+// buffer that the kernel loop drains to stdio in batches, never faster
+// than USB CDC can take it. When the buffer is full, DROP discards the
+// excess and BLOCK drains the buffer from inside the call until the rest
+// fits. A console that takes nothing for MIMIC_OUT_BLOCK_MS ends the wait
+// and the remainder is dropped too. Drops are counted (out.dropped); the
+// calls always report the whole length.
+
+#define MIMIC_OUT_BUF_SIZE      256     // Per task, power of two
+#define MIMIC_OUT_BLOCK         0       // Default
+#define MIMIC_OUT_DROP          1
+#define MIMIC_OUT_BLOCK_MS      100     // Longest BLOCK wait without progress
+
+// ============================================================================
+// PIO
+// ============================================================================
+
+// A task claims a state machine, then loads one of the programs from its
+// own .mimi PIO section onto it. State machines are numbered pio * 4 + sm.
+// FIFO traffic goes by DMA (PIO_PUT/PIO_GET, completed with IO_WAIT).
+// Pins set to 0xFF, or with a count of 0, are left alone.
+
+typedef struct {
+    uint8_t  program;           // Index into the task's PIO section
+    uint8_t  out_base;
+    uint8_t  out_count;
+    uint8_t  set_base;
+    uint8_t  set_count;
+    uint8_t  sideset_base;
+    uint8_t  in_base;
+    uint8_t  jmp_pin;
+    uint8_t  out_shift;         // MIMIC_PIO_SHIFT_* | threshold (0 = 32)
+    uint8_t  in_shift;
+    uint8_t  fifo_join;         // 0 none, 1 TX, 2 RX
+    uint8_t  _pad;
+    uint32_t clkdiv;            // 16.8 fixed point, 0 = full speed
+} MimicPioConfig;
+
+#define MIMIC_PIO_SHIFT_RIGHT   0x80
+#define MIMIC_PIO_SHIFT_AUTO    0x40    // Autopull (out) / autopush (in)
+#define MIMIC_PIO_PIN_NONE      0xFF
+
+// ============================================================================
+// CHANNELS
+// ============================================================================
+
+// Single-producer/single-consumer byte ring shared by two tasks. Both map
+// the same memory and move data without syscalls: the producer writes at
+// head and then advances it, the consumer reads at tail and advances it.
+// head/tail count bytes ever transferred (index with & (size - 1)). The
+// kernel is only entered to sleep (CHAN_WAIT) and, if the peer's
+// waiting flag is set, to wake it (CHAN_NOTIFY).
+
+#define MIMIC_MAX_CHANNELS      8
+#define MIMIC_CHAN_MAX_SIZE     (16 * 1024)
+
+#define MIMIC_CHAN_PRODUCER     0
+#define MIMIC_CHAN_CONSUMER     1
+
+typedef struct {
+    volatile uint32_t head;         // Written by the producer only
+    volatile uint32_t tail;         // Written by the consumer only
+    uint32_t          size;         // Data bytes, power of two
+    volatile uint8_t  waiting[2];   // Indexed by role; set while blocked
+    uint8_t           _pad[2];
+    uint8_t           data[];
+} MimicChanRing;
+
+// ============================================================================
+// USER INTERRUPTS
+// ============================================================================
+
+// A task attaches a handler to a hardware event source. The ISR only
+// timestamps the event into a queue; the kernel drains it at its next
+// poll or kthread preemption point and calls handler(id, data) on behalf
+// of the owning task. With handler == 0 the task collects events with
+// IRQ_WAIT instead. Event data per source:
+//   GPIO   param = pin | edges << 8 (GPIO_IRQ_EDGE_*)   data = pin | edges << 8
+//   TIMER  param = period in us                        data = fire count
+//   PIO    param = pio << 8 | irq flag (0-3)           data = param
+
+#define MIMIC_IRQ_MAX_HANDLERS  8
+#define MIMIC_IRQ_QUEUE         32      // Pending events, power of two
+#define MIMIC_IRQ_MIN_PERIOD_US 100
+
+#define MIMIC_IRQ_SRC_GPIO      0
+#define MIMIC_IRQ_SRC_TIMER     1
+#define MIMIC_IRQ_SRC_PIO       2
 
 // ============================================================================
 // ERROR CODES
@@ -265,6 +491,7 @@ typedef struct {
 #define MIMIC_ERR_TOOLARGE      (-9)
 #define MIMIC_ERR_NOEXEC        (-10)
 #define MIMIC_ERR_NOTDIR        (-11)
+#define MIMIC_ERR_FAULT         (-12)   // Task hit its stack guard or took a fault
 
 // ============================================================================
 // KERNEL API
@@ -287,6 +514,67 @@ void  mimic_task_exit(int code);
 void  mimic_task_yield(void);
 void  mimic_task_sleep(uint32_t ms);
 void  mimic_task_kill(uint32_t task_id);
+int   mimic_task_find(const char* name);
+MimicTCB* mimic_task_get(uint32_t task_id);
+void  mimic_task_block(uint32_t timeout_ms);
+void  mimic_task_wake(uint32_t task_id);
+int32_t mimic_task_call(uint32_t task_id, uint32_t fn, uint32_t a0, uint32_t a1);
+
+int   mimic_chan_open(uint32_t task_id, const char* name, uint32_t size, uint32_t role);
+MimicChanRing* mimic_chan_map(uint32_t task_id, int id);
+int   mimic_chan_wait(uint32_t task_id, int id, uint32_t timeout_ms);
+int   mimic_chan_notify(uint32_t task_id, int id);
+int   mimic_chan_close(uint32_t task_id, int id);
+void  mimic_chan_release_task(uint32_t task_id);
+
+int   mimic_irq_attach(uint32_t task_id, uint32_t source, uint32_t param, uint32_t handler);
+int   mimic_irq_detach(uint32_t task_id, int id);
+int   mimic_irq_wait(uint32_t task_id, int id, uint32_t timeout_ms);
+bool  mimic_irq_pending(void);
+void  mimic_irq_dispatch(void);
+void  mimic_irq_release_task(uint32_t task_id);
+void  mimic_irq_dump(void);
+
+int32_t mimic_io_syscall(uint32_t task_id, uint32_t num,
+                         uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+void  mimic_io_poll(void);
+void  mimic_io_release_task(uint32_t task_id);
+int   mimic_io_pio_xfer(uint32_t task_id, uint32_t pio, uint32_t sm,
+                        const uint32_t* tx, uint32_t* rx, uint32_t count);
+void  mimic_io_pio_abort(uint32_t pio, uint32_t sm);
+
+int   mimic_out_write(uint32_t task_id, const void* buf, uint32_t len);
+int   mimic_out_set_mode(uint32_t task_id, uint32_t mode);
+void  mimic_out_flush(void);
+void  mimic_out_flush_task(uint32_t task_id);
+void  mimic_out_release_task(uint32_t task_id);
+
+int32_t mimic_pio_syscall(uint32_t task_id, uint32_t num,
+                          uint32_t a0, uint32_t a1, uint32_t a2);
+void  mimic_pio_release_task(uint32_t task_id);
+
+void  mimic_mpu_init(void);
+void  mimic_mpu_report(void);
+void  mimic_mpu_switch(const MimicTCB* task);
+int32_t mimic_mpu_call(const MimicTCB* task, uint32_t fn, uint32_t a0, uint32_t a1);
+int   mimic_mpu_take_fault(uint32_t* pc);
+void  mimic_mpu_release_task(uint32_t task_id);
+
+int   mimic_kthread_spawn(const char* name, uint8_t priority,
+                          MimicKThreadFn fn, void* arg);
+void  mimic_kthread_sleep(uint32_t ms);
+bool  mimic_kthread_should_yield(void);
+void  mimic_kthread_preempt_point(void);
+void  mimic_kernel_poll(void);
+
+// Run one function at a time on core 1. Submit returns MIMIC_ERR_BUSY if
+// core 1 is occupied; poll returns MIMIC_ERR_BUSY until it has finished.
+int   mimic_core1_submit(MimicKThreadFn fn, void* arg);
+int   mimic_core1_poll(int* result);
+
+// True while core 1 has no job; it then runs only from RAM, so flash may
+// be erased or programmed
+bool  mimic_core1_idle(void);
 
 int   mimic_load_binary(const char* path, MimicTCB* task);
 int   mimic_validate_header(const MimiHeader* hdr);
@@ -296,7 +584,10 @@ uint32_t mimic_get_task_count(void);
 float    mimic_get_cpu_usage(void);
 uint32_t mimic_get_uptime_ms(void);
 
+uint32_t mimic_task_stack_peak(const MimicTCB* task);
+
 void mimic_dump_tasks(void);
+void mimic_dump_stacks(void);
 void mimic_dump_memory(void);
 
 // ============================================================================
@@ -318,4 +609,80 @@ void mimic_dump_memory(void);
 #define MIMIC_EXT_OBJ           ".o"
 #define MIMIC_EXT_MIMI          ".mimi"
 
+// ============================================================================
+// COMPILER API
+// ============================================================================
+
+typedef struct {
+    bool        active;
+    int         task_id;        // Kernel thread running the job, -1 if sync
+    int         result;         // Final status once !active
+    uint32_t    line;
+    uint32_t    tokens;
+    uint32_t    functions;
+    uint32_t    bytes_in;       // Source bytes consumed so far
+    uint32_t    bytes_total;    // Source file size
+    uint32_t    bytes_out;
+    uint32_t    elapsed_ms;
+    char        input[64];
+    char        output[64];
+} MimicCompileProgress;
+
+typedef struct MimicCompiler MimicCompiler;
+
+// Incremental interface: begin, step until it stops returning
+// MIMIC_ERR_BUSY (one top-level declaration per call), then end.
+MimicCompiler* mimic_compile_begin(const char* input, const char* output, int* err);
+int         mimic_compile_step(MimicCompiler* c);
+int         mimic_compile_end(MimicCompiler* c);
+
+int         mimic_compile(const char* input, const char* output);
+int         mimic_compile_bg(const char* input, const char* output);
+
+// Compile into a kernel-heap .mimi image instead of a file; output only
+// names the program. On success the caller owns *image (mimic_kfree).
+int         mimic_compile_mem(const char* input, const char* output,
+                              uint8_t** image, uint32_t* size);
+int         mimic_compile_progress(MimicCompileProgress* progress);
+const char* mimic_compile_error(void);
+
+// Called from mimic_task_kill(): a killed 'cc -b' thread ends its job
+void        mimic_compile_release_task(uint32_t task_id);
+
+// ============================================================================
+// BUILD SERVICES
+// ============================================================================
+
+#define MIMIC_WATCH_MAX_FILES   32      // .c/.h files tracked in SRC_DIR
+#define MIMIC_WATCH_PERIOD_MS   2000
+
+typedef struct {
+    bool        running;
+    bool        hot_restart;
+    int         task_id;
+    uint32_t    files;
+    uint32_t    pending;        // Sources waiting to be rebuilt
+    uint32_t    scans;
+    uint32_t    rebuilds;
+    uint32_t    failures;
+    uint32_t    restarts;
+} MimicWatchStatus;
+
+#define MIMIC_MAKE_MAX_UNITS    32      // Translation units per manifest
+#define MIMIC_MAKE_MANIFEST     MIMIC_CC_SRC_DIR "/project.mk"
+#define MIMIC_LINK_MAX_SYMBOLS  128
+
+int  mimic_make(const char* manifest);
+
+// Write a kernel-heap buffer to the card from a background thread, then
+// mimic_kfree() it. Ownership passes to the persist queue even on error.
+#define MIMIC_PERSIST_QUEUE     4
+#define MIMIC_PERSIST_CHUNK     512     // Bytes written per slice
+
+int  mimic_persist(const char* path, uint8_t* data, uint32_t size);
+
+int  mimic_watch_start(bool hot_restart);
+void mimic_watch_stop(void);
+void mimic_watch_status(MimicWatchStatus* status);
+
 #endif // MIMIC_H
@@ -0,0 +1,115 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC Block Devices - What the filesystem reads sectors from             ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  SD over SPI, RAM disk, QSPI flash region                                 ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * A device is a vtable of batched sector operations plus its size. FAT32
+ * mounts whichever device it is given, so the same filesystem and compiler
+ * code can run against a RAM disk or a region of the boot flash as well as
+ * the card.
+ * 
+ * Sectors are always 512 bytes. Operations return MIMIC_OK or a
+ * MIMIC_ERR_* code and either transfer every sector or fail.
+ */
+
+#ifndef MIMIC_BLOCKDEV_H
+#define MIMIC_BLOCKDEV_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "mimic.h"
+
+#define MIMIC_BDEV_SECTOR       512
+
+typedef struct MimicBlockDev MimicBlockDev;
+
+typedef struct {
+    int (*init)(MimicBlockDev* dev);        // NULL: nothing to bring up
+    int (*read)(MimicBlockDev* dev, uint32_t sector, uint8_t* buf, uint32_t count);
+    int (*write)(MimicBlockDev* dev, uint32_t sector, const uint8_t* buf, uint32_t count);
+    int (*flush)(MimicBlockDev* dev);       // NULL: writes are durable on return
+    int (*discard)(MimicBlockDev* dev, uint32_t sector, uint32_t count);   // NULL: can't
+} MimicBlockOps;
+
+struct MimicBlockDev {
+    const char*             name;
+    const MimicBlockOps*    ops;
+    uint32_t                sector_count;   // 0 = unknown, no range check
+    void*                   ctx;
+};
+
+// ============================================================================
+// DISPATCH
+// ============================================================================
+
+static inline bool mimic_bdev_in_range(const MimicBlockDev* dev, uint32_t sector,
+                                       uint32_t count) {
+    return dev->sector_count == 0 ||
+           (sector < dev->sector_count && count <= dev->sector_count - sector);
+}
+
+static inline int mimic_bdev_init(MimicBlockDev* dev) {
+    return dev->ops->init ? dev->ops->init(dev) : MIMIC_OK;
+}
+
+static inline int mimic_bdev_read(MimicBlockDev* dev, uint32_t sector,
+                                  uint8_t* buf, uint32_t count) {
+    if (!mimic_bdev_in_range(dev, sector, count)) return MIMIC_ERR_INVAL;
+    return dev->ops->read(dev, sector, buf, count);
+}
+
+static inline int mimic_bdev_write(MimicBlockDev* dev, uint32_t sector,
+                                   const uint8_t* buf, uint32_t count) {
+    if (!mimic_bdev_in_range(dev, sector, count)) return MIMIC_ERR_INVAL;
+    return dev->ops->write(dev, sector, buf, count);
+}
+
+static inline int mimic_bdev_flush(MimicBlockDev* dev) {
+    return dev->ops->flush ? dev->ops->flush(dev) : MIMIC_OK;
+}
+
+// Tell the device a range holds nothing worth keeping, so it can erase
+// ahead of the next write. Contents read back undefined afterwards.
+static inline int mimic_bdev_discard(MimicBlockDev* dev, uint32_t sector, uint32_t count) {
+    if (!mimic_bdev_in_range(dev, sector, count)) return MIMIC_ERR_INVAL;
+    return dev->ops->discard ? dev->ops->discard(dev, sector, count) : MIMIC_ERR_NOSYS;
+}
+
+// ============================================================================
+// BACKENDS
+// ============================================================================
+
+// The SD card on SPI0 (multi-block CMD18/CMD25 for batches, CMD32/33/38
+// erase for discard)
+extern MimicBlockDev mimic_bdev_sd;
+
+// Plain memory, e.g. a kmalloc'd buffer or a static array
+int mimic_bdev_ram_init(MimicBlockDev* dev, void* mem, uint32_t sectors);
+
+// A 4 KB-aligned region of the boot flash, offset from its start. Writes
+// collect in one erase block in RAM and are programmed on flush or when
+// another block is touched; flushing needs core 1 idle (it parks in RAM).
+int mimic_bdev_flash_init(MimicBlockDev* dev, uint32_t offset, uint32_t size);
+
+// ============================================================================
+// I/O SCHEDULER
+// ============================================================================
+
+#if MIMIC_TARGET_RP2350
+  #define MIMIC_IOSCHED_SLOTS   32
+#else
+  #define MIMIC_IOSCHED_SLOTS   8
+#endif
+#define MIMIC_IOSCHED_DELAY_MS  50      // Write-behind window before a drain
+
+// Put a write-behind queue in front of lower (one at a time). Writes are
+// drained in LBA order with adjacent sectors merged; flush drains at once.
+// Returns lower itself if the queue can't be allocated.
+MimicBlockDev* mimic_iosched_attach(MimicBlockDev* lower);
+uint32_t       mimic_iosched_pending(void);
+
+#endif // MIMIC_BLOCKDEV_H
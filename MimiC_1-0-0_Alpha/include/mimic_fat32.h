@@ -13,6 +13,8 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+#include "mimic_blockdev.h"
+
 // ============================================================================
 // SD CARD CONFIGURATION
 // ============================================================================
@@ -42,8 +44,12 @@
 #define SD_CMD18            18
 #define SD_CMD24            24
 #define SD_CMD25            25
+#define SD_CMD32            32
+#define SD_CMD33            33
+#define SD_CMD38            38
 #define SD_CMD55            55
 #define SD_CMD58            58
+#define SD_CMD59            59
 #define SD_ACMD41           41
 
 // SD Card types
@@ -137,7 +143,9 @@ typedef struct __attribute__((packed)) {
 
 typedef struct {
     uint8_t     card_type;
-    bool        initialized;
+    bool        initialized;        // SD card brought up
+    bool        mounted;
+    MimicBlockDev* dev;
     
     uint32_t    partition_start;    // LBA of partition start (0 for superfloppy)
     uint32_t    sectors_per_cluster;
@@ -171,6 +179,8 @@ typedef struct {
     uint32_t    cluster_offset;
     uint32_t    file_size;
     uint32_t    position;
+    uint32_t    map_cluster;        // Last cluster mimic_fmap() walked to
+    uint32_t    map_index;          // Its index in the chain
     char        path[MIMIC_MAX_PATH];
 } MimicFile;
 
@@ -180,6 +190,7 @@ typedef struct {
 #define MIMIC_FILE_APPEND   0x04
 #define MIMIC_FILE_CREATE   0x08
 #define MIMIC_FILE_TRUNC    0x10
+#define MIMIC_FILE_LOG      0x20    // Append-only data log (mimic_log.h)
 
 // Seek modes
 #define MIMIC_SEEK_SET      0
@@ -196,17 +207,83 @@ int mimic_sd_read_sector(uint32_t sector, uint8_t* buf);
 int mimic_sd_write_sector(uint32_t sector, const uint8_t* buf);
 int mimic_sd_read_sectors(uint32_t sector, uint8_t* buf, uint32_t count);
 int mimic_sd_write_sectors(uint32_t sector, const uint8_t* buf, uint32_t count);
+int mimic_sd_sync(void);                        // Writes return before programming ends
+int mimic_sd_erase(uint32_t sector, uint32_t count);
 uint8_t mimic_sd_get_type(void);
+
+typedef struct {
+    bool        crc;                // CMD59 accepted: blocks are CRC-checked
+    uint32_t    baud;               // Current SPI clock
+    uint32_t    read_crc_errors;    // Block CRC mismatches on reads
+    uint32_t    write_crc_errors;   // Blocks the card rejected for CRC
+    uint32_t    cmd_crc_errors;     // Commands the card rejected for CRC
+    uint32_t    retries;
+    uint32_t    failures;           // Transfers that failed every attempt
+} MimicSdStats;
+
+void mimic_sd_get_stats(MimicSdStats* stats);  // Since the card was initialised
 uint64_t mimic_sd_get_size(void);
 
 // ============================================================================
 // FAT32 API
 // ============================================================================
 
-int mimic_fat32_mount(void);
+int mimic_fat32_mount(void);                    // The SD card, via the I/O scheduler
+int mimic_fat32_mount_dev(MimicBlockDev* dev);
 void mimic_fat32_unmount(void);
 bool mimic_fat32_mounted(void);
 
+// Straight to the FAT32 volume, bypassing the tmpfs mount (used to spill)
+int mimic_fat32_fopen(const char* path, uint8_t mode);
+
+// Clusters freed by truncation are erased by the "erase" kernel thread
+// once the FS has been idle for MIMIC_ERASE_IDLE_MS, at most
+// MIMIC_ERASE_MAX_SECTORS per command and one command per
+// MIMIC_ERASE_INTERVAL_MS, so a later write lands on pre-erased blocks.
+#define MIMIC_ERASE_RUNS        8       // Freed runs remembered; more are dropped
+#define MIMIC_ERASE_IDLE_MS     500
+#define MIMIC_ERASE_INTERVAL_MS 100
+#define MIMIC_ERASE_MAX_SECTORS 256     // Bounds the card's busy time per erase
+
+uint32_t mimic_fat32_erase_pending(void);       // Clusters still to erase
+
+// Directories of at least MIMIC_DIR_INDEX_MIN entries (MIMIC_CC_BIN_DIR
+// with its cached binaries) get an in-RAM hash index of name to entry
+// position plus a list of free entries, so opens and creates skip the
+// linear scan. Creates update the index in place; unmount drops them all.
+// The least recently used index is reused for the next big directory.
+#ifndef MIMIC_DIR_INDEX_DIRS
+  #if MIMIC_TARGET_RP2350
+    #define MIMIC_DIR_INDEX_DIRS    4
+    #define MIMIC_DIR_INDEX_SLOTS   2048    // Power of two, filled to 3/4
+  #else
+    #define MIMIC_DIR_INDEX_DIRS    2
+    #define MIMIC_DIR_INDEX_SLOTS   1024
+  #endif
+#endif
+#define MIMIC_DIR_INDEX_MIN     64      // Smaller directories are just scanned
+#define MIMIC_DIR_INDEX_CHAIN   32      // Clusters; longer directories are scanned
+#define MIMIC_DIR_INDEX_FREE    16      // Free entries listed; a rescan finds more
+
+// Raw extents, for the data logger (mimic_log.c), which writes whole
+// sectors straight to the device and only touches the FAT to grow.
+// extend makes the chain cover at least bytes, appending contiguous runs;
+// it returns the bytes allocated. extent maps a file offset inside the
+// chain to its device sector and the number of physically contiguous
+// sectors from there (at most max). set_size rewrites the directory
+// entry; trim frees clusters past the recorded size.
+int mimic_fat32_extend(int fd, uint32_t bytes);
+int mimic_fat32_extent(int fd, uint32_t offset, uint32_t max, uint32_t* sector, uint32_t* count);
+int mimic_fat32_write_raw(uint32_t sector, const void* buf, uint32_t count);
+int mimic_fat32_set_size(int fd, uint32_t size);
+int mimic_fat32_trim(int fd);
+
+// The FS lock, for code that touches the mounted device outside the FS
+// entry points. Kernel threads use try_lock, which never blocks.
+void mimic_fs_lock(void);
+bool mimic_fs_try_lock(void);
+void mimic_fs_unlock(void);
+
 int mimic_fopen(const char* path, uint8_t mode);
 int mimic_fclose(int fd);
 int mimic_fread(int fd, void* buf, size_t size);
@@ -231,6 +308,7 @@ bool mimic_is_dir(const char* path);
 typedef struct {
     char        name[256];
     uint32_t    size;
+    uint32_t    mtime;      // FAT write date << 16 | write time
     uint8_t     attr;
     bool        is_dir;
 } MimicDirEntry;
@@ -255,6 +333,34 @@ typedef struct {
 
 int mimic_fs_info(MimicFSInfo* info);
 
+// ============================================================================
+// MAPPED VIEWS
+// ============================================================================
+
+// Read-only views straight into a small pool of cached sectors. A view
+// never crosses a sector, so view->len may be shorter than asked for
+// (0 at or past end of file); callers loop. Mapped sectors are pinned and
+// not evicted until mimic_funmap(). Writing a sector while it is mapped
+// detaches the view: it keeps the old bytes, new maps see the new ones.
+// tmpfs handles return MIMIC_ERR_NOSYS; use mimic_fread for those.
+
+#ifndef MIMIC_FMAP_SLOTS
+  #if MIMIC_TARGET_RP2350
+    #define MIMIC_FMAP_SLOTS    8
+  #else
+    #define MIMIC_FMAP_SLOTS    4
+  #endif
+#endif
+
+typedef struct {
+    const uint8_t*  data;
+    uint32_t        len;
+    int             slot;           // Internal; -1 when nothing is mapped
+} MimicFileView;
+
+int mimic_fmap(int fd, uint32_t offset, uint32_t len, MimicFileView* view);
+void mimic_funmap(MimicFileView* view);
+
 // ============================================================================
 // STREAMING I/O FOR COMPILER
 // ============================================================================
@@ -278,6 +384,12 @@ int mimic_stream_putc(MimicStream* stream, int c);
 int mimic_stream_puts(MimicStream* stream, const char* s);
 int mimic_stream_read(MimicStream* stream, void* buf, size_t size);
 int mimic_stream_write(MimicStream* stream, const void* buf, size_t size);
+
+// Zero-copy reading: peek exposes the unread buffered bytes in place,
+// refilling first if there are none (*len 0 at end of file); consume
+// advances past n of them. The window is valid until the next call.
+int mimic_stream_peek(MimicStream* stream, const uint8_t** ptr, uint32_t* len);
+int mimic_stream_consume(MimicStream* stream, uint32_t n);
 int mimic_stream_flush(MimicStream* stream);
 bool mimic_stream_eof(MimicStream* stream);
 
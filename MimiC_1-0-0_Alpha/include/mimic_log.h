@@ -0,0 +1,71 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC Data Logger - Append-only files fed from a RAM ring                ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  Opened with MIMIC_FILE_LOG through the ordinary mimic_fopen API          ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * A write to a log only copies into that log's ring and returns; it never
+ * touches the card, so a task logging from a sensor loop is not held up
+ * by SD latency. If the ring is full the write is short and the overrun
+ * is counted (log.dropped).
+ * 
+ * The "logger" kernel thread drains whole sectors from the ring with one
+ * multi-block write per contiguous extent. Space is preallocated ahead of
+ * the write point in contiguous cluster runs, so the FAT is only touched
+ * when an extent is added, never per write. The directory entry's size
+ * is brought up to date every MIMIC_LOG_CHECKPOINT_MS; a reset loses at
+ * most that much. mimic_fflush and mimic_fclose write the partial last
+ * sector and record the exact size; close also frees the unused
+ * preallocation.
+ * 
+ * Logs are write-only: read them back after closing.
+ */
+
+#ifndef MIMIC_LOG_H
+#define MIMIC_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "mimic.h"
+
+// ============================================================================
+// CONFIGURATION
+// ============================================================================
+
+#define MIMIC_LOG_MAX           2
+#define MIMIC_LOG_PERIOD_MS     5           // Drain interval
+#define MIMIC_LOG_CHECKPOINT_MS 1000        // Directory size update interval
+#define MIMIC_LOG_EXTENT        (64 * 1024) // Preallocated ahead of the data
+
+// Per open log, from the kernel heap; a power of two, at least a sector
+#ifndef MIMIC_LOG_RING
+  #if MIMIC_TARGET_RP2350
+    #define MIMIC_LOG_RING      (32 * 1024)
+  #else
+    #define MIMIC_LOG_RING      (8 * 1024)
+  #endif
+#endif
+
+// Descriptors in this range are logs (tmpfs uses the block below)
+#define MIMIC_LOG_FD_BASE       80
+
+static inline bool mimic_log_fd(int fd) {
+    return fd >= MIMIC_LOG_FD_BASE && fd < MIMIC_LOG_FD_BASE + MIMIC_LOG_MAX;
+}
+
+// ============================================================================
+// API
+// ============================================================================
+
+// Called by the FS entry points for MIMIC_FILE_LOG opens and log fds.
+// mode may add MIMIC_FILE_TRUNC; otherwise the log appends.
+int     mimic_log_open(const char* path, uint8_t mode);
+int     mimic_log_close(int fd);
+int     mimic_log_write(int fd, const void* buf, size_t size);
+int     mimic_log_sync(int fd);
+int32_t mimic_log_size(int fd);
+
+#endif // MIMIC_LOG_H
@@ -0,0 +1,122 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC Perf - Kernel performance counters                                 ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  Per-core 32-bit counters, summed on read                                 ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * Each core only ever writes its own row, so counting needs no lock and is
+ * a single load/add/store. Readers sum the rows; values wrap at 2^32 and
+ * rates should be taken from differences. Counter ids are user ABI
+ * (MIMIC_SYS_PERF_READ): append new ones, never renumber.
+ */
+
+#ifndef MIMIC_PERF_H
+#define MIMIC_PERF_H
+
+#include <stdint.h>
+
+#include "mimic.h"
+
+// ============================================================================
+// COUNTERS
+// ============================================================================
+
+enum {
+    // Scheduler
+    MIMIC_PERF_SCHED_TICKS = 0,
+    MIMIC_PERF_SCHED_SWITCHES,
+    MIMIC_PERF_KTHREAD_SLICES,
+    MIMIC_PERF_KTHREAD_US,          // Time spent inside kernel-thread steps
+    MIMIC_PERF_KTHREAD_PREEMPTS,    // Slices run from a preemption point
+    MIMIC_PERF_TASKS_LOADED,
+    
+    // Allocator
+    MIMIC_PERF_KALLOCS,
+    MIMIC_PERF_KFREES,
+    MIMIC_PERF_UALLOCS,
+    MIMIC_PERF_UFREES,
+    MIMIC_PERF_ALLOC_BYTES,
+    MIMIC_PERF_ALLOC_FAILS,
+    
+    // Filesystem sector cache
+    MIMIC_PERF_FS_CACHE_HITS,
+    MIMIC_PERF_FS_CACHE_MISSES,
+    MIMIC_PERF_FS_WRITEBACKS,
+    
+    // SD card
+    MIMIC_PERF_SD_CMDS,
+    MIMIC_PERF_SD_READS,
+    MIMIC_PERF_SD_WRITES,
+    MIMIC_PERF_SD_READ_US,
+    MIMIC_PERF_SD_WRITE_US,
+    MIMIC_PERF_SD_ERRORS,
+    
+    // Syscalls
+    MIMIC_PERF_SYSCALLS,
+    
+    // Compiler
+    MIMIC_PERF_CC_JOBS,
+    MIMIC_PERF_CC_TOKENS,
+    MIMIC_PERF_CC_FUNCTIONS,
+    MIMIC_PERF_CC_BYTES,
+    MIMIC_PERF_CC_ERRORS,
+    
+    // User interrupts
+    MIMIC_PERF_IRQ_EVENTS,
+    MIMIC_PERF_IRQ_DROPPED,
+    MIMIC_PERF_IRQ_LATENCY_US,      // Sum of ISR-to-dispatch delays
+    
+    // Peripheral DMA
+    MIMIC_PERF_IO_XFERS,
+    MIMIC_PERF_IO_BYTES,
+    MIMIC_PERF_IO_ERRORS,
+    
+    // Task console output
+    MIMIC_PERF_OUT_BYTES,
+    MIMIC_PERF_OUT_DROPPED,
+    MIMIC_PERF_OUT_FLUSHES,
+    MIMIC_PERF_OUT_STALLS,          // Writes that blocked on a full buffer
+    
+    // Memory protection
+    MIMIC_PERF_MPU_SWITCHES,        // Region reprograms
+    MIMIC_PERF_MPU_FAULTS,          // Tasks killed by a protection fault
+    
+    // Write-behind I/O scheduler
+    MIMIC_PERF_IOSCHED_QUEUED,      // Distinct sectors queued for write-behind
+    MIMIC_PERF_IOSCHED_MERGED,      // Sectors written as part of a multi-block run
+    MIMIC_PERF_IOSCHED_DRAINS,
+    
+    // Background erase
+    MIMIC_PERF_FS_ERASED,           // Freed sectors erased in the background
+    
+    // Data logger
+    MIMIC_PERF_LOG_SECTORS,         // Written out by the data logger
+    MIMIC_PERF_LOG_DROPPED,         // Bytes refused because a log ring was full
+    
+    // Directory index
+    MIMIC_PERF_FS_DIR_INDEXED,      // Lookups and creates served by a directory index
+    
+    MIMIC_PERF_COUNT
+};
+
+// ============================================================================
+// API
+// ============================================================================
+
+extern uint32_t mimic_perf_counters[MIMIC_CORE_COUNT][MIMIC_PERF_COUNT];
+
+static inline void mimic_perf_add(uint32_t id, uint32_t n) {
+    mimic_perf_counters[MIMIC_CORE_ID()][id] += n;
+}
+
+static inline void mimic_perf_inc(uint32_t id) {
+    mimic_perf_counters[MIMIC_CORE_ID()][id]++;
+}
+
+uint32_t    mimic_perf_read(uint32_t id);
+void        mimic_perf_snapshot(uint32_t* values);     // MIMIC_PERF_COUNT entries
+void        mimic_perf_reset(void);
+const char* mimic_perf_name(uint32_t id);
+
+#endif // MIMIC_PERF_H
@@ -0,0 +1,84 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC tmpfs - RAM filesystem for compiler temporaries                    ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  Mounted at MIMIC_CC_TMP_DIR behind the ordinary mimic_fopen API          ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * Files created directly under /mimic/tmp live in 512-byte kernel-heap
+ * blocks instead of on the card. A freed block goes back to a small pool
+ * so the next pass reuses it without touching the allocator.
+ * 
+ * When the budget is used up or kmalloc fails, the largest closed file is
+ * written out to the same path on SD and dropped from RAM; if none is
+ * closed, the file being written spills itself and its handle carries on
+ * against SD. Opening a path tmpfs doesn't hold falls through to FAT32, so
+ * spilled files read back transparently.
+ * 
+ * Contents are lost on reset. The FS entry points in mimic_fat32.c route
+ * here with the FS lock held; only mimic_tmpfs_info() is called directly.
+ */
+
+#ifndef MIMIC_TMPFS_H
+#define MIMIC_TMPFS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "mimic.h"
+
+// ============================================================================
+// CONFIGURATION
+// ============================================================================
+
+#define MIMIC_TMPFS_ROOT        MIMIC_CC_TMP_DIR
+#define MIMIC_TMPFS_BLOCK       512
+#define MIMIC_TMPFS_NAME        24          // Incl. NUL; no subdirectories
+#define MIMIC_TMPFS_MAX_FILES   16
+#define MIMIC_TMPFS_MAX_OPEN    8
+#define MIMIC_TMPFS_POOL_KEEP   8           // Free blocks held for reuse
+
+#ifndef MIMIC_TMPFS_BUDGET
+  #if MIMIC_TARGET_RP2350
+    #define MIMIC_TMPFS_BUDGET  (64 * 1024)
+  #else
+    #define MIMIC_TMPFS_BUDGET  (16 * 1024)
+  #endif
+#endif
+
+// Descriptors from here up are tmpfs handles, below are FAT32 ones
+#define MIMIC_TMPFS_FD_BASE     64
+
+static inline bool mimic_tmpfs_fd(int fd) {
+    return fd >= MIMIC_TMPFS_FD_BASE && fd < MIMIC_TMPFS_FD_BASE + MIMIC_TMPFS_MAX_OPEN;
+}
+
+// ============================================================================
+// API
+// ============================================================================
+
+// True for paths tmpfs answers for (directly under MIMIC_TMPFS_ROOT)
+bool mimic_tmpfs_owns(const char* path);
+
+// MIMIC_ERR_NOENT means "not in RAM": the caller tries FAT32 instead
+int     mimic_tmpfs_open(const char* path, uint8_t mode);
+int     mimic_tmpfs_close(int fd);
+int     mimic_tmpfs_read(int fd, void* buf, size_t size);
+int     mimic_tmpfs_write(int fd, const void* buf, size_t size);
+int     mimic_tmpfs_seek(int fd, int32_t offset, int whence);
+int32_t mimic_tmpfs_tell(int fd);
+int32_t mimic_tmpfs_size(int fd);
+bool    mimic_tmpfs_exists(const char* path);
+
+typedef struct {
+    uint32_t    files;
+    uint32_t    bytes;              // File contents held in RAM
+    uint32_t    blocks;             // In files
+    uint32_t    pooled;             // Free, kept for reuse
+    uint32_t    spills;             // Files moved to SD since boot
+} MimicTmpfsInfo;
+
+void mimic_tmpfs_info(MimicTmpfsInfo* info);     // Snapshot, no lock needed
+
+#endif // MIMIC_TMPFS_H
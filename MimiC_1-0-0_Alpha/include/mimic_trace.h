@@ -0,0 +1,145 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC Trace - Per-core kernel event ring                                 ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  Fixed-size binary records, safe from IRQs, dumped to SD for the host     ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * Each core owns a ring and is the only writer to it, so recording an event
+ * needs no lock: interrupts are masked just long enough to claim a slot,
+ * then the record is filled in. Old records are overwritten.
+ * 
+ * The first half of this header is the on-disk format and is shared with
+ * the host decoder (tools/trace2json.c, built with -DMIMIC_TRACE_HOST).
+ */
+
+#ifndef MIMIC_TRACE_H
+#define MIMIC_TRACE_H
+
+#include <stdint.h>
+
+// ============================================================================
+// CONFIGURATION
+// ============================================================================
+
+#ifndef MIMIC_TRACE_ENABLED
+  #define MIMIC_TRACE_ENABLED   1       // 0 compiles every trace point out
+#endif
+#ifndef MIMIC_TRACE_ENTRIES
+  #define MIMIC_TRACE_ENTRIES   256     // Per core, power of two
+#endif
+
+#define MIMIC_TRACE_FILE        "/mimic/trace.bin"
+
+// ============================================================================
+// EVENTS
+// ============================================================================
+
+enum {
+    MIMIC_TRACE_NONE = 0,
+    MIMIC_TRACE_SWITCH,         // a16 = from task, arg = to task
+    MIMIC_TRACE_KTHREAD_BEGIN,  // Slice of the record's task starts
+    MIMIC_TRACE_KTHREAD_END,    // arg = step result
+    MIMIC_TRACE_SYSCALL,        // a16 = number, arg = first argument
+    MIMIC_TRACE_ALLOC,          // a16 = owner task, arg = size
+    MIMIC_TRACE_FREE,           // a16 = owner task, arg = address
+    MIMIC_TRACE_SD_CMD,         // a16 = command, arg = argument
+    MIMIC_TRACE_SD_DONE,        // a16 = command | R1 << 8
+    MIMIC_TRACE_CC_BEGIN,       // Compile job starts on this core
+    MIMIC_TRACE_CC_FUNC,        // a16 = source line of a function body
+    MIMIC_TRACE_CC_END,         // arg = result
+    MIMIC_TRACE_MARK,           // Free for ad-hoc instrumentation
+    MIMIC_TRACE_IRQ,            // a16 = irq id, arg = ISR-to-dispatch us
+    MIMIC_TRACE_EVENT_COUNT
+};
+
+// ============================================================================
+// RECORD AND FILE FORMAT
+// ============================================================================
+
+// 12 bytes, naturally aligned so filling one is three word stores
+typedef struct {
+    uint32_t time_us;           // Low 32 bits of the 1 MHz system timer
+    uint8_t  event;
+    uint8_t  task;              // Task running on the core at the time
+    uint16_t a16;
+    uint32_t arg;
+} MimicTraceRecord;
+
+#define MIMIC_TRACE_MAGIC       0x4352544D  // "MTRC"
+#define MIMIC_TRACE_VERSION     1
+
+// File: header, task names[name_count][16], then per core a uint32_t
+// record count followed by that many records, oldest first.
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint16_t cores;
+    uint16_t name_count;
+} MimicTraceFileHeader;
+
+#ifndef MIMIC_TRACE_HOST
+
+#include "mimic.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+// ============================================================================
+// DEVICE API
+// ============================================================================
+
+typedef struct {
+    volatile uint32_t   head;   // Total records claimed; wraps the ring
+    uint8_t             task;
+    MimicTraceRecord    records[MIMIC_TRACE_ENTRIES];
+} MimicTraceRing;
+
+extern MimicTraceRing mimic_trace_rings[MIMIC_CORE_COUNT];
+extern volatile bool  mimic_trace_on;
+
+static inline void mimic_trace(uint8_t event, uint16_t a16, uint32_t arg) {
+#if MIMIC_TRACE_ENABLED
+    if (!mimic_trace_on) return;
+    
+    MimicTraceRing* ring = &mimic_trace_rings[MIMIC_CORE_ID()];
+    uint32_t irq = save_and_disable_interrupts();
+    uint32_t slot = ring->head++;
+    restore_interrupts(irq);
+    
+    MimicTraceRecord* rec = &ring->records[slot & (MIMIC_TRACE_ENTRIES - 1)];
+    rec->time_us = time_us_32();
+    rec->event = event;
+    rec->task = ring->task;
+    rec->a16 = a16;
+    rec->arg = arg;
+#else
+    (void)event; (void)a16; (void)arg;
+#endif
+}
+
+// Which task subsequent records on this core are attributed to
+static inline void mimic_trace_set_task(uint8_t task) {
+#if MIMIC_TRACE_ENABLED
+    mimic_trace_rings[MIMIC_CORE_ID()].task = task;
+#else
+    (void)task;
+#endif
+}
+
+static inline uint8_t mimic_trace_get_task(void) {
+#if MIMIC_TRACE_ENABLED
+    return mimic_trace_rings[MIMIC_CORE_ID()].task;
+#else
+    return 0;
+#endif
+}
+
+void mimic_trace_enable(bool on);
+void mimic_trace_clear(void);
+uint32_t mimic_trace_count(uint32_t core);
+int  mimic_trace_dump(const char* path);
+
+#endif // MIMIC_TRACE_HOST
+
+#endif // MIMIC_TRACE_H
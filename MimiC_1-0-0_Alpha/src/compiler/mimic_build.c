@@ -0,0 +1,981 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC Build Services - Source watcher and incremental rebuilds           ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  Runs as kernel threads on top of the background compile job              ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * The watcher polls MIMIC_CC_SRC_DIR using only directory entries (write
+ * time + size) to spot changes. A file is read only once it has changed,
+ * to learn its #include "..." edges. Changed headers mark every source that
+ * includes them (transitively) stale, and stale sources are rebuilt into
+ * MIMIC_CC_BIN_DIR one at a time, dependencies first.
+ * 
+ * make reads a small project manifest, compiles its translation units to
+ * objects in MIMIC_CC_TMP_DIR - one on core 0 (stepped from a kernel
+ * thread) and one on core 1 at a time - and links them into one .mimi.
+ * 
+ * Manifest format, one unit per line, paths relative to the manifest:
+ * 
+ *     # comment
+ *     target = /mimic/bin/firmware.mimi
+ *     main.c : motor.c util.c      <- main.c is compiled after its deps
+ *     motor.c : util.c
+ *     util.c
+ * 
+ * The persist queue writes images compiled straight into RAM (cc -r) back
+ * to the card after they are already running.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mimic.h"
+#include "mimic_fat32.h"
+
+// ============================================================================
+// WATCHER STATE
+// ============================================================================
+
+#define WF_USED         0x01
+#define WF_SOURCE       0x02    // .c file (produces a binary)
+#define WF_SEEN         0x04    // Present in the current scan
+#define WF_CHANGED      0x08    // mtime/size differ from last scan
+#define WF_STALE        0x10    // Binary needs rebuilding
+
+#define WATCH_RETRY_MS  200     // Compiler busy with someone else's job
+#define WATCH_POLL_MS   50      // Waiting for our own compile to finish
+
+typedef struct {
+    char        name[13];       // 8.3 name as returned by readdir
+    uint8_t     flags;
+    uint32_t    mtime;
+    uint32_t    size;
+    uint32_t    deps;           // Bitmask of watched files this one includes
+} WatchFile;
+
+static struct {
+    WatchFile   files[MIMIC_WATCH_MAX_FILES];
+    int         task_id;
+    int         building;       // Index being compiled, -1 if none
+    bool        hot_restart;
+    bool        first_scan;
+    uint32_t    next_scan_ms;
+    
+    uint32_t    scans;
+    uint32_t    rebuilds;
+    uint32_t    failures;
+    uint32_t    restarts;
+} watch = { .task_id = -1, .building = -1 };
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static bool name_has_ext(const char* name, const char* ext) {
+    size_t n = strlen(name), e = strlen(ext);
+    return n > e && strcmp(name + n - e, ext) == 0;
+}
+
+static void name_stem(const char* name, char* stem, size_t size) {
+    size_t i = 0;
+    while (name[i] && name[i] != '.' && i < size - 1) {
+        stem[i] = name[i];
+        i++;
+    }
+    stem[i] = '\0';
+}
+
+static int watch_lookup(const char* name) {
+    for (int i = 0; i < MIMIC_WATCH_MAX_FILES; i++) {
+        if ((watch.files[i].flags & WF_USED) &&
+            strcmp(watch.files[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int watch_insert(const char* name) {
+    for (int i = 0; i < MIMIC_WATCH_MAX_FILES; i++) {
+        WatchFile* f = &watch.files[i];
+        if (f->flags & WF_USED) continue;
+        
+        // Slot may have been used by a deleted file; forget its edges
+        for (int j = 0; j < MIMIC_WATCH_MAX_FILES; j++) {
+            watch.files[j].deps &= ~(1u << i);
+        }
+        
+        memset(f, 0, sizeof(WatchFile));
+        strncpy(f->name, name, sizeof(f->name) - 1);
+        f->flags = WF_USED;
+        return i;
+    }
+    return -1;
+}
+
+// Pull the local #include "x" edges out of a watched file
+static uint32_t watch_scan_includes(const char* name) {
+    char path[MIMIC_MAX_PATH];
+    snprintf(path, sizeof(path), "%s/%s", MIMIC_CC_SRC_DIR, name);
+    
+    int fd = mimic_fopen(path, MIMIC_FILE_READ);
+    if (fd < 0) return 0;
+    
+    uint32_t deps = 0;
+    char buf[128];
+    char line[80];
+    int len = 0;
+    int n;
+    
+    while ((n = mimic_fread(fd, buf, sizeof(buf))) > 0) {
+        for (int i = 0; i < n; i++) {
+            if (buf[i] != '\n') {
+                if (len < (int)sizeof(line) - 1) line[len++] = buf[i];
+                continue;
+            }
+            line[len] = '\0';
+            len = 0;
+            
+            const char* p = line;
+            while (*p == ' ' || *p == '\t') p++;
+            if (*p++ != '#') continue;
+            while (*p == ' ' || *p == '\t') p++;
+            if (strncmp(p, "include", 7) != 0) continue;
+            p += 7;
+            while (*p == ' ' || *p == '\t') p++;
+            if (*p++ != '"') continue;
+            
+            const char* end = strchr(p, '"');
+            if (!end || end - p >= 13) continue;
+            
+            char inc[13];
+            memcpy(inc, p, end - p);
+            inc[end - p] = '\0';
+            for (char* c = inc; *c; c++) {
+                if (*c >= 'A' && *c <= 'Z') *c += 32;
+            }
+            
+            int idx = watch_lookup(inc);
+            if (idx >= 0) deps |= 1u << idx;
+        }
+    }
+    
+    mimic_fclose(fd);
+    return deps;
+}
+
+// ============================================================================
+// SCAN
+// ============================================================================
+
+static int watch_scan(void) {
+    for (int i = 0; i < MIMIC_WATCH_MAX_FILES; i++) {
+        watch.files[i].flags &= ~WF_SEEN;
+    }
+    
+    int dir = mimic_opendir(MIMIC_CC_SRC_DIR);
+    if (dir < 0) return dir;
+    
+    MimicDirEntry e;
+    while (mimic_readdir(dir, &e) == MIMIC_OK) {
+        if (e.is_dir) continue;
+        
+        bool is_src = name_has_ext(e.name, ".c");
+        if (!is_src && !name_has_ext(e.name, ".h")) continue;
+        
+        int idx = watch_lookup(e.name);
+        if (idx < 0) {
+            idx = watch_insert(e.name);
+            if (idx < 0) continue;  // Table full - file is not watched
+            watch.files[idx].flags |= WF_CHANGED | (is_src ? WF_SOURCE : 0);
+        }
+        
+        WatchFile* f = &watch.files[idx];
+        if (f->mtime != e.mtime || f->size != e.size) f->flags |= WF_CHANGED;
+        f->mtime = e.mtime;
+        f->size = e.size;
+        f->flags |= WF_SEEN;
+    }
+    mimic_closedir(dir);
+    
+    // Deleted files count as changes for whoever included them
+    uint32_t changed = 0;
+    for (int i = 0; i < MIMIC_WATCH_MAX_FILES; i++) {
+        WatchFile* f = &watch.files[i];
+        if (!(f->flags & WF_USED)) continue;
+        if (!(f->flags & WF_SEEN)) {
+            changed |= 1u << i;
+            f->flags = 0;
+        } else if (f->flags & WF_CHANGED) {
+            changed |= 1u << i;
+        }
+    }
+    
+    // Re-learn include edges of changed files only, now that every name
+    // in the directory has a slot.
+    for (int i = 0; i < MIMIC_WATCH_MAX_FILES; i++) {
+        WatchFile* f = &watch.files[i];
+        if ((f->flags & WF_USED) && (f->flags & WF_CHANGED)) {
+            f->deps = watch_scan_includes(f->name);
+        }
+    }
+    
+    // Propagate through includers until nothing new gets marked
+    uint32_t prev;
+    do {
+        prev = changed;
+        for (int i = 0; i < MIMIC_WATCH_MAX_FILES; i++) {
+            if ((watch.files[i].flags & WF_USED) && (watch.files[i].deps & changed)) {
+                changed |= 1u << i;
+            }
+        }
+    } while (changed != prev);
+    
+    for (int i = 0; i < MIMIC_WATCH_MAX_FILES; i++) {
+        WatchFile* f = &watch.files[i];
+        if (!(f->flags & WF_USED)) continue;
+        
+        if ((f->flags & WF_SOURCE) && (changed & (1u << i))) {
+            f->flags |= WF_STALE;
+            
+            // No history on the first pass: trust binaries that exist
+            if (watch.first_scan) {
+                char stem[9], bin[MIMIC_MAX_PATH];
+                name_stem(f->name, stem, sizeof(stem));
+                snprintf(bin, sizeof(bin), "%s/%s%s", MIMIC_CC_BIN_DIR, stem, MIMIC_EXT_MIMI);
+                if (mimic_exists(bin)) f->flags &= ~WF_STALE;
+            }
+        }
+        f->flags &= ~WF_CHANGED;
+    }
+    
+    watch.first_scan = false;
+    watch.scans++;
+    return MIMIC_OK;
+}
+
+// ============================================================================
+// REBUILD
+// ============================================================================
+
+// Next stale source whose own stale dependencies are already done
+static int watch_pick(void) {
+    uint32_t stale = 0;
+    for (int i = 0; i < MIMIC_WATCH_MAX_FILES; i++) {
+        if (watch.files[i].flags & WF_STALE) stale |= 1u << i;
+    }
+    if (!stale) return -1;
+    
+    for (int i = 0; i < MIMIC_WATCH_MAX_FILES; i++) {
+        if ((stale & (1u << i)) && !(watch.files[i].deps & stale & ~(1u << i))) {
+            return i;
+        }
+    }
+    
+    // Include cycle - just take the first one
+    for (int i = 0; i < MIMIC_WATCH_MAX_FILES; i++) {
+        if (stale & (1u << i)) return i;
+    }
+    return -1;
+}
+
+static void watch_build_done(int result) {
+    WatchFile* f = &watch.files[watch.building];
+    watch.building = -1;
+    f->flags &= ~WF_STALE;
+    
+    if (result != MIMIC_OK) {
+        watch.failures++;
+        printf("[WATCH] Rebuild of %s failed: %s\n", f->name, mimic_compile_error());
+        return;
+    }
+    watch.rebuilds++;
+    
+    if (!watch.hot_restart) return;
+    
+    char stem[9], bin[MIMIC_MAX_PATH];
+    name_stem(f->name, stem, sizeof(stem));
+    snprintf(bin, sizeof(bin), "%s/%s%s", MIMIC_CC_BIN_DIR, stem, MIMIC_EXT_MIMI);
+    
+    int old_id = mimic_task_find(stem);
+    MimicTCB* old = old_id > 0 ? mimic_task_get(old_id) : NULL;
+    if (!old || old->kthread) return;
+    
+    uint8_t priority = old->priority;
+    mimic_task_kill(old_id);
+    
+    int new_id = mimic_task_load(bin, priority);
+    if (new_id < 0) {
+        printf("[WATCH] Restart of %s failed (%d)\n", stem, new_id);
+        return;
+    }
+    watch.restarts++;
+    printf("[WATCH] Restarted %s: task %d -> %d\n", stem, old_id, new_id);
+}
+
+static void watch_build_next(void) {
+    int idx = watch_pick();
+    if (idx < 0) return;
+    
+    WatchFile* f = &watch.files[idx];
+    char stem[9], src[MIMIC_MAX_PATH], bin[MIMIC_MAX_PATH];
+    name_stem(f->name, stem, sizeof(stem));
+    snprintf(src, sizeof(src), "%s/%s", MIMIC_CC_SRC_DIR, f->name);
+    snprintf(bin, sizeof(bin), "%s/%s%s", MIMIC_CC_BIN_DIR, stem, MIMIC_EXT_MIMI);
+    
+    int err = mimic_compile_bg(src, bin);
+    if (err == MIMIC_ERR_BUSY) {
+        mimic_kthread_sleep(WATCH_RETRY_MS);
+        return;
+    }
+    if (err < 0) {
+        f->flags &= ~WF_STALE;
+        watch.failures++;
+        printf("[WATCH] Cannot rebuild %s (%d)\n", f->name, err);
+        return;
+    }
+    
+    printf("[WATCH] Rebuilding %s -> %s\n", src, bin);
+    watch.building = idx;
+    mimic_kthread_sleep(WATCH_POLL_MS);
+}
+
+// ============================================================================
+// WATCHER THREAD
+// ============================================================================
+
+static bool watch_has_stale(void) {
+    for (int i = 0; i < MIMIC_WATCH_MAX_FILES; i++) {
+        if (watch.files[i].flags & WF_STALE) return true;
+    }
+    return false;
+}
+
+static int watch_thread(void* arg) {
+    (void)arg;
+    
+    if (watch.building >= 0) {
+        MimicCompileProgress p;
+        int err = mimic_compile_progress(&p);
+        if (err == MIMIC_OK && p.active) {
+            mimic_kthread_sleep(WATCH_POLL_MS);
+            return MIMIC_ERR_BUSY;
+        }
+        watch_build_done(err == MIMIC_OK ? p.result : err);
+    }
+    
+    if (watch_has_stale()) {
+        watch_build_next();
+        return MIMIC_ERR_BUSY;
+    }
+    
+    uint32_t now = mimic_get_uptime_ms();
+    if ((int32_t)(now - watch.next_scan_ms) >= 0) {
+        int err = watch_scan();
+        if (err != MIMIC_OK && watch.scans == 0) {
+            printf("[WATCH] Cannot open %s (%d)\n", MIMIC_CC_SRC_DIR, err);
+        }
+        watch.next_scan_ms = now + MIMIC_WATCH_PERIOD_MS;
+        if (watch_has_stale()) return MIMIC_ERR_BUSY;
+    }
+    
+    mimic_kthread_sleep(watch.next_scan_ms - now);
+    return MIMIC_ERR_BUSY;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int mimic_watch_start(bool hot_restart) {
+    if (watch.task_id >= 0) return MIMIC_ERR_BUSY;
+    
+    memset(watch.files, 0, sizeof(watch.files));
+    watch.building = -1;
+    watch.hot_restart = hot_restart;
+    watch.first_scan = true;
+    watch.next_scan_ms = mimic_get_uptime_ms();
+    watch.scans = 0;
+    watch.rebuilds = 0;
+    watch.failures = 0;
+    watch.restarts = 0;
+    
+    int id = mimic_kthread_spawn("watch", MIMIC_PRIO_BACKGROUND, watch_thread, NULL);
+    if (id < 0) return id;
+    
+    watch.task_id = id;
+    return id;
+}
+
+void mimic_watch_stop(void) {
+    if (watch.task_id < 0) return;
+    
+    // An in-flight compile keeps running on its own thread
+    mimic_task_kill(watch.task_id);
+    watch.task_id = -1;
+    watch.building = -1;
+}
+
+void mimic_watch_status(MimicWatchStatus* status) {
+    memset(status, 0, sizeof(*status));
+    status->running = watch.task_id >= 0;
+    status->hot_restart = watch.hot_restart;
+    status->task_id = watch.task_id;
+    status->scans = watch.scans;
+    status->rebuilds = watch.rebuilds;
+    status->failures = watch.failures;
+    status->restarts = watch.restarts;
+    
+    for (int i = 0; i < MIMIC_WATCH_MAX_FILES; i++) {
+        if (watch.files[i].flags & WF_USED) status->files++;
+        if (watch.files[i].flags & WF_STALE) status->pending++;
+    }
+}
+
+// ============================================================================
+// MAKE STATE
+// ============================================================================
+
+#define MK_WAITING      0
+#define MK_RUNNING      1
+#define MK_DONE         2
+#define MK_FAILED       3
+
+#define MAKE_MANIFEST_MAX   1024
+#define MAKE_COPY_BUF       512
+#define MAKE_PIO_BYTES      512     // Combined PIO sections of all units
+
+typedef struct {
+    char        name[13];
+    uint8_t     state;
+    uint32_t    deps;           // Bitmask of units that must finish first
+} MakeUnit;
+
+static struct {
+    MakeUnit        units[MIMIC_MAKE_MAX_UNITS];
+    uint32_t        count;
+    char            dir[MIMIC_MAX_PATH];
+    char            target[MIMIC_MAX_PATH];
+    
+    int             task_id;
+    MimicCompiler*  local;          // Unit being stepped on core 0
+    int             local_unit;
+    int             remote_unit;    // Unit compiling on core 1
+    int             result;
+    
+    uint32_t        start_ms;
+    uint32_t        built_core0;
+    uint32_t        built_core1;
+} make = { .task_id = -1 };
+
+// ============================================================================
+// MANIFEST
+// ============================================================================
+
+static const char* next_word(const char* p, char* word, size_t size) {
+    while (*p == ' ' || *p == '\t') p++;
+    size_t n = 0;
+    while (*p && *p != ' ' && *p != '\t' && *p != ':' && *p != '=') {
+        if (n < size - 1) word[n++] = *p;
+        p++;
+    }
+    word[n] = '\0';
+    return p;
+}
+
+static int make_unit(const char* name) {
+    for (uint32_t i = 0; i < make.count; i++) {
+        if (strcmp(make.units[i].name, name) == 0) return i;
+    }
+    if (make.count >= MIMIC_MAKE_MAX_UNITS || strlen(name) >= 13) return -1;
+    
+    MakeUnit* u = &make.units[make.count];
+    memset(u, 0, sizeof(MakeUnit));
+    strcpy(u->name, name);
+    return make.count++;
+}
+
+static int make_parse_line(char* line) {
+    char* hash = strchr(line, '#');
+    if (hash) *hash = '\0';
+    
+    char word[MIMIC_MAX_PATH];
+    const char* p = next_word(line, word, sizeof(word));
+    if (!word[0]) return MIMIC_OK;
+    
+    while (*p == ' ' || *p == '\t') p++;
+    
+    if (strcmp(word, "target") == 0) {
+        if (*p == '=') p++;
+        next_word(p, make.target, sizeof(make.target));
+        return make.target[0] ? MIMIC_OK : MIMIC_ERR_INVAL;
+    }
+    
+    int u = make_unit(word);
+    if (u < 0) return MIMIC_ERR_TOOLARGE;
+    
+    if (*p != ':') return *p ? MIMIC_ERR_INVAL : MIMIC_OK;
+    p++;
+    
+    while (true) {
+        p = next_word(p, word, sizeof(word));
+        if (!word[0]) break;
+        int d = make_unit(word);
+        if (d < 0) return MIMIC_ERR_TOOLARGE;
+        if (d != u) make.units[u].deps |= 1u << d;
+    }
+    return MIMIC_OK;
+}
+
+static int make_load_manifest(const char* path) {
+    char* text = mimic_kmalloc(MAKE_MANIFEST_MAX);
+    if (!text) return MIMIC_ERR_NOMEM;
+    
+    int n = mimic_read_file(path, text, MAKE_MANIFEST_MAX - 1);
+    if (n < 0) {
+        mimic_kfree(text);
+        return n;
+    }
+    text[n] = '\0';
+    
+    make.count = 0;
+    make.target[0] = '\0';
+    
+    int err = MIMIC_OK;
+    uint32_t line_no = 1;
+    char* line = text;
+    while (line && err == MIMIC_OK) {
+        char* nl = strchr(line, '\n');
+        if (nl) *nl = '\0';
+        char* cr = strchr(line, '\r');
+        if (cr) *cr = '\0';
+        
+        err = make_parse_line(line);
+        if (err != MIMIC_OK) {
+            printf("[MAKE] %s:%lu: bad line\n", path, (unsigned long)line_no);
+        }
+        line = nl ? nl + 1 : NULL;
+        line_no++;
+    }
+    
+    mimic_kfree(text);
+    if (err != MIMIC_OK) return err;
+    
+    if (!make.target[0] || make.count == 0) {
+        printf("[MAKE] %s: needs a target and at least one unit\n", path);
+        return MIMIC_ERR_INVAL;
+    }
+    return MIMIC_OK;
+}
+
+static void make_paths(int u, char* src, char* obj) {
+    char stem[9];
+    name_stem(make.units[u].name, stem, sizeof(stem));
+    snprintf(src, MIMIC_MAX_PATH, "%s/%s", make.dir, make.units[u].name);
+    snprintf(obj, MIMIC_MAX_PATH, "%s/%s%s", MIMIC_CC_TMP_DIR, stem, MIMIC_EXT_OBJ);
+}
+
+// ============================================================================
+// LINK
+// ============================================================================
+
+// Objects are .mimi images carrying a symbol table. Linking concatenates
+// their .text, sums .bss, rebases symbols and points the entry at main().
+// PIO sections are gathered and appended in unit order, so programs are
+// numbered across the whole build.
+static int make_link(void) {
+    MimiSymbol* syms = mimic_kmalloc(MIMIC_LINK_MAX_SYMBOLS * sizeof(MimiSymbol));
+    uint8_t* buf = mimic_kmalloc(MAKE_COPY_BUF + MAKE_PIO_BYTES);
+    uint8_t* pio = buf + MAKE_COPY_BUF;
+    if (!syms || !buf) {
+        mimic_kfree(syms);
+        mimic_kfree(buf);
+        return MIMIC_ERR_NOMEM;
+    }
+    
+    int err = MIMIC_OK;
+    int out = mimic_fopen(make.target, MIMIC_FILE_WRITE | MIMIC_FILE_CREATE | MIMIC_FILE_TRUNC);
+    if (out < 0) {
+        printf("[MAKE] Cannot create %s\n", make.target);
+        mimic_kfree(syms);
+        mimic_kfree(buf);
+        return out;
+    }
+    
+    MimiHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = MIMI_MAGIC;
+    hdr.version = MIMI_VERSION;
+    hdr.arch = MIMI_ARCH_THUMB;
+    
+    const char* base = strrchr(make.target, '/');
+    name_stem(base ? base + 1 : make.target, hdr.name, sizeof(hdr.name));
+    mimic_fwrite(out, &hdr, sizeof(hdr));
+    
+    uint32_t nsyms = 0;
+    bool have_main = false;
+    
+    for (uint32_t u = 0; u < make.count && err == MIMIC_OK; u++) {
+        char src[MIMIC_MAX_PATH], obj[MIMIC_MAX_PATH];
+        make_paths(u, src, obj);
+        
+        int fd = mimic_fopen(obj, MIMIC_FILE_READ);
+        if (fd < 0) {
+            err = fd;
+            break;
+        }
+        
+        MimiHeader oh;
+        if (mimic_fread(fd, &oh, sizeof(oh)) != sizeof(oh) ||
+            oh.magic != MIMI_MAGIC || oh.version != MIMI_VERSION) {
+            err = MIMIC_ERR_CORRUPT;
+        } else if (oh.rodata_size || oh.data_size || oh.reloc_count) {
+            // Codegen doesn't produce these yet; don't link them wrongly
+            err = MIMIC_ERR_NOSYS;
+        } else if (oh.flags & MIMI_FLAG_EXTERN_CALLS) {
+            // Calls are emitted unresolved; nothing here could patch them
+            printf("[MAKE] %s calls functions it doesn't define; cross-unit calls "
+                   "can't be linked yet\n", src);
+            err = MIMIC_ERR_NOSYS;
+        } else if (oh.bss_size && make.count > 1) {
+            // Globals are addressed from each unit's own .bss start
+            printf("[MAKE] %s has globals; they can't be linked with other units yet\n", src);
+            err = MIMIC_ERR_NOSYS;
+        }
+        
+        // .text
+        uint32_t left = oh.text_size;
+        while (err == MIMIC_OK && left > 0) {
+            uint32_t chunk = left < MAKE_COPY_BUF ? left : MAKE_COPY_BUF;
+            if (mimic_fread(fd, buf, chunk) != (int)chunk ||
+                mimic_fwrite(out, buf, chunk) != (int)chunk) {
+                err = MIMIC_ERR_IO;
+            }
+            left -= chunk;
+        }
+        
+        // PIO programs, held back until all .text is out
+        if (err == MIMIC_OK && oh.pio_size > 0) {
+            if (hdr.pio_size + oh.pio_size > MAKE_PIO_BYTES) {
+                err = MIMIC_ERR_TOOLARGE;
+            } else if (mimic_fread(fd, pio + hdr.pio_size, oh.pio_size) != (int)oh.pio_size) {
+                err = MIMIC_ERR_CORRUPT;
+            } else {
+                hdr.pio_size += oh.pio_size;
+            }
+        }
+        
+        // Symbols, rebased onto the combined .text
+        for (uint32_t i = 0; err == MIMIC_OK && i < oh.symbol_count; i++) {
+            MimiSymbol sym;
+            if (mimic_fread(fd, &sym, sizeof(sym)) != sizeof(sym)) {
+                err = MIMIC_ERR_CORRUPT;
+                break;
+            }
+            if (sym.section == MIMI_SECT_TEXT) sym.value += hdr.text_size;
+            
+            for (uint32_t j = 0; j < nsyms; j++) {
+                if (strncmp(syms[j].name, sym.name, sizeof(sym.name)) == 0) {
+                    printf("[MAKE] Duplicate symbol '%.16s' in %s\n", sym.name, obj);
+                    err = MIMIC_ERR_INVAL;
+                }
+            }
+            if (err != MIMIC_OK) break;
+            
+            if (nsyms >= MIMIC_LINK_MAX_SYMBOLS) {
+                err = MIMIC_ERR_TOOLARGE;
+                break;
+            }
+            syms[nsyms++] = sym;
+            
+            if (strncmp(sym.name, "main", sizeof(sym.name)) == 0) {
+                hdr.entry_offset = sym.value;
+                have_main = true;
+            }
+        }
+        
+        hdr.text_size += oh.text_size;
+        hdr.bss_size += oh.bss_size;
+        
+        // Units don't see each other's call graphs: summing their worst
+        // cases bounds any chain that crosses units without recursing.
+        hdr.stack_request += oh.stack_request;
+        if (oh.heap_request > hdr.heap_request) hdr.heap_request = oh.heap_request;
+        hdr.flags |= oh.flags & (MIMI_FLAG_RECURSIVE | MIMI_FLAG_HEAP_HINT);
+        mimic_fclose(fd);
+        
+        if (err != MIMIC_OK) printf("[MAKE] Cannot link %s (%d)\n", obj, err);
+    }
+    
+    if (err == MIMIC_OK && !have_main) {
+        printf("[MAKE] No main() in any unit\n");
+        err = MIMIC_ERR_NOEXEC;
+    }
+    
+    if (err == MIMIC_OK && hdr.pio_size > 0 &&
+        mimic_fwrite(out, pio, hdr.pio_size) != (int)hdr.pio_size) {
+        err = MIMIC_ERR_IO;
+    }
+    
+    if (err == MIMIC_OK) {
+        for (uint32_t i = 0; i < nsyms; i++) {
+            mimic_fwrite(out, &syms[i], sizeof(MimiSymbol));
+        }
+        hdr.symbol_count = nsyms;
+        mimic_fseek(out, 0, MIMIC_SEEK_SET);
+        mimic_fwrite(out, &hdr, sizeof(hdr));
+    }
+    
+    mimic_fclose(out);
+    mimic_kfree(syms);
+    mimic_kfree(buf);
+    return err;
+}
+
+// ============================================================================
+// MAKE THREAD
+// ============================================================================
+
+static int make_remote_compile(void* arg) {
+    char src[MIMIC_MAX_PATH], obj[MIMIC_MAX_PATH];
+    make_paths((int)(intptr_t)arg, src, obj);
+    return mimic_compile(src, obj);
+}
+
+static int make_next_ready(void) {
+    uint32_t done = 0;
+    for (uint32_t i = 0; i < make.count; i++) {
+        if (make.units[i].state == MK_DONE) done |= 1u << i;
+    }
+    for (uint32_t i = 0; i < make.count; i++) {
+        MakeUnit* u = &make.units[i];
+        if (u->state == MK_WAITING && (u->deps & ~done) == 0) return i;
+    }
+    return -1;
+}
+
+static void make_unit_done(int u, int result) {
+    make.units[u].state = result == MIMIC_OK ? MK_DONE : MK_FAILED;
+    if (result != MIMIC_OK && make.result == MIMIC_OK) {
+        printf("[MAKE] %s failed (%d)\n", make.units[u].name, result);
+        make.result = result;
+    }
+}
+
+static int make_thread(void* arg) {
+    (void)arg;
+    
+    // Collect core 1's result
+    int result;
+    if (make.remote_unit >= 0 && mimic_core1_poll(&result) == MIMIC_OK) {
+        make_unit_done(make.remote_unit, result);
+        make.remote_unit = -1;
+        make.built_core1++;
+    }
+    
+    // Step our own unit until the slice is spent
+    if (make.local) {
+        int err;
+        do {
+            err = mimic_compile_step(make.local);
+        } while (err == MIMIC_ERR_BUSY && !mimic_kthread_should_yield());
+        if (err == MIMIC_ERR_BUSY) return err;
+        
+        make_unit_done(make.local_unit, mimic_compile_end(make.local));
+        make.local = NULL;
+        make.local_unit = -1;
+        make.built_core0++;
+    }
+    
+    // Hand out ready units: core 1 first, then core 0. Stop after a failure.
+    if (make.result == MIMIC_OK) {
+        int u = make_next_ready();
+        if (u >= 0 && make.remote_unit < 0 &&
+            mimic_core1_submit(make_remote_compile, (void*)(intptr_t)u) == MIMIC_OK) {
+            make.units[u].state = MK_RUNNING;
+            make.remote_unit = u;
+            u = make_next_ready();
+        }
+        
+        if (u >= 0) {
+            char src[MIMIC_MAX_PATH], obj[MIMIC_MAX_PATH];
+            make_paths(u, src, obj);
+            
+            int err;
+            make.units[u].state = MK_RUNNING;
+            make.local = mimic_compile_begin(src, obj, &err);
+            make.local_unit = u;
+            if (!make.local) {
+                make_unit_done(u, err);
+                make.local_unit = -1;
+            }
+        }
+    }
+    
+    if (make.local) return MIMIC_ERR_BUSY;
+    if (make.remote_unit >= 0) {
+        mimic_kthread_sleep(1);
+        return MIMIC_ERR_BUSY;
+    }
+    
+    // Nothing in flight: either finished, failed or stuck on a cycle
+    if (make.result == MIMIC_OK) {
+        for (uint32_t i = 0; i < make.count; i++) {
+            if (make.units[i].state != MK_DONE) {
+                printf("[MAKE] Dependency cycle involving %s\n", make.units[i].name);
+                make.result = MIMIC_ERR_INVAL;
+                break;
+            }
+        }
+    }
+    
+    if (make.result == MIMIC_OK) make.result = make_link();
+    
+    printf("\n[MAKE] %s %s: %lu units (%lu core 0, %lu core 1) in %lu ms\n",
+           make.target, make.result == MIMIC_OK ? "built" : "FAILED",
+           (unsigned long)make.count, (unsigned long)make.built_core0,
+           (unsigned long)make.built_core1,
+           (unsigned long)(mimic_get_uptime_ms() - make.start_ms));
+    
+    make.task_id = -1;
+    return make.result;
+}
+
+int mimic_make(const char* manifest) {
+    if (make.task_id >= 0) return MIMIC_ERR_BUSY;
+    
+    strncpy(make.dir, manifest, sizeof(make.dir) - 1);
+    make.dir[sizeof(make.dir) - 1] = '\0';
+    char* slash = strrchr(make.dir, '/');
+    if (slash && slash != make.dir) *slash = '\0';
+    else strcpy(make.dir, "/");
+    
+    int err = make_load_manifest(manifest);
+    if (err != MIMIC_OK) return err;
+    
+    make.local = NULL;
+    make.local_unit = -1;
+    make.remote_unit = -1;
+    make.result = MIMIC_OK;
+    make.start_ms = mimic_get_uptime_ms();
+    make.built_core0 = 0;
+    make.built_core1 = 0;
+    
+    int id = mimic_kthread_spawn("make", MIMIC_PRIO_BACKGROUND, make_thread, NULL);
+    if (id < 0) return id;
+    
+    make.task_id = id;
+    return id;
+}
+
+// ============================================================================
+// BACKGROUND PERSIST
+// ============================================================================
+
+typedef struct {
+    char        path[MIMIC_MAX_PATH];
+    uint8_t*    data;
+    uint32_t    size;
+} PersistJob;
+
+static struct {
+    PersistJob  jobs[MIMIC_PERSIST_QUEUE];
+    uint32_t    head;           // Job being written
+    uint32_t    count;
+    int         fd;
+    uint32_t    written;
+    int         task_id;
+} persist = { .fd = -1, .task_id = -1 };
+
+static void persist_pop(void) {
+    PersistJob* job = &persist.jobs[persist.head];
+    mimic_kfree(job->data);
+    job->data = NULL;
+    persist.head = (persist.head + 1) % MIMIC_PERSIST_QUEUE;
+    persist.count--;
+    persist.written = 0;
+}
+
+static int persist_thread(void* arg) {
+    (void)arg;
+    
+    while (persist.count > 0) {
+        PersistJob* job = &persist.jobs[persist.head];
+        
+        if (persist.fd < 0) {
+            persist.fd = mimic_fopen(job->path,
+                                     MIMIC_FILE_WRITE | MIMIC_FILE_CREATE | MIMIC_FILE_TRUNC);
+            if (persist.fd < 0) {
+                printf("[BUILD] Cannot persist %s (%d)\n", job->path, persist.fd);
+                persist_pop();
+                continue;
+            }
+        }
+        
+        while (persist.written < job->size) {
+            uint32_t chunk = job->size - persist.written;
+            if (chunk > MIMIC_PERSIST_CHUNK) chunk = MIMIC_PERSIST_CHUNK;
+            
+            int n = mimic_fwrite(persist.fd, job->data + persist.written, chunk);
+            if (n != (int)chunk) {
+                printf("[BUILD] Write error persisting %s\n", job->path);
+                break;
+            }
+            persist.written += chunk;
+            
+            if (persist.written < job->size && mimic_kthread_should_yield()) {
+                return MIMIC_ERR_BUSY;
+            }
+        }
+        
+        mimic_fclose(persist.fd);
+        persist.fd = -1;
+        persist_pop();
+        
+        if (mimic_kthread_should_yield()) return MIMIC_ERR_BUSY;
+    }
+    
+    persist.task_id = -1;
+    return MIMIC_OK;
+}
+
+int mimic_persist(const char* path, uint8_t* data, uint32_t size) {
+    if (!data) return MIMIC_ERR_INVAL;
+    
+    // A newer image for a path that hasn't started writing replaces it
+    for (uint32_t i = 1; i < persist.count; i++) {
+        PersistJob* job = &persist.jobs[(persist.head + i) % MIMIC_PERSIST_QUEUE];
+        if (strcmp(job->path, path) == 0) {
+            mimic_kfree(job->data);
+            job->data = data;
+            job->size = size;
+            return MIMIC_OK;
+        }
+    }
+    
+    if (persist.count >= MIMIC_PERSIST_QUEUE || strlen(path) >= MIMIC_MAX_PATH) {
+        mimic_kfree(data);
+        return persist.count >= MIMIC_PERSIST_QUEUE ? MIMIC_ERR_BUSY : MIMIC_ERR_INVAL;
+    }
+    
+    PersistJob* job = &persist.jobs[(persist.head + persist.count) % MIMIC_PERSIST_QUEUE];
+    strcpy(job->path, path);
+    job->data = data;
+    job->size = size;
+    persist.count++;
+    
+    if (persist.task_id < 0) {
+        int id = mimic_kthread_spawn("persist", MIMIC_PRIO_BACKGROUND, persist_thread, NULL);
+        if (id < 0) {
+            persist.count--;
+            job->data = NULL;
+            mimic_kfree(data);
+            return id;
+        }
+        persist.task_id = id;
+    }
+    return MIMIC_OK;
+}
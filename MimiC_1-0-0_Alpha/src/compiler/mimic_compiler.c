@@ -16,12 +16,15 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
 #include <ctype.h>
 #include <stdbool.h>
 #include <stdint.h>
 
 #include "mimic.h"
+#include "mimic_trace.h"
+#include "mimic_perf.h"
 #include "mimic_fat32.h"
 
 // ============================================================================
@@ -37,6 +40,10 @@
 #define MC_MAX_BREAKS   16
 #define MC_MAX_CONTS    16
 #define MC_STACK_SIZE   256
+#define MC_MAX_CALLS    256     // Call graph edges kept for stack sizing
+#define MC_EXTERN_FRAME 64      // Assumed depth of a function defined elsewhere
+#define MC_STACK_MARGIN 64      // Exception frame + syscall entry on the task stack
+#define MC_PIO_BYTES    256     // PIO section: a few programs of up to 32 words
 
 // ============================================================================
 // TOKEN TYPES
@@ -123,6 +130,11 @@ struct Symbol {
     uint8_t     kind;
     uint8_t     scope;
     int16_t     offset;     // Stack offset for locals, address for globals
+    uint8_t     defined;    // Function has a body in this unit
+    uint8_t     visit;      // Stack sizing walk: 0 new, 1 on path, 2 done
+    uint8_t     called;     // Some call site targets this function
+    uint16_t    frame;      // Bytes the function's own body pushes/reserves
+    uint16_t    stack;      // Worst-case depth including callees
     Type*       type;
     Symbol*     next;       // Hash chain
 };
@@ -131,18 +143,22 @@ struct Symbol {
 // COMPILER STATE
 // ============================================================================
 
-typedef struct {
+typedef struct MimicCompiler {
     // Input
-    int         in_fd;
+    MimicStream in;
     uint8_t*    in_buf;
-    uint32_t    in_pos;
-    uint32_t    in_len;
     
     // Output  
     int         out_fd;
     uint8_t*    out_buf;
     uint32_t    out_pos;
     
+    // In-memory output (mimic_compile_mem): the whole .mimi image
+    bool        to_memory;
+    uint8_t*    image;
+    uint32_t    image_len;
+    uint32_t    image_cap;
+    
     // Lexer state
     int         ch;
     int         tok;
@@ -177,10 +193,32 @@ typedef struct {
     int         cont_count;
     
     // Code generation
+    int         reg;            // Current register (simple: always r0-r3)
     uint32_t    code_pos;       // Current position in output
     uint32_t    data_pos;       // Data section start
     uint32_t    bss_pos;        // BSS section start
     
+    // Stack sizing: call graph between symbols of this unit
+    Symbol*     cur_func;
+    int16_t     push_depth;     // Bytes pushed so far in cur_func
+    int16_t     push_max;
+    uint8_t     call_from[MC_MAX_CALLS];
+    uint8_t     call_to[MC_MAX_CALLS];
+    uint32_t    call_count;
+    bool        call_overflow;
+    Symbol*     recursive;      // First function found on a call cycle
+    
+    // #pragma mimic stack/heap
+    uint32_t    pragma_stack;
+    uint32_t    pragma_heap;
+    bool        has_pragma_heap;
+    
+    // #pragma mimic pio*: the PIO section, built up line by line
+    uint8_t     pio[MC_PIO_BYTES];
+    uint32_t    pio_size;
+    uint32_t    pio_cur;        // Offset of the program being defined
+    bool        pio_open;
+    
     // Error handling
     char        error[128];
     uint32_t    error_line;
@@ -189,15 +227,27 @@ typedef struct {
     // Statistics
     uint32_t    tokens;
     uint32_t    bytes_out;
+    uint32_t    functions;
+    uint32_t    start_ms;
+    
+    MimiHeader  header;
 } Compiler;
 
-static Compiler* cc;
+// One active compiler per core, so make can run a job on each core. The
+// core id is an SIO read, so functions look their compiler up once into
+// a local `cc` rather than on every access.
+static Compiler* mc_active[MIMIC_CORE_COUNT];
+
+static inline Compiler* mc_self(void) {
+    return mc_active[MIMIC_CORE_ID()];
+}
 
 // ============================================================================
 // ERROR HANDLING
 // ============================================================================
 
 static void mc_error(const char* fmt, ...) {
+    Compiler* cc = mc_self();
     if (cc->had_error) return;
     
     va_list args;
@@ -216,40 +266,100 @@ static void mc_error(const char* fmt, ...) {
 // ============================================================================
 
 static int mc_getc(void) {
-    if (cc->in_pos >= cc->in_len) {
-        int n = mimic_fread(cc->in_fd, cc->in_buf, MC_INPUT_BUF);
-        if (n <= 0) return -1;
-        cc->in_len = n;
-        cc->in_pos = 0;
-    }
-    int c = cc->in_buf[cc->in_pos++];
+    Compiler* cc = mc_self();
+    MimicStream* in = &cc->in;
+    int c = in->buf_pos < in->buf_len ? in->buffer[in->buf_pos++] : mimic_stream_getc(in);
+    if (c < 0) return -1;
     if (c == '\n') { cc->line++; cc->col = 0; }
     else cc->col++;
     return c;
 }
 
 static void mc_ungetc(int c) {
+    Compiler* cc = mc_self();
     if (c < 0) return;
-    if (cc->in_pos > 0) {
-        cc->in_pos--;
-        cc->in_buf[cc->in_pos] = c;
-        if (c == '\n') cc->line--;
+    if (mimic_stream_ungetc(&cc->in, c) >= 0 && c == '\n') cc->line--;
+}
+
+// Comments are skipped a buffer window at a time rather than per byte.
+// Both leave the character after the comment (or -1) in cc->ch.
+
+static void mc_skip_line(void) {
+    Compiler* cc = mc_self();
+    const uint8_t* p;
+    uint32_t len;
+    
+    while (mimic_stream_peek(&cc->in, &p, &len) == MIMIC_OK && len > 0) {
+        const uint8_t* nl = memchr(p, '\n', len);
+        uint32_t n = nl ? (uint32_t)(nl - p) : len;
+        cc->col += n;
+        mimic_stream_consume(&cc->in, n);
+        if (nl) break;
+    }
+    cc->ch = mc_getc();
+}
+
+static void mc_skip_block(void) {
+    Compiler* cc = mc_self();
+    const uint8_t* p;
+    uint32_t len;
+    int prev = 0;
+    
+    while (mimic_stream_peek(&cc->in, &p, &len) == MIMIC_OK && len > 0) {
+        for (uint32_t i = 0; i < len; i++) {
+            if (p[i] == '\n') { cc->line++; cc->col = 0; }
+            else cc->col++;
+            
+            if (prev == '*' && p[i] == '/') {
+                mimic_stream_consume(&cc->in, i + 1);
+                cc->ch = mc_getc();
+                return;
+            }
+            prev = p[i];
+        }
+        mimic_stream_consume(&cc->in, len);
     }
+    cc->ch = -1;
 }
 
 // ============================================================================
 // OUTPUT BUFFERING
 // ============================================================================
 
+static void mc_write(const void* data, uint32_t size) {
+    Compiler* cc = mc_self();
+    if (!cc->to_memory) {
+        mimic_fwrite(cc->out_fd, data, size);
+        return;
+    }
+    
+    if (cc->image_len + size > cc->image_cap) {
+        uint32_t cap = cc->image_cap ? cc->image_cap : MC_OUTPUT_BUF;
+        while (cap < cc->image_len + size) cap *= 2;
+        
+        uint8_t* image = mimic_krealloc(cc->image, cap);
+        if (!image) {
+            mc_error("Out of memory for output image");
+            return;
+        }
+        cc->image = image;
+        cc->image_cap = cap;
+    }
+    memcpy(cc->image + cc->image_len, data, size);
+    cc->image_len += size;
+}
+
 static void mc_flush(void) {
+    Compiler* cc = mc_self();
     if (cc->out_pos > 0) {
-        mimic_fwrite(cc->out_fd, cc->out_buf, cc->out_pos);
+        mc_write(cc->out_buf, cc->out_pos);
         cc->bytes_out += cc->out_pos;
         cc->out_pos = 0;
     }
 }
 
 static void mc_emit8(uint8_t b) {
+    Compiler* cc = mc_self();
     if (cc->out_pos >= MC_OUTPUT_BUF) mc_flush();
     cc->out_buf[cc->out_pos++] = b;
     cc->code_pos++;
@@ -283,27 +393,142 @@ static const struct { const char* name; int tok; } keywords[] = {
     {"goto", TK_GOTO}, {"sizeof", TK_SIZEOF}, {NULL, 0}
 };
 
+// Close the program being defined: wrap defaults to its last instruction
+static void mc_pio_close(void) {
+    Compiler* cc = mc_self();
+    if (!cc->pio_open) return;
+    
+    MimiPioProgram* prog = (MimiPioProgram*)(cc->pio + cc->pio_cur);
+    if (prog->length == 0) mc_error("#pragma mimic pio: program has no code");
+    if (prog->wrap == 0xFF) prog->wrap = prog->length - 1;
+    if (prog->wrap_target >= prog->length || prog->wrap >= prog->length) {
+        mc_error("#pragma mimic pio: wrap outside the program");
+    }
+    cc->pio_open = false;
+}
+
+// #pragma mimic pio                        start a program
+// #pragma mimic pio_wrap <target> <wrap>
+// #pragma mimic pio_side <bits> [opt] [pindirs]
+// #pragma mimic pio_origin <offset>
+// #pragma mimic pio_code <hex>, ...         pioasm output, appended
+static void mc_pragma_pio(const char* key, const char* args) {
+    Compiler* cc = mc_self();
+    if (strcmp(key, "pio") == 0) {
+        mc_pio_close();
+        if (cc->pio_size + sizeof(MimiPioProgram) > MC_PIO_BYTES) {
+            mc_error("#pragma mimic pio: PIO section full");
+            return;
+        }
+        cc->pio_cur = cc->pio_size;
+        cc->pio_size += sizeof(MimiPioProgram);
+        cc->pio_open = true;
+        
+        MimiPioProgram* prog = (MimiPioProgram*)(cc->pio + cc->pio_cur);
+        memset(prog, 0, sizeof(MimiPioProgram));
+        prog->origin = -1;
+        prog->wrap = 0xFF;
+        return;
+    }
+    
+    if (!cc->pio_open) {
+        mc_error("#pragma mimic %s before #pragma mimic pio", key);
+        return;
+    }
+    MimiPioProgram* prog = (MimiPioProgram*)(cc->pio + cc->pio_cur);
+    
+    unsigned a, b;
+    if (strcmp(key, "pio_wrap") == 0 && sscanf(args, "%u %u", &a, &b) == 2) {
+        prog->wrap_target = a;
+        prog->wrap = b;
+    } else if (strcmp(key, "pio_side") == 0 && sscanf(args, "%u", &a) == 1 && a <= 5) {
+        prog->sideset_bits = a;
+        if (strstr(args, "opt")) prog->sideset_flags |= MIMI_PIO_SIDESET_OPT;
+        if (strstr(args, "pindirs")) prog->sideset_flags |= MIMI_PIO_SIDESET_PINDIRS;
+    } else if (strcmp(key, "pio_origin") == 0 && sscanf(args, "%u", &a) == 1 && a < 32) {
+        prog->origin = a;
+    } else if (strcmp(key, "pio_code") == 0) {
+        char* end;
+        unsigned long instr = strtoul(args, &end, 16);
+        while (end != args) {
+            if (prog->length >= MIMI_PIO_MAX_INSTR ||
+                cc->pio_size + sizeof(uint16_t) > MC_PIO_BYTES) {
+                mc_error("#pragma mimic pio: program too long");
+                return;
+            }
+            uint16_t word = instr;
+            memcpy(cc->pio + cc->pio_size, &word, sizeof(word));
+            cc->pio_size += sizeof(word);
+            prog->length++;
+            
+            args = end;
+            while (*args == ',' || *args == ' ') args++;
+            instr = strtoul(args, &end, 16);
+        }
+    } else {
+        mc_error("bad #pragma mimic %s", key);
+    }
+}
+
+// Preprocessor line. Only '#pragma mimic stack|heap <bytes>' and the
+// '#pragma mimic pio*' lines above mean anything; other directives
+// (#include, guards) are skipped.
+static void mc_directive(void) {
+    Compiler* cc = mc_self();
+    char line[128];
+    int len = 0;
+    uint32_t line_no = cc->line;
+    
+    cc->ch = mc_getc();
+    while (cc->ch >= 0 && cc->ch != '\n') {
+        if (len < (int)sizeof(line) - 1) line[len++] = cc->ch;
+        cc->ch = mc_getc();
+    }
+    line[len] = 0;
+    
+    char key[12];
+    int args = len;
+    if (sscanf(line, " pragma mimic %11s %n", key, &args) != 1) return;
+    
+    if (strncmp(key, "pio", 3) == 0) {
+        mc_pragma_pio(key, line + args);
+        return;
+    }
+    
+    unsigned long value;
+    if (sscanf(line + args, "%lu", &value) != 1) {
+        printf("[CC] Warning: line %lu: #pragma mimic %s needs a value\n",
+               (unsigned long)line_no, key);
+    } else if (strcmp(key, "stack") == 0) {
+        cc->pragma_stack = (value + 7) & ~7UL;
+    } else if (strcmp(key, "heap") == 0) {
+        cc->pragma_heap = (value + 7) & ~7UL;
+        cc->has_pragma_heap = true;
+    } else {
+        printf("[CC] Warning: line %lu: unknown #pragma mimic %s\n",
+               (unsigned long)line_no, key);
+    }
+}
+
 static void mc_next(void) {
+    Compiler* cc = mc_self();
     while (1) {
         // Skip whitespace
         while (cc->ch >= 0 && cc->ch <= ' ') cc->ch = mc_getc();
         
+        if (cc->ch == '#') {
+            mc_directive();
+            continue;
+        }
+        
         // Skip comments
         if (cc->ch == '/') {
             int c2 = mc_getc();
             if (c2 == '/') {
-                // Line comment
-                while (cc->ch >= 0 && cc->ch != '\n') cc->ch = mc_getc();
+                mc_skip_line();
                 continue;
             } else if (c2 == '*') {
-                // Block comment
-                int prev = 0;
-                cc->ch = mc_getc();
-                while (cc->ch >= 0 && !(prev == '*' && cc->ch == '/')) {
-                    prev = cc->ch;
-                    cc->ch = mc_getc();
-                }
-                cc->ch = mc_getc();
+                mc_skip_block();
                 continue;
             } else {
                 mc_ungetc(c2);
@@ -316,6 +541,9 @@ static void mc_next(void) {
     
     cc->tokens++;
     
+    // Token boundary: let more urgent kernel threads in if our slice is up
+    if ((cc->tokens & 15) == 0) mimic_kthread_preempt_point();
+    
     // Number
     if (isdigit(cc->ch)) {
         cc->tok_val = 0;
@@ -500,6 +728,7 @@ static void mc_next(void) {
 }
 
 static void mc_expect(int tok) {
+    Compiler* cc = mc_self();
     if (cc->tok != tok) {
         mc_error("Expected '%c', got '%c'", tok, cc->tok);
     }
@@ -511,6 +740,7 @@ static void mc_expect(int tok) {
 // ============================================================================
 
 static Type* mc_type_new(int kind, int size, int align) {
+    Compiler* cc = mc_self();
     if (cc->type_count >= MC_MAX_TYPES) {
         mc_error("Too many types");
         return cc->ty_int;
@@ -560,6 +790,7 @@ static uint32_t mc_hash(const char* s) {
 }
 
 static Symbol* mc_sym_find(const char* name) {
+    Compiler* cc = mc_self();
     uint32_t h = mc_hash(name);
     for (Symbol* s = cc->sym_hash[h]; s; s = s->next) {
         if (strcmp(s->name, name) == 0 && s->scope <= cc->scope) {
@@ -570,6 +801,7 @@ static Symbol* mc_sym_find(const char* name) {
 }
 
 static Symbol* mc_sym_add(const char* name, int kind, Type* type) {
+    Compiler* cc = mc_self();
     if (cc->sym_count >= MC_MAX_SYMBOLS) {
         mc_error("Too many symbols");
         return NULL;
@@ -591,10 +823,12 @@ static Symbol* mc_sym_add(const char* name, int kind, Type* type) {
 }
 
 static void mc_scope_enter(void) {
+    Compiler* cc = mc_self();
     cc->scope++;
 }
 
 static void mc_scope_leave(void) {
+    Compiler* cc = mc_self();
     // Remove symbols from hash table
     for (int i = 0; i < 64; i++) {
         while (cc->sym_hash[i] && cc->sym_hash[i]->scope == cc->scope) {
@@ -745,11 +979,16 @@ static void mc_thumb_strh_imm(int rt, int rn, int imm) {
 }
 
 static void mc_thumb_push(uint8_t regs, int lr) {
+    Compiler* cc = mc_self();
     mc_emit16(0xB400 | (lr << 8) | regs);
+    cc->push_depth += 4 * (__builtin_popcount(regs) + lr);
+    if (cc->push_depth > cc->push_max) cc->push_max = cc->push_depth;
 }
 
 static void mc_thumb_pop(uint8_t regs, int pc) {
+    Compiler* cc = mc_self();
     mc_emit16(0xBC00 | (pc << 8) | regs);
+    cc->push_depth -= 4 * (__builtin_popcount(regs) + pc);
 }
 
 static void mc_thumb_add_sp_imm(int imm) {
@@ -768,6 +1007,7 @@ static void mc_thumb_b(int offset) {
 }
 
 static uint32_t mc_thumb_b_placeholder(void) {
+    Compiler* cc = mc_self();
     uint32_t pos = cc->code_pos;
     mc_emit16(0xE000);  // Will be patched
     return pos;
@@ -785,6 +1025,7 @@ static void mc_thumb_bcc(int cond, int offset) {
 }
 
 static uint32_t mc_thumb_bcc_placeholder(int cond) {
+    Compiler* cc = mc_self();
     uint32_t pos = cc->code_pos;
     mc_emit16(0xD000 | (cond << 8));
     return pos;
@@ -832,25 +1073,23 @@ static void mc_thumb_svc(int imm) {
 // EXPRESSION CODEGEN
 // ============================================================================
 
-// Current register allocation (simple: always use r0-r3)
-static int mc_reg = 0;
-
 static void mc_load_imm(int val) {
+    Compiler* cc = mc_self();
     if (val >= 0 && val <= 255) {
-        mc_thumb_mov_imm8(mc_reg, val);
+        mc_thumb_mov_imm8(cc->reg, val);
     } else if (val >= -128 && val < 0) {
-        mc_thumb_mov_imm8(mc_reg, -val);
-        mc_thumb_neg(mc_reg, mc_reg);
+        mc_thumb_mov_imm8(cc->reg, -val);
+        mc_thumb_neg(cc->reg, cc->reg);
     } else {
         // Load from literal pool or synthesize
         // For now, use multiple adds
-        mc_thumb_mov_imm8(mc_reg, 0);
+        mc_thumb_mov_imm8(cc->reg, 0);
         int v = val;
         int shift = 0;
         while (v) {
             if (v & 0xFF) {
-                if (shift) mc_thumb_lsl_imm(mc_reg, mc_reg, shift);
-                mc_thumb_add_imm8(mc_reg, v & 0xFF);
+                if (shift) mc_thumb_lsl_imm(cc->reg, cc->reg, shift);
+                mc_thumb_add_imm8(cc->reg, v & 0xFF);
                 shift = 0;
             }
             v >>= 8;
@@ -864,6 +1103,7 @@ static Type* mc_expr_assign(void);
 static Type* mc_expr_unary(void);
 
 static Type* mc_expr_primary(void) {
+    Compiler* cc = mc_self();
     Type* ty = cc->ty_int;
     
     if (cc->tok == TK_NUM) {
@@ -900,21 +1140,32 @@ static Type* mc_expr_primary(void) {
             // Function call
             mc_next();
             int nargs = 0;
-            int saved_reg = mc_reg;
+            int saved_reg = cc->reg;
             
             while (cc->tok != ')' && cc->tok != TK_EOF) {
-                mc_reg = nargs;
+                cc->reg = nargs;
                 mc_expr_assign();
                 nargs++;
                 if (cc->tok == ',') mc_next();
             }
             mc_expect(')');
             
+            sym->called = 1;
+            
+            // Remember the edge for stack sizing
+            if (cc->cur_func && cc->call_count < MC_MAX_CALLS) {
+                cc->call_from[cc->call_count] = cc->cur_func - cc->symbols;
+                cc->call_to[cc->call_count] = sym - cc->symbols;
+                cc->call_count++;
+            } else if (cc->cur_func) {
+                cc->call_overflow = true;
+            }
+            
             // Call function (BL or BLX)
             // For now, emit SVC for syscalls
             mc_thumb_blx(0);  // TODO: actual function address
             
-            mc_reg = saved_reg;
+            cc->reg = saved_reg;
             if (sym->type && sym->type->kind == TY_FUNC && sym->type->base) {
                 return sym->type->base;  // Return type
             }
@@ -923,11 +1174,11 @@ static Type* mc_expr_primary(void) {
         
         // Variable access
         if (sym->kind == SYM_LOCAL || sym->kind == SYM_PARAM) {
-            mc_thumb_ldr_sp(mc_reg, sym->offset);
+            mc_thumb_ldr_sp(cc->reg, sym->offset);
         } else {
             // Global - load address then load value
             mc_load_imm(sym->offset);
-            mc_thumb_ldr_imm(mc_reg, mc_reg, 0);
+            mc_thumb_ldr_imm(cc->reg, cc->reg, 0);
         }
         
         return sym->type ? sym->type : cc->ty_int;
@@ -957,26 +1208,27 @@ static Type* mc_expr_primary(void) {
 }
 
 static Type* mc_expr_postfix(void) {
+    Compiler* cc = mc_self();
     Type* ty = mc_expr_primary();
     
     while (1) {
         if (cc->tok == '[') {
             // Array subscript
             mc_next();
-            mc_thumb_push(1 << mc_reg, 0);
-            mc_reg++;
+            mc_thumb_push(1 << cc->reg, 0);
+            cc->reg++;
             mc_expr();  // index expression
-            mc_reg--;
-            mc_thumb_pop(1 << (mc_reg + 1), 0);
+            cc->reg--;
+            mc_thumb_pop(1 << (cc->reg + 1), 0);
             
             // Calculate offset
             int elem_size = ty->base ? mc_type_size(ty->base) : 4;
             if (elem_size > 1) {
                 mc_load_imm(elem_size);
-                mc_thumb_mul(mc_reg, mc_reg);
+                mc_thumb_mul(cc->reg, cc->reg);
             }
-            mc_thumb_add_reg(mc_reg, mc_reg, mc_reg + 1);
-            mc_thumb_ldr_imm(mc_reg, mc_reg, 0);
+            mc_thumb_add_reg(cc->reg, cc->reg, cc->reg + 1);
+            mc_thumb_ldr_imm(cc->reg, cc->reg, 0);
             
             mc_expect(']');
             ty = ty->base ? ty->base : cc->ty_int;
@@ -986,8 +1238,8 @@ static Type* mc_expr_postfix(void) {
             int is_inc = cc->tok == TK_INC;
             mc_next();
             // TODO: proper implementation
-            if (is_inc) mc_thumb_add_imm8(mc_reg, 1);
-            else mc_thumb_sub_imm8(mc_reg, 1);
+            if (is_inc) mc_thumb_add_imm8(cc->reg, 1);
+            else mc_thumb_sub_imm8(cc->reg, 1);
         }
         else if (cc->tok == '.') {
             mc_next();
@@ -1010,32 +1262,33 @@ static Type* mc_expr_postfix(void) {
 }
 
 static Type* mc_expr_unary(void) {
+    Compiler* cc = mc_self();
     if (cc->tok == '-') {
         mc_next();
         Type* ty = mc_expr_unary();
-        mc_thumb_neg(mc_reg, mc_reg);
+        mc_thumb_neg(cc->reg, cc->reg);
         return ty;
     }
     if (cc->tok == '!') {
         mc_next();
         mc_expr_unary();
-        mc_thumb_cmp_imm8(mc_reg, 0);
-        mc_thumb_mov_imm8(mc_reg, 0);
+        mc_thumb_cmp_imm8(cc->reg, 0);
+        mc_thumb_mov_imm8(cc->reg, 0);
         // Set to 1 if was 0
         mc_thumb_bcc(CC_NE, 2);
-        mc_thumb_mov_imm8(mc_reg, 1);
+        mc_thumb_mov_imm8(cc->reg, 1);
         return cc->ty_int;
     }
     if (cc->tok == '~') {
         mc_next();
         Type* ty = mc_expr_unary();
-        mc_thumb_mvn(mc_reg, mc_reg);
+        mc_thumb_mvn(cc->reg, cc->reg);
         return ty;
     }
     if (cc->tok == '*') {
         mc_next();
         Type* ty = mc_expr_unary();
-        mc_thumb_ldr_imm(mc_reg, mc_reg, 0);
+        mc_thumb_ldr_imm(cc->reg, cc->reg, 0);
         return ty->base ? ty->base : cc->ty_int;
     }
     if (cc->tok == '&') {
@@ -1046,8 +1299,8 @@ static Type* mc_expr_unary(void) {
             if (sym) {
                 if (sym->kind == SYM_LOCAL || sym->kind == SYM_PARAM) {
                     // LEA: SP + offset
-                    mc_thumb_mov_reg(mc_reg, 13);  // SP
-                    mc_thumb_add_imm8(mc_reg, sym->offset);
+                    mc_thumb_mov_reg(cc->reg, 13);  // SP
+                    mc_thumb_add_imm8(cc->reg, sym->offset);
                 } else {
                     mc_load_imm(sym->offset);
                 }
@@ -1060,8 +1313,8 @@ static Type* mc_expr_unary(void) {
         int is_inc = cc->tok == TK_INC;
         mc_next();
         Type* ty = mc_expr_unary();
-        if (is_inc) mc_thumb_add_imm8(mc_reg, 1);
-        else mc_thumb_sub_imm8(mc_reg, 1);
+        if (is_inc) mc_thumb_add_imm8(cc->reg, 1);
+        else mc_thumb_sub_imm8(cc->reg, 1);
         return ty;
     }
     if (cc->tok == TK_SIZEOF) {
@@ -1083,20 +1336,21 @@ static Type* mc_expr_unary(void) {
 }
 
 static Type* mc_expr_mul(void) {
+    Compiler* cc = mc_self();
     Type* ty = mc_expr_unary();
     
     while (cc->tok == '*' || cc->tok == '/' || cc->tok == '%') {
         int op = cc->tok;
         mc_next();
         
-        mc_thumb_push(1 << mc_reg, 0);
-        mc_reg++;
+        mc_thumb_push(1 << cc->reg, 0);
+        cc->reg++;
         mc_expr_unary();
-        mc_reg--;
-        mc_thumb_pop(1 << (mc_reg + 1), 0);
+        cc->reg--;
+        mc_thumb_pop(1 << (cc->reg + 1), 0);
         
         if (op == '*') {
-            mc_thumb_mul(mc_reg, mc_reg + 1);
+            mc_thumb_mul(cc->reg, cc->reg + 1);
         } else {
             // Division needs library call
             mc_thumb_svc(op == '/' ? 1 : 2);  // div/mod syscall
@@ -1107,22 +1361,23 @@ static Type* mc_expr_mul(void) {
 }
 
 static Type* mc_expr_add(void) {
+    Compiler* cc = mc_self();
     Type* ty = mc_expr_mul();
     
     while (cc->tok == '+' || cc->tok == '-') {
         int op = cc->tok;
         mc_next();
         
-        mc_thumb_push(1 << mc_reg, 0);
-        mc_reg++;
+        mc_thumb_push(1 << cc->reg, 0);
+        cc->reg++;
         mc_expr_mul();
-        mc_reg--;
-        mc_thumb_pop(1 << (mc_reg + 1), 0);
+        cc->reg--;
+        mc_thumb_pop(1 << (cc->reg + 1), 0);
         
         if (op == '+') {
-            mc_thumb_add_reg(mc_reg, mc_reg, mc_reg + 1);
+            mc_thumb_add_reg(cc->reg, cc->reg, cc->reg + 1);
         } else {
-            mc_thumb_sub_reg(mc_reg, mc_reg + 1, mc_reg);
+            mc_thumb_sub_reg(cc->reg, cc->reg + 1, cc->reg);
         }
     }
     
@@ -1130,41 +1385,43 @@ static Type* mc_expr_add(void) {
 }
 
 static Type* mc_expr_shift(void) {
+    Compiler* cc = mc_self();
     Type* ty = mc_expr_add();
     
     while (cc->tok == TK_SHL || cc->tok == TK_SHR) {
         int op = cc->tok;
         mc_next();
         
-        mc_thumb_push(1 << mc_reg, 0);
-        mc_reg++;
+        mc_thumb_push(1 << cc->reg, 0);
+        cc->reg++;
         mc_expr_add();
-        mc_reg--;
-        mc_thumb_pop(1 << (mc_reg + 1), 0);
+        cc->reg--;
+        mc_thumb_pop(1 << (cc->reg + 1), 0);
         
-        if (op == TK_SHL) mc_thumb_lsl_reg(mc_reg + 1, mc_reg);
-        else mc_thumb_lsr_reg(mc_reg + 1, mc_reg);
-        mc_thumb_mov_reg(mc_reg, mc_reg + 1);
+        if (op == TK_SHL) mc_thumb_lsl_reg(cc->reg + 1, cc->reg);
+        else mc_thumb_lsr_reg(cc->reg + 1, cc->reg);
+        mc_thumb_mov_reg(cc->reg, cc->reg + 1);
     }
     
     return ty;
 }
 
 static Type* mc_expr_rel(void) {
+    Compiler* cc = mc_self();
     Type* ty = mc_expr_shift();
     
     while (cc->tok == '<' || cc->tok == '>' || cc->tok == TK_LE || cc->tok == TK_GE) {
         int op = cc->tok;
         mc_next();
         
-        mc_thumb_push(1 << mc_reg, 0);
-        mc_reg++;
+        mc_thumb_push(1 << cc->reg, 0);
+        cc->reg++;
         mc_expr_shift();
-        mc_reg--;
-        mc_thumb_pop(1 << (mc_reg + 1), 0);
+        cc->reg--;
+        mc_thumb_pop(1 << (cc->reg + 1), 0);
         
-        mc_thumb_cmp_reg(mc_reg + 1, mc_reg);
-        mc_thumb_mov_imm8(mc_reg, 0);
+        mc_thumb_cmp_reg(cc->reg + 1, cc->reg);
+        mc_thumb_mov_imm8(cc->reg, 0);
         
         int cond;
         switch (op) {
@@ -1175,7 +1432,7 @@ static Type* mc_expr_rel(void) {
             default:    cond = CC_AL; break;
         }
         mc_thumb_bcc(cond, 2);
-        mc_thumb_mov_imm8(mc_reg, 1);
+        mc_thumb_mov_imm8(cc->reg, 1);
         ty = cc->ty_int;
     }
     
@@ -1183,22 +1440,23 @@ static Type* mc_expr_rel(void) {
 }
 
 static Type* mc_expr_eq(void) {
+    Compiler* cc = mc_self();
     Type* ty = mc_expr_rel();
     
     while (cc->tok == TK_EQ || cc->tok == TK_NE) {
         int op = cc->tok;
         mc_next();
         
-        mc_thumb_push(1 << mc_reg, 0);
-        mc_reg++;
+        mc_thumb_push(1 << cc->reg, 0);
+        cc->reg++;
         mc_expr_rel();
-        mc_reg--;
-        mc_thumb_pop(1 << (mc_reg + 1), 0);
+        cc->reg--;
+        mc_thumb_pop(1 << (cc->reg + 1), 0);
         
-        mc_thumb_cmp_reg(mc_reg + 1, mc_reg);
-        mc_thumb_mov_imm8(mc_reg, 0);
+        mc_thumb_cmp_reg(cc->reg + 1, cc->reg);
+        mc_thumb_mov_imm8(cc->reg, 0);
         mc_thumb_bcc(op == TK_EQ ? CC_NE : CC_EQ, 2);
-        mc_thumb_mov_imm8(mc_reg, 1);
+        mc_thumb_mov_imm8(cc->reg, 1);
         ty = cc->ty_int;
     }
     
@@ -1206,65 +1464,69 @@ static Type* mc_expr_eq(void) {
 }
 
 static Type* mc_expr_and(void) {
+    Compiler* cc = mc_self();
     Type* ty = mc_expr_eq();
     
     while (cc->tok == '&') {
         mc_next();
-        mc_thumb_push(1 << mc_reg, 0);
-        mc_reg++;
+        mc_thumb_push(1 << cc->reg, 0);
+        cc->reg++;
         mc_expr_eq();
-        mc_reg--;
-        mc_thumb_pop(1 << (mc_reg + 1), 0);
-        mc_thumb_and_reg(mc_reg, mc_reg + 1);
+        cc->reg--;
+        mc_thumb_pop(1 << (cc->reg + 1), 0);
+        mc_thumb_and_reg(cc->reg, cc->reg + 1);
     }
     
     return ty;
 }
 
 static Type* mc_expr_xor(void) {
+    Compiler* cc = mc_self();
     Type* ty = mc_expr_and();
     
     while (cc->tok == '^') {
         mc_next();
-        mc_thumb_push(1 << mc_reg, 0);
-        mc_reg++;
+        mc_thumb_push(1 << cc->reg, 0);
+        cc->reg++;
         mc_expr_and();
-        mc_reg--;
-        mc_thumb_pop(1 << (mc_reg + 1), 0);
-        mc_thumb_eor_reg(mc_reg, mc_reg + 1);
+        cc->reg--;
+        mc_thumb_pop(1 << (cc->reg + 1), 0);
+        mc_thumb_eor_reg(cc->reg, cc->reg + 1);
     }
     
     return ty;
 }
 
 static Type* mc_expr_or(void) {
+    Compiler* cc = mc_self();
     Type* ty = mc_expr_xor();
     
     while (cc->tok == '|') {
         mc_next();
-        mc_thumb_push(1 << mc_reg, 0);
-        mc_reg++;
+        mc_thumb_push(1 << cc->reg, 0);
+        cc->reg++;
         mc_expr_xor();
-        mc_reg--;
-        mc_thumb_pop(1 << (mc_reg + 1), 0);
-        mc_thumb_orr_reg(mc_reg, mc_reg + 1);
+        cc->reg--;
+        mc_thumb_pop(1 << (cc->reg + 1), 0);
+        mc_thumb_orr_reg(cc->reg, cc->reg + 1);
     }
     
     return ty;
 }
 
 static Type* mc_expr_land(void) {
+    Compiler* cc = mc_self();
     Type* ty = mc_expr_or();
     
     while (cc->tok == TK_AND) {
         mc_next();
-        mc_thumb_cmp_imm8(mc_reg, 0);
+        mc_thumb_cmp_imm8(cc->reg, 0);
         (void)mc_thumb_bcc_placeholder(CC_EQ);  // TODO: patch
         mc_expr_or();
-        mc_thumb_cmp_imm8(mc_reg, 0);
-        mc_thumb_mov_imm8(mc_reg, 0);
+        mc_thumb_cmp_imm8(cc->reg, 0);
+        mc_thumb_mov_imm8(cc->reg, 0);
         mc_thumb_bcc(CC_EQ, 2);
-        mc_thumb_mov_imm8(mc_reg, 1);
+        mc_thumb_mov_imm8(cc->reg, 1);
         ty = cc->ty_int;
     }
     
@@ -1272,17 +1534,18 @@ static Type* mc_expr_land(void) {
 }
 
 static Type* mc_expr_lor(void) {
+    Compiler* cc = mc_self();
     Type* ty = mc_expr_land();
     
     while (cc->tok == TK_OR) {
         mc_next();
-        mc_thumb_cmp_imm8(mc_reg, 0);
+        mc_thumb_cmp_imm8(cc->reg, 0);
         (void)mc_thumb_bcc_placeholder(CC_NE);  // TODO: patch
         mc_expr_land();
-        mc_thumb_cmp_imm8(mc_reg, 0);
-        mc_thumb_mov_imm8(mc_reg, 0);
+        mc_thumb_cmp_imm8(cc->reg, 0);
+        mc_thumb_mov_imm8(cc->reg, 0);
         mc_thumb_bcc(CC_EQ, 2);
-        mc_thumb_mov_imm8(mc_reg, 1);
+        mc_thumb_mov_imm8(cc->reg, 1);
         ty = cc->ty_int;
     }
     
@@ -1290,11 +1553,12 @@ static Type* mc_expr_lor(void) {
 }
 
 static Type* mc_expr_ternary(void) {
+    Compiler* cc = mc_self();
     Type* ty = mc_expr_lor();
     
     if (cc->tok == '?') {
         mc_next();
-        mc_thumb_cmp_imm8(mc_reg, 0);
+        mc_thumb_cmp_imm8(cc->reg, 0);
         (void)mc_thumb_bcc_placeholder(CC_EQ);  // TODO: patch else_jump
         mc_expr();
         (void)mc_thumb_b_placeholder();  // TODO: patch end_jump
@@ -1306,6 +1570,7 @@ static Type* mc_expr_ternary(void) {
 }
 
 static Type* mc_expr_assign(void) {
+    Compiler* cc = mc_self();
     Type* ty = mc_expr_ternary();
     
     if (cc->tok == '=' || 
@@ -1326,6 +1591,7 @@ static Type* mc_expr_assign(void) {
 }
 
 static Type* mc_expr(void) {
+    Compiler* cc = mc_self();
     Type* ty = mc_expr_assign();
     
     while (cc->tok == ',') {
@@ -1343,6 +1609,7 @@ static Type* mc_expr(void) {
 static void mc_stmt(void);
 
 static void mc_stmt_block(void) {
+    Compiler* cc = mc_self();
     mc_expect('{');
     mc_scope_enter();
     
@@ -1355,12 +1622,13 @@ static void mc_stmt_block(void) {
 }
 
 static void mc_stmt_if(void) {
+    Compiler* cc = mc_self();
     mc_next();  // Skip 'if'
     mc_expect('(');
     mc_expr();
     mc_expect(')');
     
-    mc_thumb_cmp_imm8(mc_reg, 0);
+    mc_thumb_cmp_imm8(cc->reg, 0);
     (void)mc_thumb_bcc_placeholder(CC_EQ);  // TODO: patch else_jump
     
     mc_stmt();
@@ -1373,6 +1641,7 @@ static void mc_stmt_if(void) {
 }
 
 static void mc_stmt_while(void) {
+    Compiler* cc = mc_self();
     mc_next();  // Skip 'while'
     
     uint32_t loop_start = cc->code_pos;
@@ -1381,7 +1650,7 @@ static void mc_stmt_while(void) {
     mc_expr();
     mc_expect(')');
     
-    mc_thumb_cmp_imm8(mc_reg, 0);
+    mc_thumb_cmp_imm8(cc->reg, 0);
     (void)mc_thumb_bcc_placeholder(CC_EQ);  // TODO: patch exit_jump
     
     // Push break/continue targets
@@ -1398,6 +1667,7 @@ static void mc_stmt_while(void) {
 }
 
 static void mc_stmt_for(void) {
+    Compiler* cc = mc_self();
     mc_next();  // Skip 'for'
     mc_expect('(');
     
@@ -1412,7 +1682,7 @@ static void mc_stmt_for(void) {
     // Condition
     if (cc->tok != ';') {
         mc_expr();
-        mc_thumb_cmp_imm8(mc_reg, 0);
+        mc_thumb_cmp_imm8(cc->reg, 0);
         (void)mc_thumb_bcc_placeholder(CC_EQ);  // TODO: patch exit_jump
     }
     mc_expect(';');
@@ -1436,10 +1706,11 @@ static void mc_stmt_for(void) {
 }
 
 static void mc_stmt_return(void) {
+    Compiler* cc = mc_self();
     mc_next();  // Skip 'return'
     
     if (cc->tok != ';') {
-        mc_reg = 0;  // Return value in r0
+        cc->reg = 0;  // Return value in r0
         mc_expr();
     }
     
@@ -1450,6 +1721,7 @@ static void mc_stmt_return(void) {
 }
 
 static void mc_stmt(void) {
+    Compiler* cc = mc_self();
     if (cc->had_error) return;
     
     if (cc->tok == '{') {
@@ -1472,7 +1744,7 @@ static void mc_stmt(void) {
         mc_expect('(');
         mc_expr();
         mc_expect(')');
-        mc_thumb_cmp_imm8(mc_reg, 0);
+        mc_thumb_cmp_imm8(cc->reg, 0);
         mc_thumb_bcc(CC_NE, loop_start - cc->code_pos - 4);
         mc_expect(';');
     }
@@ -1513,7 +1785,7 @@ static void mc_stmt(void) {
             if (cc->tok == '=') {
                 mc_next();
                 mc_expr();
-                mc_thumb_str_sp(mc_reg, -cc->local_offset);
+                mc_thumb_str_sp(cc->reg, -cc->local_offset);
             }
             
             while (cc->tok == ',') {
@@ -1529,7 +1801,7 @@ static void mc_stmt(void) {
                     if (cc->tok == '=') {
                         mc_next();
                         mc_expr();
-                        mc_thumb_str_sp(mc_reg, -cc->local_offset);
+                        mc_thumb_str_sp(cc->reg, -cc->local_offset);
                     }
                 }
             }
@@ -1547,12 +1819,18 @@ static void mc_stmt(void) {
 // ============================================================================
 
 static void mc_function(const char* name, Type* ret_type) {
+    Compiler* cc = mc_self();
+    // Function symbol lives in the enclosing scope so later code can call
+    // it; a prototype seen earlier is reused by the definition.
+    Symbol* func = mc_sym_find(name);
+    if (!func || func->kind != SYM_FUNC || func->scope != cc->scope) {
+        func = mc_sym_add(name, SYM_FUNC, ret_type);
+        if (!func) return;
+    }
+    
     mc_scope_enter();
     cc->local_offset = 0;
     
-    Symbol* func = mc_sym_add(name, SYM_FUNC, ret_type);
-    func->offset = cc->code_pos;  // Function address
-    
     // Parse parameters
     mc_expect('(');
     int param_count = 0;
@@ -1583,6 +1861,18 @@ static void mc_function(const char* name, Type* ret_type) {
     
     // Function body
     printf("[CC] Compiling function: %s\n", name);
+    mimic_trace(MIMIC_TRACE_CC_FUNC, cc->line, cc->code_pos);
+    cc->functions++;
+    
+    // Symbol offsets are 16-bit signed; past that the address is lost
+    if (cc->code_pos > INT16_MAX) {
+        mc_error("Function '%s' starts beyond 32 KB of code", name);
+    }
+    func->offset = cc->code_pos;  // Function address
+    func->defined = 1;
+    cc->cur_func = func;
+    cc->push_depth = 0;
+    cc->push_max = 0;
     
     // Prologue: PUSH {lr}
     mc_thumb_push(0, 1);
@@ -1604,6 +1894,9 @@ static void mc_function(const char* name, Type* ret_type) {
     }
     mc_thumb_pop(0, 1);  // POP {pc}
     
+    func->frame = cc->push_max - cc->local_offset;
+    cc->cur_func = NULL;
+    
     mc_scope_leave();
 }
 
@@ -1612,6 +1905,7 @@ static void mc_function(const char* name, Type* ret_type) {
 // ============================================================================
 
 static void mc_global_decl(void) {
+    Compiler* cc = mc_self();
     // Storage class (parsed but not fully used yet)
     if (cc->tok == TK_STATIC) mc_next();
     if (cc->tok == TK_EXTERN) mc_next();
@@ -1706,20 +2000,59 @@ static void mc_global_decl(void) {
 }
 
 static void mc_translation_unit(void) {
+    Compiler* cc = mc_self();
     while (cc->tok != TK_EOF && !cc->had_error) {
         mc_global_decl();
     }
 }
 
 // ============================================================================
-// PUBLIC API
+// COMPILE JOB
 // ============================================================================
 
-int mimic_compile(const char* input_path, const char* output_path) {
-    // Allocate compiler state
-    static Compiler compiler;
-    cc = &compiler;
+// A compile is split into begin / step / end so it can run to completion
+// from the shell, one top-level declaration per slice from a kernel
+// thread, or on core 1 for make. Each job owns its Compiler and buffers
+// (kernel heap); mc_active[] points each core at the job it is stepping.
+
+static char mc_last_error[MIMIC_CORE_COUNT][128];
+
+// Background job ('cc -b') bookkeeping
+static Compiler* mc_bg;
+static MimicCompileProgress mc_progress;
+static bool mc_has_run;
+static bool mc_bg_stepping;     // mc_bg_thread is up the call stack
+static bool mc_bg_killed;       // Task was killed while stepping
+
+static void mc_release(void) {
+    Compiler* cc = mc_self();
+    if (cc->in.fd >= 0) mimic_stream_close(&cc->in);
+    if (cc->out_fd >= 0) mimic_fclose(cc->out_fd);
+    if (cc->in_buf) mimic_kfree(cc->in_buf);
+    if (cc->out_buf) mimic_kfree(cc->out_buf);
+    cc->out_fd = -1;
+    cc->in_buf = NULL;
+    cc->out_buf = NULL;
+}
+
+static void mc_update_progress(Compiler* c) {
+    mc_progress.line = c->line;
+    mc_progress.tokens = c->tokens;
+    mc_progress.functions = c->functions;
+    mc_progress.bytes_out = c->bytes_out + c->out_pos;
+    
+    int32_t pos = mimic_ftell(c->in.fd);
+    if (pos >= 0) mc_progress.bytes_in = (uint32_t)pos - (c->in.buf_len - c->in.buf_pos);
+}
+
+static int mc_begin(const char* input_path, const char* output_path, bool to_memory) {
+    Compiler* cc = mc_self();
     memset(cc, 0, sizeof(Compiler));
+    cc->in.fd = -1;
+    cc->out_fd = -1;
+    cc->to_memory = to_memory;
+    cc->start_ms = mimic_get_uptime_ms();
+    mimic_trace(MIMIC_TRACE_CC_BEGIN, 0, 0);
     
     // Allocate buffers
     cc->in_buf = mimic_kmalloc(MC_INPUT_BUF);
@@ -1727,8 +2060,8 @@ int mimic_compile(const char* input_path, const char* output_path) {
     
     if (!cc->in_buf || !cc->out_buf) {
         printf("[CC] Out of memory\n");
-        if (cc->in_buf) mimic_kfree(cc->in_buf);
-        if (cc->out_buf) mimic_kfree(cc->out_buf);
+        snprintf(cc->error, sizeof(cc->error), "Out of memory");
+        mc_release();
         return MIMIC_ERR_NOMEM;
     }
     
@@ -1739,20 +2072,20 @@ int mimic_compile(const char* input_path, const char* output_path) {
     cc->ty_long = mc_type_new(TY_LONG, 4, 4);
     
     // Open files
-    cc->in_fd = mimic_fopen(input_path, MIMIC_FILE_READ);
-    if (cc->in_fd < 0) {
+    if (mimic_stream_open(&cc->in, input_path, MIMIC_FILE_READ, cc->in_buf, MC_INPUT_BUF) < 0) {
         printf("[CC] Cannot open input: %s\n", input_path);
-        mimic_kfree(cc->in_buf);
-        mimic_kfree(cc->out_buf);
+        snprintf(cc->error, sizeof(cc->error), "Cannot open input: %s", input_path);
+        mc_release();
         return MIMIC_ERR_NOENT;
     }
     
-    cc->out_fd = mimic_fopen(output_path, MIMIC_FILE_WRITE | MIMIC_FILE_CREATE);
-    if (cc->out_fd < 0) {
+    if (!to_memory) {
+        cc->out_fd = mimic_fopen(output_path, MIMIC_FILE_WRITE | MIMIC_FILE_CREATE | MIMIC_FILE_TRUNC);
+    }
+    if (!to_memory && cc->out_fd < 0) {
         printf("[CC] Cannot create output: %s\n", output_path);
-        mimic_fclose(cc->in_fd);
-        mimic_kfree(cc->in_buf);
-        mimic_kfree(cc->out_buf);
+        snprintf(cc->error, sizeof(cc->error), "Cannot create output: %s", output_path);
+        mc_release();
         return MIMIC_ERR_IO;
     }
     
@@ -1763,49 +2096,355 @@ int mimic_compile(const char* input_path, const char* output_path) {
     cc->ch = mc_getc();
     
     // Write placeholder header (will be updated later)
-    MimiHeader header;
-    memset(&header, 0, sizeof(header));
-    header.magic = MIMI_MAGIC;
-    header.version = MIMI_VERSION;
-    header.arch = MIMI_ARCH_THUMB;
+    MimiHeader* hdr = &cc->header;
+    hdr->magic = MIMI_MAGIC;
+    hdr->version = MIMI_VERSION;
+    hdr->arch = MIMI_ARCH_THUMB;
+    
+    // Program name = output basename without extension; the loader uses
+    // it as the task name.
+    const char* base = strrchr(output_path, '/');
+    base = base ? base + 1 : output_path;
+    for (int i = 0; i < 15 && base[i] && base[i] != '.'; i++) {
+        hdr->name[i] = base[i];
+    }
     mc_flush();
-    mimic_fwrite(cc->out_fd, &header, sizeof(header));
-    cc->code_pos = sizeof(header);
+    mc_write(hdr, sizeof(MimiHeader));
+    cc->code_pos = sizeof(MimiHeader);
     
     // Parse and compile
     printf("[CC] Compiling %s...\n", input_path);
     mc_next();  // Get first token
-    mc_translation_unit();
+    
+    return MIMIC_OK;
+}
+
+// Compile one top-level declaration. MIMIC_ERR_BUSY means more remain.
+static int mc_step(void) {
+    Compiler* cc = mc_self();
+    if (cc->tok == TK_EOF || cc->had_error) return MIMIC_OK;
+    
+    mc_global_decl();
+    return MIMIC_ERR_BUSY;
+}
+
+// ============================================================================
+// STACK AND HEAP SIZING
+// ============================================================================
+
+// Worst-case stack below fn: its own frame plus its deepest callee.
+// A callee already on the current path means recursion; that edge
+// contributes nothing and the result is only a lower bound.
+static uint32_t mc_stack_depth(Symbol* fn) {
+    Compiler* cc = mc_self();
+    if (fn->kind != SYM_FUNC || !fn->defined) return MC_EXTERN_FRAME;
+    if (fn->visit == 2) return fn->stack;
+    if (fn->visit == 1) {
+        if (!cc->recursive) cc->recursive = fn;
+        return 0;
+    }
+    
+    fn->visit = 1;
+    uint32_t deepest = 0;
+    uint32_t idx = fn - cc->symbols;
+    for (uint32_t i = 0; i < cc->call_count; i++) {
+        if (cc->call_from[i] != idx) continue;
+        uint32_t d = mc_stack_depth(&cc->symbols[cc->call_to[i]]);
+        if (d > deepest) deepest = d;
+    }
+    fn->visit = 2;
+    
+    uint32_t depth = fn->frame + deepest;
+    fn->stack = depth > 0xFFFF ? 0xFFFF : depth;
+    return fn->stack;
+}
+
+// Fill in stack_request / heap_request. The stack is the deepest chain
+// from any function defined here (main's, for a program); objects for
+// make are sized the same way and summed by the linker.
+static void mc_size_memory(MimiHeader* hdr) {
+    Compiler* cc = mc_self();
+    uint32_t depth = 0;
+    for (uint32_t i = 0; i < cc->sym_count; i++) {
+        Symbol* sym = &cc->symbols[i];
+        if (sym->kind != SYM_FUNC || !sym->defined) continue;
+        uint32_t d = mc_stack_depth(sym);
+        if (d > depth) depth = d;
+    }
+    
+    if (cc->recursive) {
+        hdr->flags |= MIMI_FLAG_RECURSIVE;
+        if (!cc->pragma_stack) {
+            printf("[CC] Warning: %s is recursive; stack size unknown "
+                   "(use #pragma mimic stack <bytes>)\n", cc->recursive->name);
+        }
+    } else if (cc->call_overflow) {
+        printf("[CC] Warning: call graph too large to size the stack\n");
+    } else if (depth > 0) {
+        hdr->stack_request = (depth + MC_STACK_MARGIN + 7) & ~7;
+    }
+    
+    if (cc->pragma_stack) hdr->stack_request = cc->pragma_stack;
+    if (cc->has_pragma_heap) {
+        hdr->heap_request = cc->pragma_heap;
+        hdr->flags |= MIMI_FLAG_HEAP_HINT;
+    }
+}
+
+static int mc_finish(void) {
+    Compiler* cc = mc_self();
+    MimiHeader* hdr = &cc->header;
     
     // Flush output
     mc_flush();
     
-    // Update header
-    header.entry_offset = sizeof(header);  // First function
-    header.text_size = cc->code_pos - sizeof(header);
-    header.rodata_size = 0;
-    header.data_size = 0;
-    header.bss_size = cc->bss_pos;
+    // PIO section: no .rodata or .data yet, so it follows .text directly
+    mc_pio_close();
+    if (!cc->had_error && cc->pio_size > 0) mc_write(cc->pio, cc->pio_size);
+    
+    // Symbol table of defined functions (text-relative) so objects can
+    // be linked; the loader stops reading after the relocations.
+    uint32_t entry = 0;
+    uint32_t nsyms = 0;
+    for (uint32_t i = 0; i < cc->sym_count && !cc->had_error; i++) {
+        Symbol* sym = &cc->symbols[i];
+        if (sym->kind != SYM_FUNC) continue;
+        
+        // Calls are not relocated yet, so the linker has to know
+        if (!sym->defined) {
+            if (sym->called) hdr->flags |= MIMI_FLAG_EXTERN_CALLS;
+            continue;
+        }
+        
+        MimiSymbol ms;
+        memset(&ms, 0, sizeof(ms));
+        strncpy(ms.name, sym->name, sizeof(ms.name));
+        ms.value = (uint32_t)sym->offset - sizeof(MimiHeader);
+        ms.section = MIMI_SECT_TEXT;
+        ms.type = MIMI_SYM_GLOBAL;
+        mc_write(&ms, sizeof(ms));
+        nsyms++;
+        
+        if (strcmp(sym->name, "main") == 0) entry = ms.value;
+    }
     
-    mimic_fseek(cc->out_fd, 0, MIMIC_SEEK_SET);
-    mimic_fwrite(cc->out_fd, &header, sizeof(header));
+    // Update header
+    hdr->entry_offset = entry;
+    hdr->text_size = cc->code_pos - sizeof(MimiHeader);
+    hdr->rodata_size = 0;
+    hdr->pio_size = cc->pio_size;
+    hdr->data_size = 0;
+    hdr->bss_size = cc->bss_pos;
+    hdr->symbol_count = nsyms;
+    if (!cc->had_error) mc_size_memory(hdr);
+    
+    if (cc->to_memory) {
+        if (cc->image) memcpy(cc->image, hdr, sizeof(MimiHeader));
+    } else {
+        mimic_fseek(cc->out_fd, 0, MIMIC_SEEK_SET);
+        mimic_fwrite(cc->out_fd, hdr, sizeof(MimiHeader));
+    }
     
     // Cleanup
-    mimic_fclose(cc->in_fd);
-    mimic_fclose(cc->out_fd);
-    mimic_kfree(cc->in_buf);
-    mimic_kfree(cc->out_buf);
+    mc_release();
     
     if (cc->had_error) {
         printf("[CC] Compilation failed: %s (line %lu)\n", cc->error, (unsigned long)cc->error_line);
         return MIMIC_ERR_CORRUPT;
     }
     
-    printf("[CC] Success: %lu tokens, %lu bytes code\n", 
-           (unsigned long)cc->tokens, (unsigned long)cc->bytes_out);
+    printf("[CC] Success: %lu tokens, %lu bytes code, %lu stack%s\n", 
+           (unsigned long)cc->tokens, (unsigned long)cc->bytes_out,
+           (unsigned long)hdr->stack_request,
+           (hdr->flags & MIMI_FLAG_RECURSIVE) ? " (recursive)" : "");
+    return MIMIC_OK;
+}
+
+static Compiler* mc_job_begin(const char* input_path, const char* output_path,
+                              bool to_memory, int* err) {
+    char* last_error = mc_last_error[MIMIC_CORE_ID()];
+    
+    Compiler* c = mimic_kmalloc(sizeof(Compiler));
+    if (!c) {
+        strcpy(last_error, "Out of memory");
+        *err = MIMIC_ERR_NOMEM;
+        return NULL;
+    }
+    
+    Compiler** active = &mc_active[MIMIC_CORE_ID()];
+    Compiler* saved = *active;
+    *active = c;
+    *err = mc_begin(input_path, output_path, to_memory);
+    if (*err != MIMIC_OK) {
+        mimic_trace(MIMIC_TRACE_CC_END, 0, *err);
+        mimic_perf_inc(MIMIC_PERF_CC_JOBS);
+        mimic_perf_inc(MIMIC_PERF_CC_ERRORS);
+        strcpy(last_error, c->error);
+        mimic_kfree(c);
+        c = NULL;
+    }
+    *active = saved;
+    return c;
+}
+
+MimicCompiler* mimic_compile_begin(const char* input_path, const char* output_path, int* err) {
+    return mc_job_begin(input_path, output_path, false, err);
+}
+
+int mimic_compile_step(MimicCompiler* c) {
+    Compiler** active = &mc_active[MIMIC_CORE_ID()];
+    Compiler* saved = *active;
+    *active = c;
+    int err = mc_step();
+    *active = saved;
+    return err;
+}
+
+static int mc_job_end(Compiler* c, uint8_t** image, uint32_t* size) {
+    Compiler** active = &mc_active[MIMIC_CORE_ID()];
+    Compiler* saved = *active;
+    *active = c;
+    int result = mc_finish();
+    mimic_trace(MIMIC_TRACE_CC_END, 0, result);
+    
+    mimic_perf_inc(MIMIC_PERF_CC_JOBS);
+    mimic_perf_add(MIMIC_PERF_CC_TOKENS, c->tokens);
+    mimic_perf_add(MIMIC_PERF_CC_FUNCTIONS, c->functions);
+    mimic_perf_add(MIMIC_PERF_CC_BYTES, c->bytes_out);
+    if (result != MIMIC_OK) mimic_perf_inc(MIMIC_PERF_CC_ERRORS);
+    strcpy(mc_last_error[MIMIC_CORE_ID()], c->error);
+    *active = saved;
+    
+    if (image && result == MIMIC_OK) {
+        *image = c->image;
+        *size = c->image_len;
+    } else if (c->image) {
+        mimic_kfree(c->image);
+    }
+    mimic_kfree(c);
+    return result;
+}
+
+int mimic_compile_end(MimicCompiler* c) {
+    return mc_job_end(c, NULL, NULL);
+}
+
+// Close out the background job. A killed job keeps its partial output
+// but is reported as failed.
+static int mc_bg_finish(bool killed) {
+    if (killed) {
+        mc_bg->had_error = 1;
+        strcpy(mc_bg->error, "Killed");
+    }
+    
+    mc_progress.elapsed_ms = mimic_get_uptime_ms() - mc_bg->start_ms;
+    int err = mimic_compile_end(mc_bg);
+    mc_bg = NULL;
+    mc_bg_killed = false;
+    mc_progress.active = false;
+    mc_progress.result = err;
+    
+    printf("\n[CC] Background compile %s: %s -> %s\n",
+           killed ? "killed" : err == MIMIC_OK ? "done" : "FAILED",
+           mc_progress.input, mc_progress.output);
+    return err;
+}
+
+static int mc_bg_thread(void* arg) {
+    (void)arg;
+    
+    // Yield back to the scheduler at function boundaries once the slice
+    // is spent; token-level preemption happens inside mc_next(), and
+    // whatever runs there may kill this task.
+    int err;
+    mc_bg_stepping = true;
+    do {
+        err = mimic_compile_step(mc_bg);
+    } while (err == MIMIC_ERR_BUSY && !mc_bg_killed &&
+             !mimic_kthread_should_yield());
+    mc_bg_stepping = false;
+    
+    if (mc_bg_killed) return mc_bg_finish(true);
+    
+    mc_update_progress(mc_bg);
+    if (err == MIMIC_ERR_BUSY) return err;
+    
+    return mc_bg_finish(false);
+}
+
+void mimic_compile_release_task(uint32_t task_id) {
+    if (!mc_bg || mc_progress.task_id != (int)task_id) return;
+    
+    // Killed from inside one of our own steps: the job is still in use,
+    // so let mc_bg_thread unwind and close it
+    if (mc_bg_stepping) {
+        mc_bg_killed = true;
+        return;
+    }
+    mc_bg_finish(true);
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int mimic_compile(const char* input_path, const char* output_path) {
+    int err;
+    MimicCompiler* c = mimic_compile_begin(input_path, output_path, &err);
+    if (!c) return err;
+    
+    while (mimic_compile_step(c) == MIMIC_ERR_BUSY);
+    
+    return mimic_compile_end(c);
+}
+
+int mimic_compile_mem(const char* input_path, const char* output_path,
+                      uint8_t** image, uint32_t* size) {
+    int err;
+    Compiler* c = mc_job_begin(input_path, output_path, true, &err);
+    if (!c) return err;
+    
+    while (mimic_compile_step(c) == MIMIC_ERR_BUSY);
+    
+    return mc_job_end(c, image, size);
+}
+
+int mimic_compile_bg(const char* input_path, const char* output_path) {
+    if (mc_bg) return MIMIC_ERR_BUSY;
+    
+    int err;
+    Compiler* c = mimic_compile_begin(input_path, output_path, &err);
+    if (!c) return err;
+    
+    int task_id = mimic_kthread_spawn("cc", MIMIC_PRIO_BACKGROUND, mc_bg_thread, NULL);
+    if (task_id < 0) {
+        mimic_compile_end(c);
+        return task_id;
+    }
+    
+    mc_bg = c;
+    memset(&mc_progress, 0, sizeof(mc_progress));
+    mc_progress.active = true;
+    mc_progress.task_id = task_id;
+    mc_progress.result = MIMIC_ERR_BUSY;
+    mc_progress.bytes_total = (uint32_t)mimic_fsize(c->in.fd);
+    strncpy(mc_progress.input, input_path, sizeof(mc_progress.input) - 1);
+    strncpy(mc_progress.output, output_path, sizeof(mc_progress.output) - 1);
+    mc_has_run = true;
+    
+    return task_id;
+}
+
+int mimic_compile_progress(MimicCompileProgress* progress) {
+    if (!mc_has_run) return MIMIC_ERR_NOENT;
+    
+    *progress = mc_progress;
+    if (mc_bg) {
+        progress->elapsed_ms = mimic_get_uptime_ms() - mc_bg->start_ms;
+    }
     return MIMIC_OK;
 }
 
 const char* mimic_compile_error(void) {
-    return cc ? cc->error : "No compiler state";
+    return mc_last_error[MIMIC_CORE_ID()];
 }
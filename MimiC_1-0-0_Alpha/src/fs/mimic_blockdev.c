@@ -0,0 +1,215 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC Block Devices - SD, RAM disk and flash region backends             ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  The firmware backends behind mimic_blockdev.h                            ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * The SD backend is a thin shim over the SPI driver in mimic_fat32.c, which
+ * does the multi-block commands. The RAM disk is plain memcpy.
+ * 
+ * The flash backend reads straight through XIP and stages writes in a
+ * single 4 KB erase block held in RAM. The block is programmed when a
+ * different one is touched or on flush. Erasing stalls XIP for both cores,
+ * so it is only done while core 1 has no job (its idle loop is RAM-resident)
+ * and with interrupts off on core 0; otherwise MIMIC_ERR_BUSY is returned
+ * and the write stays staged.
+ */
+
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+#include <string.h>
+
+#include "mimic.h"
+#include "mimic_blockdev.h"
+#include "mimic_fat32.h"
+
+// ============================================================================
+// SD CARD
+// ============================================================================
+
+static int sd_bdev_init(MimicBlockDev* dev) {
+    return mimic_sd_init();
+}
+
+static int sd_bdev_read(MimicBlockDev* dev, uint32_t sector, uint8_t* buf, uint32_t count) {
+    return mimic_sd_read_sectors(sector, buf, count);
+}
+
+static int sd_bdev_write(MimicBlockDev* dev, uint32_t sector, const uint8_t* buf, uint32_t count) {
+    return mimic_sd_write_sectors(sector, buf, count);
+}
+
+static int sd_bdev_flush(MimicBlockDev* dev) {
+    return mimic_sd_sync();
+}
+
+static int sd_bdev_discard(MimicBlockDev* dev, uint32_t sector, uint32_t count) {
+    return mimic_sd_erase(sector, count);
+}
+
+static const MimicBlockOps sd_ops = {
+    .init    = sd_bdev_init,
+    .read    = sd_bdev_read,
+    .write   = sd_bdev_write,
+    .flush   = sd_bdev_flush,
+    .discard = sd_bdev_discard,
+};
+
+MimicBlockDev mimic_bdev_sd = {
+    .name         = "sd",
+    .ops          = &sd_ops,
+    .sector_count = 0,
+    .ctx          = NULL,
+};
+
+// ============================================================================
+// RAM DISK
+// ============================================================================
+
+static int ram_bdev_read(MimicBlockDev* dev, uint32_t sector, uint8_t* buf, uint32_t count) {
+    memcpy(buf, (uint8_t*)dev->ctx + sector * MIMIC_BDEV_SECTOR, count * MIMIC_BDEV_SECTOR);
+    return MIMIC_OK;
+}
+
+static int ram_bdev_write(MimicBlockDev* dev, uint32_t sector, const uint8_t* buf, uint32_t count) {
+    memcpy((uint8_t*)dev->ctx + sector * MIMIC_BDEV_SECTOR, buf, count * MIMIC_BDEV_SECTOR);
+    return MIMIC_OK;
+}
+
+static const MimicBlockOps ram_ops = {
+    .init    = NULL,
+    .read    = ram_bdev_read,
+    .write   = ram_bdev_write,
+    .flush   = NULL,
+    .discard = NULL,
+};
+
+int mimic_bdev_ram_init(MimicBlockDev* dev, void* mem, uint32_t sectors) {
+    if (!dev || !mem || sectors == 0) return MIMIC_ERR_INVAL;
+    
+    dev->name = "ram";
+    dev->ops = &ram_ops;
+    dev->sector_count = sectors;
+    dev->ctx = mem;
+    return MIMIC_OK;
+}
+
+// ============================================================================
+// FLASH REGION
+// ============================================================================
+
+#define FLASH_NO_BLOCK      0xFFFFFFFF
+
+typedef struct {
+    uint32_t    offset;         // Region start in flash, erase-block aligned
+    uint32_t    block;          // Staged erase block index in the region
+    bool        dirty;
+    uint8_t*    buf;            // FLASH_SECTOR_SIZE, allocated on first write
+} FlashBdev;
+
+extern char __flash_binary_end;
+
+static const uint8_t* flash_xip(FlashBdev* fb, uint32_t pos) {
+    return (const uint8_t*)(XIP_BASE + fb->offset + pos);
+}
+
+static int flash_bdev_flush(MimicBlockDev* dev) {
+    FlashBdev* fb = dev->ctx;
+    if (!fb->dirty) return MIMIC_OK;
+    if (!mimic_core1_idle()) return MIMIC_ERR_BUSY;
+    
+    uint32_t pos = fb->block * FLASH_SECTOR_SIZE;
+    
+    // Rewriting identical data would only cost an erase cycle
+    if (memcmp(fb->buf, flash_xip(fb, pos), FLASH_SECTOR_SIZE) != 0) {
+        uint32_t irq = save_and_disable_interrupts();
+        flash_range_erase(fb->offset + pos, FLASH_SECTOR_SIZE);
+        flash_range_program(fb->offset + pos, fb->buf, FLASH_SECTOR_SIZE);
+        restore_interrupts(irq);
+    }
+    
+    fb->dirty = false;
+    return MIMIC_OK;
+}
+
+static int flash_bdev_read(MimicBlockDev* dev, uint32_t sector, uint8_t* buf, uint32_t count) {
+    FlashBdev* fb = dev->ctx;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t pos = (sector + i) * MIMIC_BDEV_SECTOR;
+        uint32_t block = pos / FLASH_SECTOR_SIZE;
+        
+        // Staged writes are newer than what flash holds
+        if (block == fb->block && fb->dirty) {
+            memcpy(buf, fb->buf + pos % FLASH_SECTOR_SIZE, MIMIC_BDEV_SECTOR);
+        } else {
+            memcpy(buf, flash_xip(fb, pos), MIMIC_BDEV_SECTOR);
+        }
+        buf += MIMIC_BDEV_SECTOR;
+    }
+    
+    return MIMIC_OK;
+}
+
+static int flash_bdev_write(MimicBlockDev* dev, uint32_t sector, const uint8_t* buf, uint32_t count) {
+    FlashBdev* fb = dev->ctx;
+    
+    if (!fb->buf) {
+        fb->buf = mimic_kmalloc(FLASH_SECTOR_SIZE);
+        if (!fb->buf) return MIMIC_ERR_NOMEM;
+    }
+    
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t pos = (sector + i) * MIMIC_BDEV_SECTOR;
+        uint32_t block = pos / FLASH_SECTOR_SIZE;
+        
+        if (block != fb->block) {
+            int err = flash_bdev_flush(dev);
+            if (err != MIMIC_OK) return err;
+            
+            memcpy(fb->buf, flash_xip(fb, block * FLASH_SECTOR_SIZE), FLASH_SECTOR_SIZE);
+            fb->block = block;
+        }
+        
+        memcpy(fb->buf + pos % FLASH_SECTOR_SIZE, buf, MIMIC_BDEV_SECTOR);
+        fb->dirty = true;
+        buf += MIMIC_BDEV_SECTOR;
+    }
+    
+    return MIMIC_OK;
+}
+
+static const MimicBlockOps flash_ops = {
+    .init    = NULL,
+    .read    = flash_bdev_read,
+    .write   = flash_bdev_write,
+    .flush   = flash_bdev_flush,
+    .discard = NULL,
+};
+
+int mimic_bdev_flash_init(MimicBlockDev* dev, uint32_t offset, uint32_t size) {
+    if (!dev || size == 0) return MIMIC_ERR_INVAL;
+    if (offset % FLASH_SECTOR_SIZE || size % FLASH_SECTOR_SIZE) return MIMIC_ERR_INVAL;
+    if (offset > PICO_FLASH_SIZE_BYTES || size > PICO_FLASH_SIZE_BYTES - offset) {
+        return MIMIC_ERR_INVAL;
+    }
+    
+    // Never hand out the flash the firmware itself runs from
+    if (XIP_BASE + offset < (uintptr_t)&__flash_binary_end) return MIMIC_ERR_PERM;
+    
+    FlashBdev* fb = mimic_kmalloc(sizeof(FlashBdev));
+    if (!fb) return MIMIC_ERR_NOMEM;
+    fb->offset = offset;
+    fb->block = FLASH_NO_BLOCK;
+    fb->dirty = false;
+    fb->buf = NULL;
+    
+    dev->name = "flash";
+    dev->ops = &flash_ops;
+    dev->sector_count = size / MIMIC_BDEV_SECTOR;
+    dev->ctx = fb;
+    return MIMIC_OK;
+}
@@ -7,6 +7,7 @@
  */
 
 #include "pico/stdlib.h"
+#include "pico/mutex.h"
 #include "hardware/spi.h"
 #include "hardware/gpio.h"
 
@@ -15,6 +16,10 @@
 
 #include "mimic.h"
 #include "mimic_fat32.h"
+#include "mimic_tmpfs.h"
+#include "mimic_log.h"
+#include "mimic_trace.h"
+#include "mimic_perf.h"
 
 // ============================================================================
 // SPI CONFIGURATION
@@ -23,15 +28,58 @@
 #define SD_SPI              spi0
 #define SD_BAUDRATE_SLOW    400000      // 400kHz for init
 #define SD_BAUDRATE_FAST    4000000     // 4MHz for operation (very conservative)
+#define SD_BAUDRATE_CRC     12500000    // Start here when transfers are CRC-checked
+
+#ifndef MIMIC_SD_CRC
+  #define MIMIC_SD_CRC      1           // CMD59: card and host check every CRC
+#endif
+#define SD_CRC_RETRIES      3           // Extra attempts after a CRC mismatch
+#define SD_CRC_STEP_ERRORS  8           // Halve the clock after this many mismatches
+#define SD_R1_CRC           0x08        // R1: command CRC error
+
+#define SD_TIMEOUT_MS       500         // Busy, token and ready waits
+#define SD_SPIN_US          200         // Poll flat out this long, then...
+#define SD_POLL_US          100         // ...sleep on a timer alarm between polls
+#define SD_ERASE_TIMEOUT_MS 1000        // Busy after CMD38
 
 // ============================================================================
 // GLOBAL STATE
 // ============================================================================
 
 static MimicVolume vol;
+static MimicSdStats sd_stats;           // Reset for each card
+static uint32_t sd_step_errors;         // CRC errors since the clock last changed
 static MimicFile files[MIMIC_MAX_FILES];
 static char current_dir[MIMIC_MAX_PATH] = "/";
 
+// One lock around the whole FS: vol.sector_buf and files[] are shared by
+// the shell, the compiler on either core and user syscalls. Recursive
+// because public entry points call each other (opendir -> fopen, ...).
+auto_init_recursive_mutex(fs_mutex);
+static uint64_t fs_last_us;             // Last foreground entry, for idle work
+
+static inline void fs_lock(void) {
+    recursive_mutex_enter_blocking(&fs_mutex);
+    fs_last_us = time_us_64();
+}
+
+static inline void fs_unlock(void) {
+    recursive_mutex_exit(&fs_mutex);
+}
+
+void mimic_fs_lock(void) {
+    fs_lock();
+}
+
+bool mimic_fs_try_lock(void) {
+    uint32_t owner;
+    return recursive_mutex_try_enter(&fs_mutex, &owner);
+}
+
+void mimic_fs_unlock(void) {
+    fs_unlock();
+}
+
 // ============================================================================
 // LOW-LEVEL SPI
 // ============================================================================
@@ -70,12 +118,127 @@ static void sd_dummy_clocks(int count) {
     }
 }
 
+// Clock the card until it is idle (0xFF) when until_idle is set, or
+// until it sends anything else (a token) otherwise, or until timeout_ms
+// passes; returns the last byte read. Most waits end within the spin.
+// Past that the card is programming flash, which can take hundreds of
+// ms, so the core sleeps on an alarm between polls instead of burning
+// cycles and SPI clocks.
+static uint8_t sd_poll(bool until_idle, uint32_t timeout_ms) {
+    uint64_t start = time_us_64();
+    uint64_t deadline = start + timeout_ms * 1000ull;
+    
+    while (true) {
+        uint8_t resp = sd_spi_xfer(0xFF);
+        if ((resp == 0xFF) == until_idle) return resp;
+        
+        uint64_t now = time_us_64();
+        if (now >= deadline) return resp;
+        if (now - start >= SD_SPIN_US) sleep_us(SD_POLL_US);
+    }
+}
+
 static bool sd_wait_ready(uint32_t timeout_ms) {
-    uint32_t start = to_ms_since_boot(get_absolute_time());
-    do {
-        if (sd_spi_xfer(0xFF) == 0xFF) return true;
-    } while ((to_ms_since_boot(get_absolute_time()) - start) < timeout_ms);
-    return false;
+    return sd_poll(true, timeout_ms) == 0xFF;
+}
+
+// ============================================================================
+// CRC
+// ============================================================================
+
+// CRC7 kept in the top seven bits (poly x^7 + x^3 + 1), so the command's
+// last byte is the table result | 1. CRC16 is CCITT (x^16 + x^12 + x^5 + 1),
+// zero seed, as the card sends it after each data block.
+
+static const uint8_t sd_crc7_table[256] = {
+    0x00, 0x12, 0x24, 0x36, 0x48, 0x5A, 0x6C, 0x7E, 0x90, 0x82, 0xB4, 0xA6, 0xD8, 0xCA, 0xFC, 0xEE,
+    0x32, 0x20, 0x16, 0x04, 0x7A, 0x68, 0x5E, 0x4C, 0xA2, 0xB0, 0x86, 0x94, 0xEA, 0xF8, 0xCE, 0xDC,
+    0x64, 0x76, 0x40, 0x52, 0x2C, 0x3E, 0x08, 0x1A, 0xF4, 0xE6, 0xD0, 0xC2, 0xBC, 0xAE, 0x98, 0x8A,
+    0x56, 0x44, 0x72, 0x60, 0x1E, 0x0C, 0x3A, 0x28, 0xC6, 0xD4, 0xE2, 0xF0, 0x8E, 0x9C, 0xAA, 0xB8,
+    0xC8, 0xDA, 0xEC, 0xFE, 0x80, 0x92, 0xA4, 0xB6, 0x58, 0x4A, 0x7C, 0x6E, 0x10, 0x02, 0x34, 0x26,
+    0xFA, 0xE8, 0xDE, 0xCC, 0xB2, 0xA0, 0x96, 0x84, 0x6A, 0x78, 0x4E, 0x5C, 0x22, 0x30, 0x06, 0x14,
+    0xAC, 0xBE, 0x88, 0x9A, 0xE4, 0xF6, 0xC0, 0xD2, 0x3C, 0x2E, 0x18, 0x0A, 0x74, 0x66, 0x50, 0x42,
+    0x9E, 0x8C, 0xBA, 0xA8, 0xD6, 0xC4, 0xF2, 0xE0, 0x0E, 0x1C, 0x2A, 0x38, 0x46, 0x54, 0x62, 0x70,
+    0x82, 0x90, 0xA6, 0xB4, 0xCA, 0xD8, 0xEE, 0xFC, 0x12, 0x00, 0x36, 0x24, 0x5A, 0x48, 0x7E, 0x6C,
+    0xB0, 0xA2, 0x94, 0x86, 0xF8, 0xEA, 0xDC, 0xCE, 0x20, 0x32, 0x04, 0x16, 0x68, 0x7A, 0x4C, 0x5E,
+    0xE6, 0xF4, 0xC2, 0xD0, 0xAE, 0xBC, 0x8A, 0x98, 0x76, 0x64, 0x52, 0x40, 0x3E, 0x2C, 0x1A, 0x08,
+    0xD4, 0xC6, 0xF0, 0xE2, 0x9C, 0x8E, 0xB8, 0xAA, 0x44, 0x56, 0x60, 0x72, 0x0C, 0x1E, 0x28, 0x3A,
+    0x4A, 0x58, 0x6E, 0x7C, 0x02, 0x10, 0x26, 0x34, 0xDA, 0xC8, 0xFE, 0xEC, 0x92, 0x80, 0xB6, 0xA4,
+    0x78, 0x6A, 0x5C, 0x4E, 0x30, 0x22, 0x14, 0x06, 0xE8, 0xFA, 0xCC, 0xDE, 0xA0, 0xB2, 0x84, 0x96,
+    0x2E, 0x3C, 0x0A, 0x18, 0x66, 0x74, 0x42, 0x50, 0xBE, 0xAC, 0x9A, 0x88, 0xF6, 0xE4, 0xD2, 0xC0,
+    0x1C, 0x0E, 0x38, 0x2A, 0x54, 0x46, 0x70, 0x62, 0x8C, 0x9E, 0xA8, 0xBA, 0xC4, 0xD6, 0xE0, 0xF2,
+};
+
+static const uint16_t sd_crc16_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
+
+static uint8_t sd_crc7(const uint8_t* data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) crc = sd_crc7_table[crc ^ data[i]];
+    return crc | 1;
+}
+
+static uint16_t sd_crc16(const uint8_t* data, size_t len) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc << 8) ^ sd_crc16_table[(crc >> 8) ^ data[i]];
+    }
+    return crc;
+}
+
+static void sd_set_baud(uint32_t baud) {
+    sd_stats.baud = spi_set_baudrate(SD_SPI, baud);
+    sd_step_errors = 0;
+}
+
+// Decide whether a failed transfer is worth another go. Only CRC
+// mismatches are retried; a steady trickle of them, or a transfer that
+// fails every attempt, steps the clock down towards SD_BAUDRATE_FAST.
+static bool sd_crc_retry(int err, int* attempt) {
+    if (err != MIMIC_ERR_CORRUPT) return false;
+    
+    bool give_up = ++*attempt > SD_CRC_RETRIES;
+    if (give_up) sd_stats.failures++;
+    else sd_stats.retries++;
+    
+    if ((give_up || ++sd_step_errors >= SD_CRC_STEP_ERRORS) && sd_stats.baud > SD_BAUDRATE_FAST) {
+        uint32_t baud = sd_stats.baud / 2;
+        sd_set_baud(baud > SD_BAUDRATE_FAST ? baud : SD_BAUDRATE_FAST);
+        printf("[SD] CRC errors, clock down to %lu Hz\n", (unsigned long)sd_stats.baud);
+    }
+    return !give_up;
 }
 
 // ============================================================================
@@ -83,6 +246,9 @@ static bool sd_wait_ready(uint32_t timeout_ms) {
 // ============================================================================
 
 static uint8_t sd_cmd(uint8_t cmd, uint32_t arg) {
+    mimic_trace(MIMIC_TRACE_SD_CMD, cmd, arg);
+    mimic_perf_inc(MIMIC_PERF_SD_CMDS);
+    
     uint8_t buf[6];
     buf[0] = 0x40 | cmd;
     buf[1] = (arg >> 24) & 0xFF;
@@ -90,10 +256,8 @@ static uint8_t sd_cmd(uint8_t cmd, uint32_t arg) {
     buf[3] = (arg >> 8) & 0xFF;
     buf[4] = arg & 0xFF;
     
-    // CRC (only matters for CMD0 and CMD8 in SPI mode)
-    if (cmd == SD_CMD0) buf[5] = 0x95;
-    else if (cmd == SD_CMD8) buf[5] = 0x87;
-    else buf[5] = 0x01;
+    // Checked by the card for CMD0, CMD8 and, in CRC mode, everything
+    buf[5] = sd_crc7(buf, 5);
     
     // Send command
     sd_spi_write(buf, 6);
@@ -107,6 +271,9 @@ static uint8_t sd_cmd(uint8_t cmd, uint32_t arg) {
         resp = sd_spi_xfer(0xFF);
         if (!(resp & 0x80)) break;
     }
+    if (!(resp & 0x80) && (resp & SD_R1_CRC)) sd_stats.cmd_crc_errors++;
+    
+    mimic_trace(MIMIC_TRACE_SD_DONE, cmd | (resp << 8), arg);
     return resp;
 }
 
@@ -142,6 +309,7 @@ int mimic_sd_init(void) {
     
     vol.card_type = SD_TYPE_UNKNOWN;
     vol.initialized = false;
+    memset(&sd_stats, 0, sizeof(sd_stats));
     
     // 4. Power-on delay
     sleep_ms(100);
@@ -254,8 +422,19 @@ int mimic_sd_init(void) {
         sd_spi_xfer(0xFF);
     }
     
-    // 11. Switch to fast SPI
-    spi_set_baudrate(SD_SPI, SD_BAUDRATE_FAST);
+    // 11. CRC mode, which makes a faster clock safe: a corrupted block
+    //     is caught and re-read instead of being loaded
+#if MIMIC_SD_CRC
+    sd_cs_low();
+    r1 = sd_cmd(SD_CMD59, 1);
+    sd_cs_high();
+    sd_spi_xfer(0xFF);
+    sd_stats.crc = (r1 == 0x00);
+    if (!sd_stats.crc) printf("[SD] CRC mode rejected (r1=0x%02X)\n", r1);
+#endif
+    
+    // 12. Switch to fast SPI
+    sd_set_baud(sd_stats.crc ? SD_BAUDRATE_CRC : SD_BAUDRATE_FAST);
     
     // Send dummy clocks after speed change
     sd_cs_high();
@@ -264,7 +443,8 @@ int mimic_sd_init(void) {
     }
     
     const char* types[] = {"?", "MMC", "SD1", "SD2", "SDHC"};
-    printf("[SD] SUCCESS: %s card\n", types[vol.card_type]);
+    printf("[SD] SUCCESS: %s card, %lu Hz%s\n", types[vol.card_type],
+           (unsigned long)sd_stats.baud, sd_stats.crc ? ", CRC on" : "");
     
     vol.initialized = true;
     return MIMIC_OK;
@@ -278,11 +458,44 @@ uint8_t mimic_sd_get_type(void) {
     return vol.card_type;
 }
 
+void mimic_sd_get_stats(MimicSdStats* stats) {
+    *stats = sd_stats;
+}
+
 // ============================================================================
 // SECTOR READ/WRITE
 // ============================================================================
 
-int mimic_sd_read_sector(uint32_t sector, uint8_t* buf) {
+// Read the CRC trailing a data block and check it in CRC mode
+static int sd_check_crc(const uint8_t* buf) {
+    uint8_t crc[2];
+    sd_spi_read(crc, 2);
+    if (!sd_stats.crc) return MIMIC_OK;
+    
+    if (((crc[0] << 8) | crc[1]) != sd_crc16(buf, 512)) {
+        sd_stats.read_crc_errors++;
+        return MIMIC_ERR_CORRUPT;
+    }
+    return MIMIC_OK;
+}
+
+// Send a data block's CRC (ignored by the card outside CRC mode) and
+// take its data response
+static int sd_send_crc(const uint8_t* buf) {
+    uint16_t crc = sd_stats.crc ? sd_crc16(buf, 512) : 0xFFFF;
+    sd_spi_xfer(crc >> 8);
+    sd_spi_xfer(crc & 0xFF);
+    
+    uint8_t resp = sd_spi_xfer(0xFF) & 0x1F;
+    if (resp == 0x05) return MIMIC_OK;
+    if (resp == 0x0B) {
+        sd_stats.write_crc_errors++;
+        return MIMIC_ERR_CORRUPT;
+    }
+    return MIMIC_ERR_IO;
+}
+
+static int sd_read_block(uint32_t sector, uint8_t* buf) {
     if (!vol.initialized) return MIMIC_ERR_IO;
     
     uint32_t addr = (vol.card_type == SD_TYPE_SDHC) ? sector : sector * 512;
@@ -290,7 +503,7 @@ int mimic_sd_read_sector(uint32_t sector, uint8_t* buf) {
     sd_cs_low();
     
     // Wait for card to be ready
-    if (!sd_wait_ready(500)) {
+    if (!sd_wait_ready(SD_TIMEOUT_MS)) {
         printf("[SD] Read: card not ready\n");
         sd_cs_high();
         sd_spi_xfer(0xFF);
@@ -303,15 +516,11 @@ int mimic_sd_read_sector(uint32_t sector, uint8_t* buf) {
         printf("[SD] Read CMD17 failed: 0x%02X (sector %lu)\n", resp, (unsigned long)sector);
         sd_cs_high();
         sd_spi_xfer(0xFF);
-        return MIMIC_ERR_IO;
+        return (resp & SD_R1_CRC) ? MIMIC_ERR_CORRUPT : MIMIC_ERR_IO;
     }
     
     // Wait for data token (0xFE) or error token (0x01-0x1F)
-    uint32_t start = to_ms_since_boot(get_absolute_time());
-    do {
-        resp = sd_spi_xfer(0xFF);
-        if (resp != 0xFF) break;
-    } while ((to_ms_since_boot(get_absolute_time()) - start) < 500);
+    resp = sd_poll(false, SD_TIMEOUT_MS);
     
     if (resp != 0xFE) {
         printf("[SD] Read: no data token, got 0x%02X\n", resp);
@@ -322,28 +531,32 @@ int mimic_sd_read_sector(uint32_t sector, uint8_t* buf) {
     
     // Read data
     sd_spi_read(buf, 512);
-    
-    // Discard CRC
-    sd_spi_xfer(0xFF);
-    sd_spi_xfer(0xFF);
+    int err = sd_check_crc(buf);
     
     sd_cs_high();
     sd_spi_xfer(0xFF);  // Extra clocks
     
-    return MIMIC_OK;
+    return err;
 }
 
-int mimic_sd_write_sector(uint32_t sector, const uint8_t* buf) {
+static int sd_write_block(uint32_t sector, const uint8_t* buf) {
     if (!vol.initialized) return MIMIC_ERR_IO;
     
     uint32_t addr = (vol.card_type == SD_TYPE_SDHC) ? sector : sector * 512;
     
     sd_cs_low();
+    
+    // The previous write may still be programming
+    if (!sd_wait_ready(SD_TIMEOUT_MS)) {
+        sd_cs_high();
+        return MIMIC_ERR_IO;
+    }
+    
     uint8_t resp = sd_cmd(SD_CMD24, addr);
     
     if (resp != 0x00) {
         sd_cs_high();
-        return MIMIC_ERR_IO;
+        return (resp & SD_R1_CRC) ? MIMIC_ERR_CORRUPT : MIMIC_ERR_IO;
     }
     
     sd_spi_xfer(0xFF);
@@ -351,22 +564,215 @@ int mimic_sd_write_sector(uint32_t sector, const uint8_t* buf) {
     
     sd_spi_write(buf, 512);
     
-    // Dummy CRC
+    int err = sd_send_crc(buf);
+    if (err != MIMIC_OK) {
+        sd_cs_high();
+        return err;
+    }
+    
+    // Don't wait for programming: the card keeps at it with CS released,
+    // and the next command's ready wait (or mimic_sd_sync) picks it up
+    sd_cs_high();
     sd_spi_xfer(0xFF);
+    return MIMIC_OK;
+}
+
+// Multi-block transfers: one command, then a data token per sector. The
+// card streams sectors back to back, so a batch costs one command round
+// trip instead of one per sector.
+static int sd_read_blocks(uint32_t sector, uint8_t* buf, uint32_t count) {
+    if (!vol.initialized) return MIMIC_ERR_IO;
+    
+    uint32_t addr = (vol.card_type == SD_TYPE_SDHC) ? sector : sector * 512;
+    
+    sd_cs_low();
+    
+    if (!sd_wait_ready(SD_TIMEOUT_MS)) {
+        printf("[SD] Read: card not ready\n");
+        sd_cs_high();
+        sd_spi_xfer(0xFF);
+        return MIMIC_ERR_IO;
+    }
+    
+    uint8_t resp = sd_cmd(SD_CMD18, addr);
+    if (resp != 0x00) {
+        printf("[SD] Read CMD18 failed: 0x%02X (sector %lu)\n", resp, (unsigned long)sector);
+        sd_cs_high();
+        sd_spi_xfer(0xFF);
+        return (resp & SD_R1_CRC) ? MIMIC_ERR_CORRUPT : MIMIC_ERR_IO;
+    }
+    
+    int err = MIMIC_OK;
+    for (uint32_t i = 0; i < count; i++) {
+        resp = sd_poll(false, SD_TIMEOUT_MS);
+        if (resp != 0xFE) {
+            printf("[SD] Read: no data token for sector %lu, got 0x%02X\n",
+                   (unsigned long)(sector + i), resp);
+            err = MIMIC_ERR_IO;
+            break;
+        }
+        
+        sd_spi_read(buf + i * 512, 512);
+        err = sd_check_crc(buf + i * 512);
+        if (err != MIMIC_OK) break;
+    }
+    
+    // Stop transmission; R1b, so wait out the busy
+    sd_cmd(SD_CMD12, 0);
+    sd_wait_ready(SD_TIMEOUT_MS);
+    
+    sd_cs_high();
     sd_spi_xfer(0xFF);
+    return err;
+}
+
+static int sd_write_blocks(uint32_t sector, const uint8_t* buf, uint32_t count) {
+    if (!vol.initialized) return MIMIC_ERR_IO;
+    
+    uint32_t addr = (vol.card_type == SD_TYPE_SDHC) ? sector : sector * 512;
+    
+    sd_cs_low();
     
-    // Check response
-    resp = sd_spi_xfer(0xFF);
-    if ((resp & 0x1F) != 0x05) {
+    if (!sd_wait_ready(SD_TIMEOUT_MS)) {
         sd_cs_high();
         return MIMIC_ERR_IO;
     }
     
-    // Wait for write complete
-    while (sd_spi_xfer(0xFF) == 0x00);
+    uint8_t resp = sd_cmd(SD_CMD25, addr);
+    
+    if (resp != 0x00) {
+        sd_cs_high();
+        return (resp & SD_R1_CRC) ? MIMIC_ERR_CORRUPT : MIMIC_ERR_IO;
+    }
+    
+    int err = MIMIC_OK;
+    for (uint32_t i = 0; i < count; i++) {
+        sd_spi_xfer(0xFF);
+        sd_spi_xfer(0xFC);  // Multi-block data token
+        
+        sd_spi_write(buf + i * 512, 512);
+        
+        err = sd_send_crc(buf + i * 512);
+        if (err != MIMIC_OK) break;
+        
+        // Programming busy
+        if (!sd_wait_ready(SD_TIMEOUT_MS)) {
+            err = MIMIC_ERR_IO;
+            break;
+        }
+    }
+    
+    // Stop token; the final busy is left to run like a single write's
+    sd_spi_xfer(0xFD);
+    sd_spi_xfer(0xFF);
     
     sd_cs_high();
-    return MIMIC_OK;
+    sd_spi_xfer(0xFF);
+    return err;
+}
+
+int mimic_sd_read_sector(uint32_t sector, uint8_t* buf) {
+    uint32_t start = time_us_32();
+    int err;
+    int attempt = 0;
+    do {
+        err = sd_read_block(sector, buf);
+    } while (sd_crc_retry(err, &attempt));
+    
+    mimic_perf_inc(MIMIC_PERF_SD_READS);
+    mimic_perf_add(MIMIC_PERF_SD_READ_US, time_us_32() - start);
+    if (err != MIMIC_OK) mimic_perf_inc(MIMIC_PERF_SD_ERRORS);
+    return err;
+}
+
+int mimic_sd_write_sector(uint32_t sector, const uint8_t* buf) {
+    uint32_t start = time_us_32();
+    int err;
+    int attempt = 0;
+    do {
+        err = sd_write_block(sector, buf);
+    } while (sd_crc_retry(err, &attempt));
+    
+    mimic_perf_inc(MIMIC_PERF_SD_WRITES);
+    mimic_perf_add(MIMIC_PERF_SD_WRITE_US, time_us_32() - start);
+    if (err != MIMIC_OK) mimic_perf_inc(MIMIC_PERF_SD_ERRORS);
+    return err;
+}
+
+// Wait out any programming left running by the last write
+int mimic_sd_sync(void) {
+    if (!vol.initialized) return MIMIC_ERR_IO;
+    
+    sd_cs_low();
+    bool ready = sd_wait_ready(SD_TIMEOUT_MS);
+    sd_cs_high();
+    sd_spi_xfer(0xFF);
+    return ready ? MIMIC_OK : MIMIC_ERR_IO;
+}
+
+// Erase [sector, sector + count) and wait for it to finish. Erasing a
+// whole run at once is far cheaper than the card doing it block by block
+// inside later writes. MMC cards erase with different commands.
+int mimic_sd_erase(uint32_t sector, uint32_t count) {
+    if (!vol.initialized) return MIMIC_ERR_IO;
+    if (vol.card_type == SD_TYPE_MMC) return MIMIC_ERR_NOSYS;
+    if (count == 0) return MIMIC_OK;
+    
+    uint32_t first = sector;
+    uint32_t last = sector + count - 1;
+    if (vol.card_type != SD_TYPE_SDHC) {
+        first *= 512;
+        last *= 512;
+    }
+    
+    sd_cs_low();
+    
+    int err = MIMIC_ERR_IO;
+    if (sd_wait_ready(SD_TIMEOUT_MS) &&
+        sd_cmd(SD_CMD32, first) == 0x00 &&
+        sd_cmd(SD_CMD33, last) == 0x00 &&
+        sd_cmd(SD_CMD38, 0) == 0x00) {
+        // R1b: busy until the erase is done
+        if (sd_wait_ready(SD_ERASE_TIMEOUT_MS)) err = MIMIC_OK;
+    }
+    
+    sd_cs_high();
+    sd_spi_xfer(0xFF);
+    return err;
+}
+
+int mimic_sd_read_sectors(uint32_t sector, uint8_t* buf, uint32_t count) {
+    if (count == 0) return MIMIC_OK;
+    if (count == 1) return mimic_sd_read_sector(sector, buf);
+    
+    uint32_t start = time_us_32();
+    int err;
+    int attempt = 0;
+    do {
+        err = sd_read_blocks(sector, buf, count);
+    } while (sd_crc_retry(err, &attempt));
+    
+    mimic_perf_add(MIMIC_PERF_SD_READS, count);
+    mimic_perf_add(MIMIC_PERF_SD_READ_US, time_us_32() - start);
+    if (err != MIMIC_OK) mimic_perf_inc(MIMIC_PERF_SD_ERRORS);
+    return err;
+}
+
+int mimic_sd_write_sectors(uint32_t sector, const uint8_t* buf, uint32_t count) {
+    if (count == 0) return MIMIC_OK;
+    if (count == 1) return mimic_sd_write_sector(sector, buf);
+    
+    uint32_t start = time_us_32();
+    int err;
+    int attempt = 0;
+    do {
+        err = sd_write_blocks(sector, buf, count);
+    } while (sd_crc_retry(err, &attempt));
+    
+    mimic_perf_add(MIMIC_PERF_SD_WRITES, count);
+    mimic_perf_add(MIMIC_PERF_SD_WRITE_US, time_us_32() - start);
+    if (err != MIMIC_OK) mimic_perf_inc(MIMIC_PERF_SD_ERRORS);
+    return err;
 }
 
 // ============================================================================
@@ -374,28 +780,54 @@ int mimic_sd_write_sector(uint32_t sector, const uint8_t* buf) {
 // ============================================================================
 
 static int fat32_read_sector(uint32_t sector) {
-    if (vol.cached_sector == sector) return MIMIC_OK;
+    if (vol.cached_sector == sector) {
+        mimic_perf_inc(MIMIC_PERF_FS_CACHE_HITS);
+        return MIMIC_OK;
+    }
+    mimic_perf_inc(MIMIC_PERF_FS_CACHE_MISSES);
     
     if (vol.cache_dirty) {
-        int err = mimic_sd_write_sector(vol.cached_sector, vol.sector_buf);
+        mimic_perf_inc(MIMIC_PERF_FS_WRITEBACKS);
+        int err = mimic_bdev_write(vol.dev, vol.cached_sector, vol.sector_buf, 1);
         if (err != MIMIC_OK) return err;
         vol.cache_dirty = false;
     }
     
-    int err = mimic_sd_read_sector(sector, vol.sector_buf);
+    int err = mimic_bdev_read(vol.dev, sector, vol.sector_buf, 1);
     if (err == MIMIC_OK) {
         vol.cached_sector = sector;
     }
     return err;
 }
 
+#define FMAP_NONE           0xFFFFFFFF
+
+static void fmap_drop(uint32_t sector, uint32_t count);
+
 static void fat32_cache_dirty(void) {
     vol.cache_dirty = true;
+    fmap_drop(vol.cached_sector, 1);
+}
+
+// Whether the cached sector lies in [sector, sector + count)
+static bool fat32_cache_in(uint32_t sector, uint32_t count) {
+    return vol.cached_sector - sector < count;
+}
+
+// Whole sectors from the current position that a transfer of len bytes
+// can move in one device call without leaving the cluster
+static uint32_t fat32_run_sectors(const MimicFile* f, uint32_t len) {
+    if (f->cluster_offset % 512) return 0;
+    
+    uint32_t n = len / 512;
+    uint32_t in_cluster = vol.sectors_per_cluster - f->cluster_offset / 512;
+    return n < in_cluster ? n : in_cluster;
 }
 
 static int fat32_flush_cache(void) {
     if (vol.cache_dirty) {
-        int err = mimic_sd_write_sector(vol.cached_sector, vol.sector_buf);
+        mimic_perf_inc(MIMIC_PERF_FS_WRITEBACKS);
+        int err = mimic_bdev_write(vol.dev, vol.cached_sector, vol.sector_buf, 1);
         if (err != MIMIC_OK) return err;
         vol.cache_dirty = false;
     }
@@ -434,91 +866,450 @@ static int fat32_set_fat_entry(uint32_t cluster, uint32_t value) {
     return MIMIC_OK;
 }
 
+// Freed runs waiting for the background erase (see BACKGROUND ERASE)
+typedef struct {
+    uint32_t    cluster;
+    uint32_t    count;
+} EraseRun;
+
+static EraseRun erase_runs[MIMIC_ERASE_RUNS];
+static uint32_t erase_count;
+static int erase_task = -1;
+
+static void erase_claim(uint32_t cluster);
+static void erase_queue(uint32_t cluster, uint32_t count);
+
 static uint32_t fat32_alloc_cluster(void) {
     for (uint32_t c = 2; c < vol.total_clusters + 2; c++) {
         if (fat32_get_fat_entry(c) == FAT32_FREE) {
             fat32_set_fat_entry(c, FAT32_EOC);
+            erase_claim(c);
             return c;
         }
     }
     return 0;
 }
 
-// Forward declaration
-static void fat32_name_to_83(const char* name, char* name83);
-
-// Create a new file in a directory
-// Returns directory cluster and entry index for later updates
-static int fat32_create_file(uint32_t dir_cluster, const char* name, 
-                              Fat32DirEntry* out_entry, 
-                              uint32_t* out_dir_cluster, uint32_t* out_dir_entry_idx) {
-    char name83[11];
-    fat32_name_to_83(name, name83);
+// Return a chain to the free pool, queueing its runs of consecutive
+// clusters for background erase
+static void fat32_free_chain(uint32_t cluster) {
+    uint32_t run_start = 0;
+    uint32_t run_len = 0;
     
-    // Find a free entry in the directory
-    uint32_t cur_cluster = dir_cluster;
-    uint32_t entry_idx = 0;
-    
-    while (cur_cluster != 0 && cur_cluster < FAT32_EOC) {
-        for (uint32_t s = 0; s < vol.sectors_per_cluster; s++) {
-            uint32_t sector = fat32_cluster_to_sector(cur_cluster) + s;
-            if (fat32_read_sector(sector) != MIMIC_OK) return MIMIC_ERR_IO;
-            
-            Fat32DirEntry* entries = (Fat32DirEntry*)vol.sector_buf;
-            
-            for (int e = 0; e < 16; e++) {
-                // Check for free entry (0x00 = never used, 0xE5 = deleted)
-                if (entries[e].name[0] == 0x00 || entries[e].name[0] == (char)0xE5) {
-                    // Found a free slot - create the entry
-                    memset(&entries[e], 0, sizeof(Fat32DirEntry));
-                    memcpy(entries[e].name, name83, 8);
-                    memcpy(entries[e].ext, name83 + 8, 3);
-                    entries[e].attr = FAT_ATTR_ARCHIVE;
-                    entries[e].file_size = 0;
-                    entries[e].fst_clus_hi = 0;
-                    entries[e].fst_clus_lo = 0;
-                    
-                    // Set timestamps (simple: all zeros for now)
-                    entries[e].crt_time = 0;
-                    entries[e].crt_date = 0;
-                    entries[e].wrt_time = 0;
-                    entries[e].wrt_date = 0;
-                    
-                    fat32_cache_dirty();
-                    fat32_flush_cache();
-                    
-                    if (out_entry) *out_entry = entries[e];
-                    if (out_dir_cluster) *out_dir_cluster = cur_cluster;
-                    if (out_dir_entry_idx) *out_dir_entry_idx = entry_idx + e;
-                    return MIMIC_OK;
-                }
-            }
-            entry_idx += 16;
+    for (uint32_t n = 0; cluster >= 2 && cluster < FAT32_EOC && n < vol.total_clusters; n++) {
+        uint32_t next = fat32_get_fat_entry(cluster);
+        fat32_set_fat_entry(cluster, FAT32_FREE);
+        
+        if (run_len > 0 && cluster == run_start + run_len) {
+            run_len++;
+        } else {
+            if (run_len > 0) erase_queue(run_start, run_len);
+            run_start = cluster;
+            run_len = 1;
         }
-        cur_cluster = fat32_get_fat_entry(cur_cluster);
+        cluster = next;
     }
-    
-    // Directory is full - would need to allocate new cluster
-    // For now just return error
-    return MIMIC_ERR_NOMEM;
+    if (run_len > 0) erase_queue(run_start, run_len);
 }
 
+// Forward declaration
+static void fat32_name_to_83(const char* name, char* name83);
+
 // ============================================================================
-// FAT32 MOUNT
+// DIRECTORY INDEX
 // ============================================================================
 
-int mimic_fat32_mount(void) {
-    int err = mimic_sd_init();
-    if (err != MIMIC_OK) return err;
+// An entry's position in its directory: chain index * entries per cluster
+// plus the entry within the cluster. The table holds a 16-bit hash of the
+// 8.3 name per live entry (0 = empty slot) and its position; a hash match
+// is confirmed against the entry itself, so collisions only cost a read.
+
+#define DINDEX_EMPTY        0
+#define DINDEX_MASK         (MIMIC_DIR_INDEX_SLOTS - 1)
+#define DINDEX_SKIP         4       // Too-big directories remembered
+
+typedef struct {
+    uint32_t    dir;                    // First cluster; 0 when unused
+    uint32_t    used;                   // LRU stamp
+    uint32_t    chain[MIMIC_DIR_INDEX_CHAIN];
+    uint16_t    clusters;
+    uint16_t    entries;                // Live entries in the table
+    uint16_t    end;                    // First never-used position
+    uint16_t    free[MIMIC_DIR_INDEX_FREE];     // Deleted positions, ascending
+    uint8_t     free_count;
+    bool        free_more;              // Deleted entries the list had no room for
+    uint16_t*   hash;                   // MIMIC_DIR_INDEX_SLOTS each
+    uint16_t*   pos;
+} DirIndex;
+
+static DirIndex dindex[MIMIC_DIR_INDEX_DIRS];
+static uint32_t dindex_clock;
+static uint32_t dindex_skip[DINDEX_SKIP];  // Directories too big to index
+static uint32_t dindex_skip_next;
+
+static uint16_t dindex_hash(const char* name, const char* ext) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 8; i++) h = (h ^ (uint8_t)name[i]) * 16777619u;
+    for (int i = 0; i < 3; i++) h = (h ^ (uint8_t)ext[i]) * 16777619u;
+    
+    uint16_t folded = (uint16_t)(h ^ (h >> 16));
+    return folded == DINDEX_EMPTY ? 1 : folded;
+}
+
+static uint32_t dindex_per_cluster(void) {
+    return vol.sectors_per_cluster * 16;
+}
+
+// Forget the index of one directory, or of all of them for dir 0
+static void dindex_drop(uint32_t dir) {
+    for (int i = 0; i < MIMIC_DIR_INDEX_DIRS; i++) {
+        if (dir == 0 || dindex[i].dir == dir) dindex[i].dir = 0;
+    }
+    if (dir == 0) memset(dindex_skip, 0, sizeof(dindex_skip));
+}
+
+static bool dindex_skipped(uint32_t dir) {
+    for (int i = 0; i < DINDEX_SKIP; i++) {
+        if (dindex_skip[i] == dir) return true;
+    }
+    return false;
+}
+
+static void dindex_skip_add(uint32_t dir) {
+    dindex_skip[dindex_skip_next] = dir;
+    dindex_skip_next = (dindex_skip_next + 1) % DINDEX_SKIP;
+}
+
+static DirIndex* dindex_find(uint32_t dir) {
+    if (dir < 2) return NULL;
+    for (int i = 0; i < MIMIC_DIR_INDEX_DIRS; i++) {
+        if (dindex[i].dir == dir) {
+            dindex[i].used = ++dindex_clock;
+            return &dindex[i];
+        }
+    }
+    return NULL;
+}
+
+// False once the table is as full as it may get
+static bool dindex_add(DirIndex* x, uint16_t hash, uint32_t pos) {
+    if (x->entries >= MIMIC_DIR_INDEX_SLOTS * 3 / 4) return false;
     
-    vol.cached_sector = 0xFFFFFFFF;
-    vol.cache_dirty = false;
+    uint32_t i = hash & DINDEX_MASK;
+    while (x->hash[i] != DINDEX_EMPTY) i = (i + 1) & DINDEX_MASK;
+    x->hash[i] = hash;
+    x->pos[i] = (uint16_t)pos;
+    x->entries++;
+    return true;
+}
+
+static uint32_t dindex_sector(DirIndex* x, uint32_t pos) {
+    uint32_t per = dindex_per_cluster();
+    return fat32_cluster_to_sector(x->chain[pos / per]) + (pos % per) / 16;
+}
+
+// Collect dir's cluster chain; only FAT reads, so it is a cheap first test
+static int dindex_walk(uint32_t dir, uint32_t* chain, uint16_t* clusters) {
+    uint32_t per = dindex_per_cluster();
     
-    // Read sector 0 (could be MBR or boot sector)
-    err = fat32_read_sector(0);
-    if (err != MIMIC_OK) {
-        printf("[FS] Failed to read sector 0\n");
-        return err;
+    *clusters = 0;
+    for (uint32_t c = dir; c >= 2 && c < FAT32_EOC; c = fat32_get_fat_entry(c)) {
+        // Positions are 16-bit
+        if (*clusters == MIMIC_DIR_INDEX_CHAIN || (*clusters + 1) * per > 0xFFFF) {
+            return MIMIC_ERR_TOOLARGE;
+        }
+        chain[(*clusters)++] = c;
+    }
+    return MIMIC_OK;
+}
+
+// Scan the directory into x (x->dir set, table allocated)
+static int dindex_fill(DirIndex* x) {
+    uint32_t per = dindex_per_cluster();
+    
+    x->entries = 0;
+    x->free_count = 0;
+    x->free_more = false;
+    memset(x->hash, 0, MIMIC_DIR_INDEX_SLOTS * sizeof(uint16_t));
+    
+    int err = dindex_walk(x->dir, x->chain, &x->clusters);
+    if (err != MIMIC_OK) return err;
+    
+    uint32_t capacity = x->clusters * per;
+    x->end = (uint16_t)capacity;
+    
+    for (uint32_t p = 0; p < capacity; p++) {
+        if (p % 16 == 0 && fat32_read_sector(dindex_sector(x, p)) != MIMIC_OK) {
+            return MIMIC_ERR_IO;
+        }
+        
+        Fat32DirEntry* e = (Fat32DirEntry*)vol.sector_buf + p % 16;
+        uint8_t first = (uint8_t)e->name[0];
+        
+        if (first == 0x00) {
+            x->end = (uint16_t)p;
+            break;
+        }
+        if (first == 0xE5) {
+            if (x->free_count < MIMIC_DIR_INDEX_FREE) {
+                x->free[x->free_count++] = (uint16_t)p;
+            } else {
+                x->free_more = true;
+            }
+            continue;
+        }
+        if (e->attr == FAT_ATTR_LFN) continue;
+        
+        if (!dindex_add(x, dindex_hash(e->name, e->ext), p)) return MIMIC_ERR_TOOLARGE;
+    }
+    return MIMIC_OK;
+}
+
+// Index dir in the least recently used slot. A chain too long to index is
+// caught before anything is evicted; one that only turns out to hold too
+// many entries costs its slot once and is then remembered.
+static void dindex_build(uint32_t dir) {
+    if (dir < 2 || dindex_skipped(dir)) return;
+    
+    uint32_t chain[MIMIC_DIR_INDEX_CHAIN];
+    uint16_t clusters;
+    int err = dindex_walk(dir, chain, &clusters);
+    if (err != MIMIC_OK) {
+        if (err == MIMIC_ERR_TOOLARGE) dindex_skip_add(dir);
+        return;
+    }
+    
+    DirIndex* x = &dindex[0];
+    for (int i = 1; i < MIMIC_DIR_INDEX_DIRS; i++) {
+        if (dindex[i].used < x->used) x = &dindex[i];
+    }
+    
+    if (!x->hash) {
+        x->hash = mimic_kmalloc(MIMIC_DIR_INDEX_SLOTS * 2 * sizeof(uint16_t));
+        if (!x->hash) return;
+        x->pos = x->hash + MIMIC_DIR_INDEX_SLOTS;
+    }
+    
+    x->dir = dir;
+    x->used = ++dindex_clock;
+    
+    err = dindex_fill(x);
+    if (err != MIMIC_OK) {
+        x->dir = 0;
+        x->used = 0;
+        if (err == MIMIC_ERR_TOOLARGE) dindex_skip_add(dir);
+    }
+}
+
+static int dindex_lookup(DirIndex* x, const char* name83, Fat32DirEntry* out_entry,
+                         uint32_t* out_dir_cluster, uint32_t* out_dir_entry_idx) {
+    uint16_t hash = dindex_hash(name83, name83 + 8);
+    
+    for (uint32_t i = hash & DINDEX_MASK; x->hash[i] != DINDEX_EMPTY; i = (i + 1) & DINDEX_MASK) {
+        if (x->hash[i] != hash) continue;
+        
+        uint32_t pos = x->pos[i];
+        if (fat32_read_sector(dindex_sector(x, pos)) != MIMIC_OK) return MIMIC_ERR_IO;
+        
+        Fat32DirEntry* e = (Fat32DirEntry*)vol.sector_buf + pos % 16;
+        if (memcmp(e->name, name83, 8) != 0 || memcmp(e->ext, name83 + 8, 3) != 0) continue;
+        
+        if (out_entry) *out_entry = *e;
+        if (out_dir_cluster) *out_dir_cluster = x->chain[pos / dindex_per_cluster()];
+        if (out_dir_entry_idx) *out_dir_entry_idx = pos % dindex_per_cluster();
+        return MIMIC_OK;
+    }
+    return MIMIC_ERR_NOENT;
+}
+
+// Claim the first free position: a deleted entry, else the end marker
+static int dindex_take(DirIndex* x, uint32_t* pos) {
+    // The list ran dry with more deleted entries on the card: rescan
+    if (x->free_count == 0 && x->free_more) {
+        int err = dindex_fill(x);
+        if (err != MIMIC_OK) {
+            dindex_drop(x->dir);
+            return err == MIMIC_ERR_TOOLARGE ? MIMIC_ERR_BUSY : err;
+        }
+    }
+    
+    if (x->free_count > 0) {
+        *pos = x->free[0];
+        x->free_count--;
+        memmove(x->free, x->free + 1, x->free_count * sizeof(uint16_t));
+        return MIMIC_OK;
+    }
+    
+    if (x->end >= x->clusters * dindex_per_cluster()) return MIMIC_ERR_NOMEM;
+    *pos = x->end++;
+    return MIMIC_OK;
+}
+
+// ============================================================================
+// DIRECTORY SEARCH
+// ============================================================================
+
+// Linear search; *scanned counts the positions looked at
+static int fat32_dir_scan(uint32_t dir, const char* name83, Fat32DirEntry* out_entry,
+                          uint32_t* out_dir_cluster, uint32_t* out_dir_entry_idx,
+                          uint32_t* scanned) {
+    for (uint32_t cur_cluster = dir; cur_cluster < FAT32_EOC;
+         cur_cluster = fat32_get_fat_entry(cur_cluster)) {
+        uint32_t sector = fat32_cluster_to_sector(cur_cluster);
+        
+        for (uint32_t s = 0; s < vol.sectors_per_cluster; s++) {
+            if (fat32_read_sector(sector + s) != MIMIC_OK) {
+                return MIMIC_ERR_IO;
+            }
+            
+            Fat32DirEntry* entries = (Fat32DirEntry*)vol.sector_buf;
+            
+            for (int e = 0; e < 16; e++) {
+                (*scanned)++;
+                if (entries[e].name[0] == 0x00) return MIMIC_ERR_NOENT;
+                if ((uint8_t)entries[e].name[0] == 0xE5) continue;
+                if (entries[e].attr == FAT_ATTR_LFN) continue;
+                
+                if (memcmp(entries[e].name, name83, 8) == 0 &&
+                    memcmp(entries[e].ext, name83 + 8, 3) == 0) {
+                    if (out_entry) *out_entry = entries[e];
+                    if (out_dir_cluster) *out_dir_cluster = cur_cluster;
+                    if (out_dir_entry_idx) *out_dir_entry_idx = s * 16 + e;
+                    return MIMIC_OK;
+                }
+            }
+        }
+    }
+    return MIMIC_ERR_NOENT;
+}
+
+// Find name83 in a directory, through its index when it has one. A scan
+// that had to look at MIMIC_DIR_INDEX_MIN entries indexes the directory.
+static int fat32_dir_lookup(uint32_t dir, const char* name83, Fat32DirEntry* out_entry,
+                            uint32_t* out_dir_cluster, uint32_t* out_dir_entry_idx) {
+    DirIndex* x = dindex_find(dir);
+    if (x) {
+        mimic_perf_inc(MIMIC_PERF_FS_DIR_INDEXED);
+        return dindex_lookup(x, name83, out_entry, out_dir_cluster, out_dir_entry_idx);
+    }
+    
+    uint32_t scanned = 0;
+    int err = fat32_dir_scan(dir, name83, out_entry, out_dir_cluster, out_dir_entry_idx, &scanned);
+    if (err != MIMIC_ERR_IO && scanned >= MIMIC_DIR_INDEX_MIN) dindex_build(dir);
+    return err;
+}
+
+// First free entry by linear search (0x00 = never used, 0xE5 = deleted)
+static int fat32_dir_free(uint32_t dir, uint32_t* out_cluster, uint32_t* out_idx) {
+    for (uint32_t cur_cluster = dir; cur_cluster != 0 && cur_cluster < FAT32_EOC;
+         cur_cluster = fat32_get_fat_entry(cur_cluster)) {
+        for (uint32_t s = 0; s < vol.sectors_per_cluster; s++) {
+            uint32_t sector = fat32_cluster_to_sector(cur_cluster) + s;
+            if (fat32_read_sector(sector) != MIMIC_OK) return MIMIC_ERR_IO;
+            
+            Fat32DirEntry* entries = (Fat32DirEntry*)vol.sector_buf;
+            
+            for (int e = 0; e < 16; e++) {
+                if (entries[e].name[0] == 0x00 || entries[e].name[0] == (char)0xE5) {
+                    *out_cluster = cur_cluster;
+                    *out_idx = s * 16 + e;
+                    return MIMIC_OK;
+                }
+            }
+        }
+    }
+    
+    // Directory is full - would need to allocate new cluster
+    // For now just return error
+    return MIMIC_ERR_NOMEM;
+}
+
+// Create a new file in a directory
+// Returns directory cluster and entry index for later updates
+static int fat32_create_file(uint32_t dir_cluster, const char* name, 
+                              Fat32DirEntry* out_entry, 
+                              uint32_t* out_dir_cluster, uint32_t* out_dir_entry_idx) {
+    char name83[11];
+    fat32_name_to_83(name, name83);
+    
+    // Find a free entry in the directory
+    uint32_t cur_cluster = 0, entry_idx = 0, pos = 0;
+    DirIndex* x = dindex_find(dir_cluster);
+    int err = x ? dindex_take(x, &pos) : MIMIC_ERR_BUSY;
+    
+    if (err == MIMIC_OK) {
+        mimic_perf_inc(MIMIC_PERF_FS_DIR_INDEXED);
+        cur_cluster = x->chain[pos / dindex_per_cluster()];
+        entry_idx = pos % dindex_per_cluster();
+    } else if (err == MIMIC_ERR_BUSY) {
+        // No index (or it just went): search the card
+        x = NULL;
+        err = fat32_dir_free(dir_cluster, &cur_cluster, &entry_idx);
+    }
+    if (err != MIMIC_OK) return err;
+    
+    // The index already gave this slot away; if it never reaches the card
+    // the index is wrong (and a bumped end leaves a zero entry that stops
+    // linear scans), so it goes
+    uint32_t sector = fat32_cluster_to_sector(cur_cluster) + entry_idx / 16;
+    if (fat32_read_sector(sector) != MIMIC_OK) {
+        if (x) dindex_drop(dir_cluster);
+        return MIMIC_ERR_IO;
+    }
+    
+    Fat32DirEntry* entries = (Fat32DirEntry*)vol.sector_buf;
+    int e = entry_idx % 16;
+    
+    memset(&entries[e], 0, sizeof(Fat32DirEntry));
+    memcpy(entries[e].name, name83, 8);
+    memcpy(entries[e].ext, name83 + 8, 3);
+    entries[e].attr = FAT_ATTR_ARCHIVE;
+    entries[e].file_size = 0;
+    entries[e].fst_clus_hi = 0;
+    entries[e].fst_clus_lo = 0;
+    
+    // Set timestamps (simple: all zeros for now)
+    entries[e].crt_time = 0;
+    entries[e].crt_date = 0;
+    entries[e].wrt_time = 0;
+    entries[e].wrt_date = 0;
+    
+    if (out_entry) *out_entry = entries[e];
+    
+    fat32_cache_dirty();
+    err = fat32_flush_cache();
+    if (err != MIMIC_OK) {
+        if (x) dindex_drop(dir_cluster);
+        return err;
+    }
+    
+    // Keep the index exact; one that can't take the entry is dropped
+    if (x && !dindex_add(x, dindex_hash(name83, name83 + 8), pos)) dindex_drop(dir_cluster);
+    
+    if (out_dir_cluster) *out_dir_cluster = cur_cluster;
+    if (out_dir_entry_idx) *out_dir_entry_idx = entry_idx;
+    return MIMIC_OK;
+}
+
+// ============================================================================
+// FAT32 MOUNT
+// ============================================================================
+
+static int fat32_mount(MimicBlockDev* dev) {
+    vol.mounted = false;
+    vol.dev = dev;
+    
+    int err = mimic_bdev_init(dev);
+    if (err != MIMIC_OK) return err;
+    
+    vol.cached_sector = 0xFFFFFFFF;
+    vol.cache_dirty = false;
+    
+    // Read sector 0 (could be MBR or boot sector)
+    err = fat32_read_sector(0);
+    if (err != MIMIC_OK) {
+        printf("[FS] Failed to read sector 0\n");
+        return err;
     }
     
     uint32_t partition_start = 0;
@@ -618,17 +1409,24 @@ int mimic_fat32_mount(void) {
     
     strcpy(current_dir, "/");
     
-    printf("[FS] FAT32 mounted OK\n");
+    printf("[FS] FAT32 mounted OK on %s\n", dev->name);
+    vol.mounted = true;
     return MIMIC_OK;
 }
 
-void mimic_fat32_unmount(void) {
+static void fat32_unmount(void) {
+    if (!vol.mounted) return;
     fat32_flush_cache();
-    vol.initialized = false;
+    mimic_bdev_flush(vol.dev);
+    fmap_drop(0, FMAP_NONE);
+    dindex_drop(0);
+    erase_count = 0;
+    vol.mounted = false;
+    vol.initialized = false;    // SD is re-initialised on the next mount
 }
 
 bool mimic_fat32_mounted(void) {
-    return vol.initialized;
+    return vol.mounted;
 }
 
 // ============================================================================
@@ -656,12 +1454,20 @@ static void fat32_name_to_83(const char* name, char* name83) {
     }
 }
 
-static int fat32_resolve_path(const char* path, uint32_t* out_cluster, Fat32DirEntry* out_entry) {
+// out_dir_cluster/out_dir_entry_idx locate the entry for later updates;
+// they are left alone for the root, which has none
+static int fat32_resolve_path(const char* path, uint32_t* out_cluster, Fat32DirEntry* out_entry,
+                              uint32_t* out_dir_cluster, uint32_t* out_dir_entry_idx) {
     uint32_t cluster = vol.root_cluster;
     
     if (path[0] == '/') path++;
     if (path[0] == '\0') {
+        // The root has no entry of its own; describe it as a directory
         if (out_cluster) *out_cluster = vol.root_cluster;
+        if (out_entry) {
+            memset(out_entry, 0, sizeof(Fat32DirEntry));
+            out_entry->attr = FAT_ATTR_DIRECTORY;
+        }
         return MIMIC_OK;
     }
     
@@ -679,43 +1485,12 @@ static int fat32_resolve_path(const char* path, uint32_t* out_cluster, Fat32DirE
         
         fat32_name_to_83(component, name83);
         
-        // Search directory
-        bool found = false;
-        uint32_t cur_cluster = cluster;
-        
-        while (cur_cluster < FAT32_EOC) {
-            uint32_t sector = fat32_cluster_to_sector(cur_cluster);
-            
-            for (uint32_t s = 0; s < vol.sectors_per_cluster; s++) {
-                if (fat32_read_sector(sector + s) != MIMIC_OK) {
-                    return MIMIC_ERR_IO;
-                }
-                
-                Fat32DirEntry* entries = (Fat32DirEntry*)vol.sector_buf;
-                
-                for (int e = 0; e < 16; e++) {
-                    if (entries[e].name[0] == 0x00) break;
-                    if (entries[e].name[0] == 0xE5) continue;
-                    if (entries[e].attr == FAT_ATTR_LFN) continue;
-                    
-                    if (memcmp(entries[e].name, name83, 8) == 0 &&
-                        memcmp(entries[e].ext, name83 + 8, 3) == 0) {
-                        
-                        cluster = ((uint32_t)entries[e].fst_clus_hi << 16) | entries[e].fst_clus_lo;
-                        
-                        if (out_entry) *out_entry = entries[e];
-                        found = true;
-                        break;
-                    }
-                }
-                if (found) break;
-            }
-            if (found) break;
-            
-            cur_cluster = fat32_get_fat_entry(cur_cluster);
-        }
+        Fat32DirEntry entry;
+        int err = fat32_dir_lookup(cluster, name83, &entry, out_dir_cluster, out_dir_entry_idx);
+        if (err != MIMIC_OK) return err;
         
-        if (!found) return MIMIC_ERR_NOENT;
+        cluster = ((uint32_t)entry.fst_clus_hi << 16) | entry.fst_clus_lo;
+        if (out_entry) *out_entry = entry;
     }
     
     if (out_cluster) *out_cluster = cluster;
@@ -726,7 +1501,32 @@ static int fat32_resolve_path(const char* path, uint32_t* out_cluster, Fat32DirE
 // FILE OPERATIONS
 // ============================================================================
 
-int mimic_fopen(const char* path, uint8_t mode) {
+// Forward declaration
+static void fat32_update_entry(MimicFile* f);
+
+// Point the entry away from its chain and get that onto the card before
+// the chain is freed. The write-behind queue drains in LBA order, so the
+// FAT sectors could otherwise land first, and a crash in between would
+// leave the entry cross-linked with free clusters. On error the chain is
+// kept: leaked clusters are safer than shared ones.
+static int fat32_detach_chain(MimicFile* f) {
+    uint32_t old = f->first_cluster;
+    if (old == 0) return MIMIC_OK;
+    
+    f->first_cluster = 0;
+    f->current_cluster = 0;
+    f->cluster_offset = 0;
+    
+    fat32_update_entry(f);
+    int err = fat32_flush_cache();
+    if (err == MIMIC_OK) err = mimic_bdev_flush(vol.dev);
+    if (err != MIMIC_OK) return err;
+    
+    fat32_free_chain(old);
+    return MIMIC_OK;
+}
+
+static int fat32_fopen(const char* path, uint8_t mode) {
     // Find free handle
     int fd = -1;
     for (int i = 0; i < MIMIC_MAX_FILES; i++) {
@@ -741,7 +1541,8 @@ int mimic_fopen(const char* path, uint8_t mode) {
     memset(f, 0, sizeof(MimicFile));
     
     Fat32DirEntry entry;
-    int err = fat32_resolve_path(path, &f->first_cluster, &entry);
+    int err = fat32_resolve_path(path, &f->first_cluster, &entry,
+                                 &f->dir_cluster, &f->dir_entry_idx);
     
     if (err == MIMIC_ERR_NOENT && (mode & MIMIC_FILE_CREATE)) {
         // Extract parent directory and filename
@@ -757,9 +1558,9 @@ int mimic_fopen(const char* path, uint8_t mode) {
             strcpy(parent, "/");
             strncpy(filename, path, 63);
         } else if (last_slash == parent) {
-            // File in root directory
-            strcpy(parent, "/");
+            // File in root directory (take the name before parent is cut)
             strncpy(filename, last_slash + 1, 63);
+            strcpy(parent, "/");
         } else {
             *last_slash = '\0';
             strncpy(filename, last_slash + 1, 63);
@@ -773,7 +1574,7 @@ int mimic_fopen(const char* path, uint8_t mode) {
         if (strcmp(parent, "/") == 0) {
             parent_cluster = vol.root_cluster;
         } else {
-            err = fat32_resolve_path(parent, &parent_cluster, &parent_entry);
+            err = fat32_resolve_path(parent, &parent_cluster, &parent_entry, NULL, NULL);
             if (err != MIMIC_OK) return err;
             if (!(parent_entry.attr & FAT_ATTR_DIRECTORY)) return MIMIC_ERR_NOTDIR;
         }
@@ -801,48 +1602,58 @@ int mimic_fopen(const char* path, uint8_t mode) {
         mimic_fseek(fd, 0, MIMIC_SEEK_END);
     }
     
-    if (mode & MIMIC_FILE_TRUNC) {
+    if ((mode & MIMIC_FILE_TRUNC) && (mode & MIMIC_FILE_WRITE) && !f->is_dir) {
         f->file_size = 0;
-        // TODO: Free clusters
+        f->position = 0;
+        err = fat32_detach_chain(f);
+        if (err != MIMIC_OK) {
+            f->open = false;
+            return err;
+        }
     }
     
     return fd;
 }
 
-int mimic_fclose(int fd) {
+// Write the handle's size and first cluster back to its directory entry
+static void fat32_update_entry(MimicFile* f) {
+    if (!(f->mode & MIMIC_FILE_WRITE) || f->dir_cluster == 0) return;
+    
+    // Calculate sector and offset of directory entry
+    uint32_t entry_in_cluster = f->dir_entry_idx % (vol.sectors_per_cluster * 16);
+    uint32_t sector_in_cluster = entry_in_cluster / 16;
+    uint32_t entry_in_sector = entry_in_cluster % 16;
+    
+    uint32_t sector = fat32_cluster_to_sector(f->dir_cluster) + sector_in_cluster;
+    
+    if (fat32_read_sector(sector) == MIMIC_OK) {
+        Fat32DirEntry* entries = (Fat32DirEntry*)vol.sector_buf;
+        Fat32DirEntry* entry = &entries[entry_in_sector];
+        
+        // Update file size and first cluster
+        entry->file_size = f->file_size;
+        entry->fst_clus_hi = (f->first_cluster >> 16) & 0xFFFF;
+        entry->fst_clus_lo = f->first_cluster & 0xFFFF;
+        
+        fat32_cache_dirty();
+    }
+}
+
+static int fat32_fclose(int fd) {
     if (fd < 0 || fd >= MIMIC_MAX_FILES) return MIMIC_ERR_INVAL;
     if (!files[fd].open) return MIMIC_ERR_INVAL;
     
     MimicFile* f = &files[fd];
     
     // Update directory entry if file was written to
-    if ((f->mode & MIMIC_FILE_WRITE) && f->dir_cluster != 0) {
-        // Calculate sector and offset of directory entry
-        uint32_t entry_in_cluster = f->dir_entry_idx % (vol.sectors_per_cluster * 16);
-        uint32_t sector_in_cluster = entry_in_cluster / 16;
-        uint32_t entry_in_sector = entry_in_cluster % 16;
-        
-        uint32_t sector = fat32_cluster_to_sector(f->dir_cluster) + sector_in_cluster;
-        
-        if (fat32_read_sector(sector) == MIMIC_OK) {
-            Fat32DirEntry* entries = (Fat32DirEntry*)vol.sector_buf;
-            Fat32DirEntry* entry = &entries[entry_in_sector];
-            
-            // Update file size and first cluster
-            entry->file_size = f->file_size;
-            entry->fst_clus_hi = (f->first_cluster >> 16) & 0xFFFF;
-            entry->fst_clus_lo = f->first_cluster & 0xFFFF;
-            
-            fat32_cache_dirty();
-        }
-    }
+    fat32_update_entry(f);
     
     fat32_flush_cache();
     files[fd].open = false;
     return MIMIC_OK;
 }
 
-int mimic_fread(int fd, void* buf, size_t size) {
+static int fat32_fread(int fd, void* buf, size_t size) {
     if (fd < 0 || fd >= MIMIC_MAX_FILES) return MIMIC_ERR_INVAL;
     MimicFile* f = &files[fd];
     if (!f->open) return MIMIC_ERR_INVAL;
@@ -858,18 +1669,30 @@ int mimic_fread(int fd, void* buf, size_t size) {
         uint32_t offset_in_sector = f->cluster_offset % 512;
         uint32_t sector = fat32_cluster_to_sector(f->current_cluster) + sector_in_cluster;
         
-        if (fat32_read_sector(sector) != MIMIC_OK) {
-            return bytes_read > 0 ? (int)bytes_read : MIMIC_ERR_IO;
-        }
-        
-        uint32_t bytes_in_sector = 512 - offset_in_sector;
         uint32_t bytes_in_file = f->file_size - f->position;
         uint32_t bytes_to_copy = size - bytes_read;
-        
-        if (bytes_to_copy > bytes_in_sector) bytes_to_copy = bytes_in_sector;
         if (bytes_to_copy > bytes_in_file) bytes_to_copy = bytes_in_file;
         
-        memcpy(out + bytes_read, vol.sector_buf + offset_in_sector, bytes_to_copy);
+        // Whole sectors go straight from the device into the caller's buffer
+        uint32_t run = fat32_run_sectors(f, bytes_to_copy);
+        if (run > 0) {
+            if (fat32_cache_in(sector, run) && fat32_flush_cache() != MIMIC_OK) {
+                return bytes_read > 0 ? (int)bytes_read : MIMIC_ERR_IO;
+            }
+            if (mimic_bdev_read(vol.dev, sector, out + bytes_read, run) != MIMIC_OK) {
+                return bytes_read > 0 ? (int)bytes_read : MIMIC_ERR_IO;
+            }
+            bytes_to_copy = run * 512;
+        } else {
+            if (fat32_read_sector(sector) != MIMIC_OK) {
+                return bytes_read > 0 ? (int)bytes_read : MIMIC_ERR_IO;
+            }
+            
+            uint32_t bytes_in_sector = 512 - offset_in_sector;
+            if (bytes_to_copy > bytes_in_sector) bytes_to_copy = bytes_in_sector;
+            
+            memcpy(out + bytes_read, vol.sector_buf + offset_in_sector, bytes_to_copy);
+        }
         
         bytes_read += bytes_to_copy;
         f->position += bytes_to_copy;
@@ -884,12 +1707,15 @@ int mimic_fread(int fd, void* buf, size_t size) {
     return (int)bytes_read;
 }
 
-int mimic_fwrite(int fd, const void* buf, size_t size) {
+static int fat32_fwrite(int fd, const void* buf, size_t size) {
     if (fd < 0 || fd >= MIMIC_MAX_FILES) return MIMIC_ERR_INVAL;
     MimicFile* f = &files[fd];
     if (!f->open) return MIMIC_ERR_INVAL;
     if (!(f->mode & MIMIC_FILE_WRITE)) return MIMIC_ERR_PERM;
     
+    // Raw entries written through a directory handle bypass the index
+    if (f->is_dir) dindex_drop(f->first_cluster);
+    
     const uint8_t* in = (const uint8_t*)buf;
     size_t bytes_written = 0;
     
@@ -912,19 +1738,35 @@ int mimic_fwrite(int fd, const void* buf, size_t size) {
         uint32_t offset_in_sector = f->cluster_offset % 512;
         uint32_t sector = fat32_cluster_to_sector(f->current_cluster) + sector_in_cluster;
         
-        if (offset_in_sector != 0 || (size - bytes_written) < 512) {
-            if (fat32_read_sector(sector) != MIMIC_OK) {
+        uint32_t bytes_to_copy = size - bytes_written;
+        
+        // Whole sectors go straight to the device; a cached copy of any of
+        // them is overwritten entirely, so it is just dropped
+        uint32_t run = fat32_run_sectors(f, bytes_to_copy);
+        if (run > 0) {
+            if (fat32_cache_in(sector, run)) {
+                vol.cached_sector = 0xFFFFFFFF;
+                vol.cache_dirty = false;
+            }
+            fmap_drop(sector, run);
+            if (mimic_bdev_write(vol.dev, sector, in + bytes_written, run) != MIMIC_OK) {
                 return bytes_written > 0 ? (int)bytes_written : MIMIC_ERR_IO;
             }
+            bytes_to_copy = run * 512;
+        } else {
+            if (offset_in_sector != 0 || bytes_to_copy < 512) {
+                if (fat32_read_sector(sector) != MIMIC_OK) {
+                    return bytes_written > 0 ? (int)bytes_written : MIMIC_ERR_IO;
+                }
+            }
+            
+            uint32_t bytes_in_sector = 512 - offset_in_sector;
+            if (bytes_to_copy > bytes_in_sector) bytes_to_copy = bytes_in_sector;
+            
+            memcpy(vol.sector_buf + offset_in_sector, in + bytes_written, bytes_to_copy);
+            fat32_cache_dirty();
         }
         
-        uint32_t bytes_in_sector = 512 - offset_in_sector;
-        uint32_t bytes_to_copy = size - bytes_written;
-        if (bytes_to_copy > bytes_in_sector) bytes_to_copy = bytes_in_sector;
-        
-        memcpy(vol.sector_buf + offset_in_sector, in + bytes_written, bytes_to_copy);
-        fat32_cache_dirty();
-        
         bytes_written += bytes_to_copy;
         f->position += bytes_to_copy;
         f->cluster_offset += bytes_to_copy;
@@ -952,7 +1794,7 @@ int mimic_fwrite(int fd, const void* buf, size_t size) {
     return (int)bytes_written;
 }
 
-int mimic_fseek(int fd, int32_t offset, int whence) {
+static int fat32_fseek(int fd, int32_t offset, int whence) {
     if (fd < 0 || fd >= MIMIC_MAX_FILES) return MIMIC_ERR_INVAL;
     MimicFile* f = &files[fd];
     if (!f->open) return MIMIC_ERR_INVAL;
@@ -982,37 +1824,54 @@ int mimic_fseek(int fd, int32_t offset, int whence) {
 }
 
 int32_t mimic_ftell(int fd) {
+    if (mimic_log_fd(fd)) return mimic_log_size(fd);
+    if (mimic_tmpfs_fd(fd)) return mimic_tmpfs_tell(fd);
     if (fd < 0 || fd >= MIMIC_MAX_FILES) return MIMIC_ERR_INVAL;
     if (!files[fd].open) return MIMIC_ERR_INVAL;
     return files[fd].position;
 }
 
 int32_t mimic_fsize(int fd) {
+    if (mimic_log_fd(fd)) return mimic_log_size(fd);
+    if (mimic_tmpfs_fd(fd)) return mimic_tmpfs_size(fd);
     if (fd < 0 || fd >= MIMIC_MAX_FILES) return MIMIC_ERR_INVAL;
     if (!files[fd].open) return MIMIC_ERR_INVAL;
     return files[fd].file_size;
 }
 
 bool mimic_feof(int fd) {
+    if (mimic_log_fd(fd)) return true;
+    if (mimic_tmpfs_fd(fd)) return mimic_tmpfs_tell(fd) >= mimic_tmpfs_size(fd);
     if (fd < 0 || fd >= MIMIC_MAX_FILES) return true;
     if (!files[fd].open) return true;
     return files[fd].position >= files[fd].file_size;
 }
 
 int mimic_fflush(int fd) {
-    (void)fd;
-    return fat32_flush_cache();
+    if (mimic_log_fd(fd)) return mimic_log_sync(fd);
+    
+    fs_lock();
+    int err = fat32_flush_cache();
+    if (err == MIMIC_OK) err = mimic_bdev_flush(vol.dev);
+    fs_unlock();
+    return err;
 }
 
 bool mimic_exists(const char* path) {
     Fat32DirEntry entry;
-    return fat32_resolve_path(path, NULL, &entry) == MIMIC_OK;
+    fs_lock();
+    bool found = mimic_tmpfs_exists(path) ||
+                 fat32_resolve_path(path, NULL, &entry, NULL, NULL) == MIMIC_OK;
+    fs_unlock();
+    return found;
 }
 
 bool mimic_is_dir(const char* path) {
     Fat32DirEntry entry;
-    if (fat32_resolve_path(path, NULL, &entry) != MIMIC_OK) return false;
-    return (entry.attr & FAT_ATTR_DIRECTORY) != 0;
+    fs_lock();
+    bool found = fat32_resolve_path(path, NULL, &entry, NULL, NULL) == MIMIC_OK;
+    fs_unlock();
+    return found && (entry.attr & FAT_ATTR_DIRECTORY) != 0;
 }
 
 int mimic_mkdir(const char* path) {
@@ -1028,7 +1887,7 @@ int mimic_opendir(const char* path) {
     return mimic_fopen(path, MIMIC_FILE_READ);
 }
 
-int mimic_readdir(int dir_handle, MimicDirEntry* entry) {
+static int fat32_readdir(int dir_handle, MimicDirEntry* entry) {
     if (dir_handle < 0 || dir_handle >= MIMIC_MAX_FILES) return MIMIC_ERR_INVAL;
     MimicFile* f = &files[dir_handle];
     if (!f->open || !f->is_dir) return MIMIC_ERR_INVAL;
@@ -1076,6 +1935,7 @@ int mimic_readdir(int dir_handle, MimicDirEntry* entry) {
         entry->name[j] = '\0';
         
         entry->size = de->file_size;
+        entry->mtime = ((uint32_t)de->wrt_date << 16) | de->wrt_time;
         entry->attr = de->attr;
         entry->is_dir = (de->attr & FAT_ATTR_DIRECTORY) != 0;
         
@@ -1089,6 +1949,100 @@ int mimic_closedir(int dir_handle) {
     return mimic_fclose(dir_handle);
 }
 
+// ============================================================================
+// LOCKED ENTRY POINTS
+// ============================================================================
+
+int mimic_fat32_mount(void) {
+    // Unmount before re-attaching, all under the lock, so no other core
+    // can queue I/O while the scheduler is reset beneath it
+    fs_lock();
+    fat32_unmount();
+    int err = fat32_mount(mimic_iosched_attach(&mimic_bdev_sd));
+    fs_unlock();
+    return err;
+}
+
+int mimic_fat32_mount_dev(MimicBlockDev* dev) {
+    fs_lock();
+    fat32_unmount();
+    int err = fat32_mount(dev);
+    fs_unlock();
+    return err;
+}
+
+void mimic_fat32_unmount(void) {
+    fs_lock();
+    fat32_unmount();
+    fs_unlock();
+}
+
+// Paths under the tmpfs root try RAM first; anything tmpfs doesn't hold
+// (never created there, or spilled) comes from the card. Logs are always
+// on the card.
+int mimic_fopen(const char* path, uint8_t mode) {
+    if (mode & MIMIC_FILE_LOG) return mimic_log_open(path, mode);
+    
+    fs_lock();
+    int fd = MIMIC_ERR_NOENT;
+    if (mimic_tmpfs_owns(path)) fd = mimic_tmpfs_open(path, mode);
+    if (fd == MIMIC_ERR_NOENT) fd = fat32_fopen(path, mode);
+    fs_unlock();
+    return fd;
+}
+
+int mimic_fat32_fopen(const char* path, uint8_t mode) {
+    fs_lock();
+    int fd = fat32_fopen(path, mode);
+    fs_unlock();
+    return fd;
+}
+
+int mimic_fclose(int fd) {
+    if (mimic_log_fd(fd)) return mimic_log_close(fd);
+    
+    fs_lock();
+    int err = mimic_tmpfs_fd(fd) ? mimic_tmpfs_close(fd) : fat32_fclose(fd);
+    fs_unlock();
+    return err;
+}
+
+int mimic_fread(int fd, void* buf, size_t size) {
+    if (mimic_log_fd(fd)) return MIMIC_ERR_PERM;
+    
+    fs_lock();
+    int n = mimic_tmpfs_fd(fd) ? mimic_tmpfs_read(fd, buf, size) : fat32_fread(fd, buf, size);
+    fs_unlock();
+    return n;
+}
+
+// Log writes only copy into RAM and never take the FS lock
+int mimic_fwrite(int fd, const void* buf, size_t size) {
+    if (mimic_log_fd(fd)) return mimic_log_write(fd, buf, size);
+    
+    fs_lock();
+    int n = mimic_tmpfs_fd(fd) ? mimic_tmpfs_write(fd, buf, size) : fat32_fwrite(fd, buf, size);
+    fs_unlock();
+    return n;
+}
+
+int mimic_fseek(int fd, int32_t offset, int whence) {
+    if (mimic_log_fd(fd)) return MIMIC_ERR_NOSYS;
+    
+    fs_lock();
+    int err = mimic_tmpfs_fd(fd) ? mimic_tmpfs_seek(fd, offset, whence)
+                                 : fat32_fseek(fd, offset, whence);
+    fs_unlock();
+    return err;
+}
+
+int mimic_readdir(int dir_handle, MimicDirEntry* entry) {
+    fs_lock();
+    int err = fat32_readdir(dir_handle, entry);
+    fs_unlock();
+    return err;
+}
+
 // ============================================================================
 // STREAMING I/O (for compiler)
 // ============================================================================
@@ -1121,17 +2075,20 @@ int mimic_stream_close(MimicStream* stream) {
     return err;
 }
 
-int mimic_stream_getc(MimicStream* stream) {
-    if (stream->buf_pos >= stream->buf_len) {
-        int n = mimic_fread(stream->fd, stream->buffer, stream->buf_size);
-        if (n <= 0) {
-            stream->eof = true;
-            return -1;
-        }
-        stream->buf_len = n;
-        stream->buf_pos = 0;
+// Refill an exhausted read buffer; 0 at end of file
+static int stream_fill(MimicStream* stream) {
+    int n = mimic_fread(stream->fd, stream->buffer, stream->buf_size);
+    if (n <= 0) {
+        stream->eof = true;
+        return n;
     }
-    
+    stream->buf_len = n;
+    stream->buf_pos = 0;
+    return n;
+}
+
+int mimic_stream_getc(MimicStream* stream) {
+    if (stream->buf_pos >= stream->buf_len && stream_fill(stream) <= 0) return -1;
     return stream->buffer[stream->buf_pos++];
 }
 
@@ -1162,34 +2119,46 @@ int mimic_stream_puts(MimicStream* stream, const char* s) {
     return MIMIC_OK;
 }
 
+int mimic_stream_peek(MimicStream* stream, const uint8_t** ptr, uint32_t* len) {
+    if (stream->buf_pos >= stream->buf_len) {
+        int n = stream_fill(stream);
+        if (n < 0) return n;
+    }
+    
+    *ptr = stream->buffer + stream->buf_pos;
+    *len = stream->buf_len - stream->buf_pos;
+    return MIMIC_OK;
+}
+
+int mimic_stream_consume(MimicStream* stream, uint32_t n) {
+    if (n > stream->buf_len - stream->buf_pos) return MIMIC_ERR_INVAL;
+    stream->buf_pos += n;
+    return MIMIC_OK;
+}
+
 int mimic_stream_read(MimicStream* stream, void* buf, size_t size) {
     uint8_t* out = (uint8_t*)buf;
     size_t total = 0;
     
-    // First, use any buffered data
-    while (total < size && stream->buf_pos < stream->buf_len) {
-        out[total++] = stream->buffer[stream->buf_pos++];
-    }
-    
-    // Then read directly for large requests
-    if (size - total >= stream->buf_size) {
-        int n = mimic_fread(stream->fd, out + total, size - total);
-        if (n > 0) total += n;
-    } else {
-        // Refill buffer and copy
-        while (total < size) {
-            int n = mimic_fread(stream->fd, stream->buffer, stream->buf_size);
-            if (n <= 0) {
-                stream->eof = true;
+    while (total < size) {
+        uint32_t avail = stream->buf_len - stream->buf_pos;
+        
+        if (avail == 0) {
+            // Large remainders skip the buffer entirely
+            if (size - total >= stream->buf_size) {
+                int n = mimic_fread(stream->fd, out + total, size - total);
+                if (n < (int)(size - total)) stream->eof = true;
+                if (n > 0) total += n;
                 break;
             }
-            stream->buf_len = n;
-            stream->buf_pos = 0;
-            
-            while (total < size && stream->buf_pos < stream->buf_len) {
-                out[total++] = stream->buffer[stream->buf_pos++];
-            }
+            if (stream_fill(stream) <= 0) break;
+            continue;
         }
+        
+        uint32_t chunk = size - total < avail ? size - total : avail;
+        memcpy(out + total, stream->buffer + stream->buf_pos, chunk);
+        stream->buf_pos += chunk;
+        total += chunk;
     }
     
     return (int)total;
@@ -1200,10 +2169,11 @@ int mimic_stream_write(MimicStream* stream, const void* buf, size_t size) {
     size_t total = 0;
     
     while (total < size) {
-        // Fill buffer
-        while (total < size && stream->buf_pos < stream->buf_size) {
-            stream->buffer[stream->buf_pos++] = in[total++];
-        }
+        uint32_t room = stream->buf_size - stream->buf_pos;
+        uint32_t chunk = size - total < room ? size - total : room;
+        memcpy(stream->buffer + stream->buf_pos, in + total, chunk);
+        stream->buf_pos += chunk;
+        total += chunk;
         
         // Flush if full
         if (stream->buf_pos >= stream->buf_size) {
@@ -1229,12 +2199,440 @@ int mimic_stream_flush(MimicStream* stream) {
     return mimic_fflush(stream->fd);
 }
 
+// ============================================================================
+// MAPPED VIEWS
+// ============================================================================
+
+typedef struct {
+    uint32_t    sector;         // FMAP_NONE when free or detached
+    uint32_t    used;           // LRU stamp
+    uint16_t    refs;
+} FmapSlot;
+
+static FmapSlot fmap_slots[MIMIC_FMAP_SLOTS];
+static uint8_t (*fmap_data)[SD_SECTOR_SIZE];    // Allocated on first map
+static uint32_t fmap_clock;
+
+// Forget cached copies of [sector, sector + count); pinned ones detach
+static void fmap_drop(uint32_t sector, uint32_t count) {
+    if (!fmap_data) return;
+    for (int i = 0; i < MIMIC_FMAP_SLOTS; i++) {
+        if (fmap_slots[i].sector - sector < count) fmap_slots[i].sector = FMAP_NONE;
+    }
+}
+
+// Sector holding offset, walking the chain from the last mapped cluster
+// when that is no further along than the target; 0 if the chain ends
+static uint32_t fmap_locate(MimicFile* f, uint32_t offset) {
+    uint32_t index = offset / vol.bytes_per_cluster;
+    uint32_t cluster = f->first_cluster;
+    uint32_t i = 0;
+    
+    if (f->map_cluster != 0 && f->map_index <= index) {
+        cluster = f->map_cluster;
+        i = f->map_index;
+    }
+    for (; i < index && cluster >= 2 && cluster < FAT32_EOC; i++) {
+        cluster = fat32_get_fat_entry(cluster);
+    }
+    if (cluster < 2 || cluster >= FAT32_EOC) return 0;
+    
+    f->map_cluster = cluster;
+    f->map_index = index;
+    return fat32_cluster_to_sector(cluster) + (offset % vol.bytes_per_cluster) / 512;
+}
+
+static int fmap_get(uint32_t sector) {
+    int victim = -1;
+    for (int i = 0; i < MIMIC_FMAP_SLOTS; i++) {
+        if (fmap_slots[i].sector == sector) {
+            mimic_perf_inc(MIMIC_PERF_FS_CACHE_HITS);
+            return i;
+        }
+        if (fmap_slots[i].refs == 0 &&
+            (victim < 0 || fmap_slots[i].used < fmap_slots[victim].used)) {
+            victim = i;
+        }
+    }
+    if (victim < 0) return MIMIC_ERR_BUSY;      // Everything is pinned
+    mimic_perf_inc(MIMIC_PERF_FS_CACHE_MISSES);
+    
+    // The sector cache may hold data newer than the device
+    fmap_slots[victim].sector = FMAP_NONE;
+    if (vol.cached_sector == sector) {
+        memcpy(fmap_data[victim], vol.sector_buf, SD_SECTOR_SIZE);
+    } else {
+        int err = mimic_bdev_read(vol.dev, sector, fmap_data[victim], 1);
+        if (err != MIMIC_OK) return err;
+    }
+    fmap_slots[victim].sector = sector;
+    return victim;
+}
+
+static int fat32_fmap(int fd, uint32_t offset, uint32_t len, MimicFileView* view) {
+    if (fd < 0 || fd >= MIMIC_MAX_FILES) return MIMIC_ERR_INVAL;
+    MimicFile* f = &files[fd];
+    if (!f->open) return MIMIC_ERR_INVAL;
+    if (!(f->mode & MIMIC_FILE_READ)) return MIMIC_ERR_PERM;
+    if (len == 0 || offset >= f->file_size) return MIMIC_OK;
+    
+    if (!fmap_data) {
+        fmap_data = mimic_kmalloc(MIMIC_FMAP_SLOTS * SD_SECTOR_SIZE);
+        if (!fmap_data) return MIMIC_ERR_NOMEM;
+        for (int i = 0; i < MIMIC_FMAP_SLOTS; i++) fmap_slots[i].sector = FMAP_NONE;
+    }
+    
+    uint32_t sector = fmap_locate(f, offset);
+    if (sector == 0) return MIMIC_ERR_CORRUPT;
+    
+    int slot = fmap_get(sector);
+    if (slot < 0) return slot;
+    
+    uint32_t in_sector = offset % SD_SECTOR_SIZE;
+    uint32_t avail = SD_SECTOR_SIZE - in_sector;
+    if (avail > f->file_size - offset) avail = f->file_size - offset;
+    if (avail > len) avail = len;
+    
+    fmap_slots[slot].refs++;
+    fmap_slots[slot].used = ++fmap_clock;
+    view->data = fmap_data[slot] + in_sector;
+    view->len = avail;
+    view->slot = slot;
+    return MIMIC_OK;
+}
+
+int mimic_fmap(int fd, uint32_t offset, uint32_t len, MimicFileView* view) {
+    view->data = NULL;
+    view->len = 0;
+    view->slot = -1;
+    if (mimic_tmpfs_fd(fd)) return MIMIC_ERR_NOSYS;
+    
+    fs_lock();
+    int err = fat32_fmap(fd, offset, len, view);
+    fs_unlock();
+    return err;
+}
+
+void mimic_funmap(MimicFileView* view) {
+    if (view->slot < 0) return;
+    
+    fs_lock();
+    fmap_slots[view->slot].refs--;
+    fs_unlock();
+    
+    view->data = NULL;
+    view->len = 0;
+    view->slot = -1;
+}
+
+// ============================================================================
+// RAW EXTENTS
+// ============================================================================
+
+// Last cluster of the chain, walking on from the fmap hint, which is left
+// pointing at it; 0 for an empty file
+static uint32_t fat32_last_cluster(MimicFile* f) {
+    if (f->first_cluster == 0) return 0;
+    
+    if (f->map_cluster == 0) {
+        f->map_cluster = f->first_cluster;
+        f->map_index = 0;
+    }
+    for (uint32_t n = 0; n < vol.total_clusters; n++) {
+        uint32_t next = fat32_get_fat_entry(f->map_cluster);
+        if (next < 2 || next >= FAT32_EOC) break;
+        f->map_cluster = next;
+        f->map_index++;
+    }
+    return f->map_cluster;
+}
+
+// First free run at or after from (wrapping), up to want clusters long
+static uint32_t fat32_find_run(uint32_t from, uint32_t want, uint32_t* len) {
+    uint32_t end = vol.total_clusters + 2;
+    if (from < 2 || from >= end) from = 2;
+    
+    uint32_t c = from;
+    for (uint32_t n = 0; n < vol.total_clusters; n++) {
+        if (fat32_get_fat_entry(c) == FAT32_FREE) {
+            uint32_t run = 1;
+            while (run < want && c + run < end && fat32_get_fat_entry(c + run) == FAT32_FREE) run++;
+            *len = run;
+            return c;
+        }
+        if (++c == end) c = 2;
+    }
+    return 0;
+}
+
+static int fat32_extend(int fd, uint32_t bytes) {
+    if (fd < 0 || fd >= MIMIC_MAX_FILES) return MIMIC_ERR_INVAL;
+    MimicFile* f = &files[fd];
+    if (!f->open || f->is_dir || !(f->mode & MIMIC_FILE_WRITE)) return MIMIC_ERR_INVAL;
+    
+    uint32_t last = fat32_last_cluster(f);
+    uint32_t clusters = last ? f->map_index + 1 : 0;
+    uint32_t want = (bytes + vol.bytes_per_cluster - 1) / vol.bytes_per_cluster;
+    
+    while (clusters < want) {
+        uint32_t len;
+        uint32_t start = fat32_find_run(last + 1, want - clusters, &len);
+        if (start == 0) break;                  // Volume full
+        
+        for (uint32_t c = start; c < start + len; c++) {
+            fat32_set_fat_entry(c, c + 1 < start + len ? c + 1 : FAT32_EOC);
+            erase_claim(c);
+        }
+        if (last) {
+            fat32_set_fat_entry(last, start);
+        } else {
+            f->first_cluster = start;
+            f->current_cluster = start;
+        }
+        
+        last = start + len - 1;
+        clusters += len;
+        f->map_cluster = last;
+        f->map_index = clusters - 1;
+    }
+    
+    int err = fat32_flush_cache();
+    if (err != MIMIC_OK) return err;
+    if (clusters == 0) return MIMIC_ERR_NOMEM;
+    return (int)(clusters * vol.bytes_per_cluster);
+}
+
+static int fat32_extent(int fd, uint32_t offset, uint32_t max, uint32_t* sector, uint32_t* count) {
+    if (fd < 0 || fd >= MIMIC_MAX_FILES || !files[fd].open) return MIMIC_ERR_INVAL;
+    MimicFile* f = &files[fd];
+    
+    *sector = fmap_locate(f, offset);
+    if (*sector == 0) return MIMIC_ERR_NOENT;
+    
+    // Run on through clusters that sit back to back on the device
+    uint32_t n = vol.sectors_per_cluster - (offset % vol.bytes_per_cluster) / 512;
+    uint32_t cluster = f->map_cluster;
+    while (n < max) {
+        uint32_t next = fat32_get_fat_entry(cluster);
+        if (next != cluster + 1) break;
+        cluster = next;
+        n += vol.sectors_per_cluster;
+    }
+    *count = n < max ? n : max;
+    return MIMIC_OK;
+}
+
+static int fat32_set_size(int fd, uint32_t size) {
+    if (fd < 0 || fd >= MIMIC_MAX_FILES || !files[fd].open) return MIMIC_ERR_INVAL;
+    MimicFile* f = &files[fd];
+    
+    f->file_size = size;
+    fat32_update_entry(f);
+    return fat32_flush_cache();
+}
+
+// Free whatever the chain holds past file_size
+static int fat32_trim(int fd) {
+    if (fd < 0 || fd >= MIMIC_MAX_FILES || !files[fd].open) return MIMIC_ERR_INVAL;
+    MimicFile* f = &files[fd];
+    if (f->first_cluster == 0) return MIMIC_OK;
+    
+    // Nothing kept: the entry lets go of the chain before it is freed
+    if (f->file_size == 0) {
+        f->map_cluster = 0;
+        return fat32_detach_chain(f);
+    }
+    
+    uint32_t keep = (f->file_size - 1) / vol.bytes_per_cluster;
+    uint32_t cluster = f->first_cluster;
+    for (uint32_t i = 0; i < keep && cluster >= 2 && cluster < FAT32_EOC; i++) {
+        cluster = fat32_get_fat_entry(cluster);
+    }
+    if (cluster < 2 || cluster >= FAT32_EOC) return MIMIC_ERR_CORRUPT;
+    
+    uint32_t next = fat32_get_fat_entry(cluster);
+    if (next >= 2 && next < FAT32_EOC) {
+        // Likewise the new end of chain goes out before the tail is freed
+        fat32_set_fat_entry(cluster, FAT32_EOC);
+        int err = fat32_flush_cache();
+        if (err == MIMIC_OK) err = mimic_bdev_flush(vol.dev);
+        if (err != MIMIC_OK) return err;
+        fat32_free_chain(next);
+    }
+    f->map_cluster = 0;
+    
+    fat32_update_entry(f);
+    return fat32_flush_cache();
+}
+
+int mimic_fat32_extend(int fd, uint32_t bytes) {
+    fs_lock();
+    int n = fat32_extend(fd, bytes);
+    fs_unlock();
+    return n;
+}
+
+int mimic_fat32_extent(int fd, uint32_t offset, uint32_t max, uint32_t* sector, uint32_t* count) {
+    fs_lock();
+    int err = fat32_extent(fd, offset, max, sector, count);
+    fs_unlock();
+    return err;
+}
+
+int mimic_fat32_write_raw(uint32_t sector, const void* buf, uint32_t count) {
+    fs_lock();
+    if (fat32_cache_in(sector, count)) {
+        vol.cached_sector = 0xFFFFFFFF;
+        vol.cache_dirty = false;
+    }
+    fmap_drop(sector, count);
+    int err = mimic_bdev_write(vol.dev, sector, buf, count);
+    fs_unlock();
+    return err;
+}
+
+int mimic_fat32_set_size(int fd, uint32_t size) {
+    fs_lock();
+    int err = fat32_set_size(fd, size);
+    fs_unlock();
+    return err;
+}
+
+int mimic_fat32_trim(int fd) {
+    fs_lock();
+    int err = fat32_trim(fd);
+    fs_unlock();
+    return err;
+}
+
+// ============================================================================
+// BACKGROUND ERASE
+// ============================================================================
+
+static void erase_remove(uint32_t i) {
+    erase_runs[i] = erase_runs[--erase_count];
+}
+
+// A cluster handed out again must never be erased under its new owner
+static void erase_claim(uint32_t cluster) {
+    for (uint32_t i = 0; i < erase_count; i++) {
+        EraseRun* run = &erase_runs[i];
+        uint32_t off = cluster - run->cluster;
+        if (off >= run->count) continue;
+        
+        uint32_t tail = run->count - off - 1;
+        run->count = off;
+        if (tail > 0) {
+            if (run->count == 0) {
+                run->cluster = cluster + 1;
+                run->count = tail;
+            } else if (erase_count < MIMIC_ERASE_RUNS) {
+                erase_runs[erase_count].cluster = cluster + 1;
+                erase_runs[erase_count].count = tail;
+                erase_count++;
+            }
+        }
+        if (run->count == 0) erase_remove(i);
+        return;
+    }
+}
+
+static int erase_thread(void* arg);
+
+static void erase_queue(uint32_t cluster, uint32_t count) {
+    bool merged = false;
+    for (uint32_t i = 0; i < erase_count && !merged; i++) {
+        EraseRun* run = &erase_runs[i];
+        if (run->cluster + run->count == cluster) {
+            run->count += count;
+            merged = true;
+        } else if (cluster + count == run->cluster) {
+            run->cluster = cluster;
+            run->count += count;
+            merged = true;
+        }
+    }
+    
+    // Erasing is only an optimisation; a full list just loses the run
+    if (!merged) {
+        if (erase_count == MIMIC_ERASE_RUNS) return;
+        erase_runs[erase_count].cluster = cluster;
+        erase_runs[erase_count].count = count;
+        erase_count++;
+    }
+    
+    if (erase_task < 0) {
+        erase_task = mimic_kthread_spawn("erase", MIMIC_PRIO_BACKGROUND, erase_thread, NULL);
+    }
+}
+
+static int erase_thread(void* arg) {
+    (void)arg;
+    
+    if (!mimic_fs_try_lock()) {
+        mimic_kthread_sleep(MIMIC_ERASE_INTERVAL_MS);
+        return MIMIC_ERR_BUSY;
+    }
+    
+    if (erase_count == 0 || !vol.mounted) {
+        erase_count = 0;
+        erase_task = -1;
+        mimic_fs_unlock();
+        return MIMIC_OK;
+    }
+    
+    // Stay out of the way: only a quiet FS with no writes waiting
+    if (time_us_64() - fs_last_us < MIMIC_ERASE_IDLE_MS * 1000ull ||
+        mimic_iosched_pending() > 0) {
+        mimic_fs_unlock();
+        mimic_kthread_sleep(MIMIC_ERASE_IDLE_MS);
+        return MIMIC_ERR_BUSY;
+    }
+    
+    EraseRun* run = &erase_runs[0];
+    uint32_t max = MIMIC_ERASE_MAX_SECTORS / vol.sectors_per_cluster;
+    if (max == 0) max = 1;
+    uint32_t n = run->count < max ? run->count : max;
+    uint32_t sector = fat32_cluster_to_sector(run->cluster);
+    uint32_t sectors = n * vol.sectors_per_cluster;
+    
+    // Cached copies of the range are meaningless from here on
+    if (fat32_cache_in(sector, sectors)) {
+        vol.cached_sector = 0xFFFFFFFF;
+        vol.cache_dirty = false;
+    }
+    fmap_drop(sector, sectors);
+    
+    int err = mimic_bdev_discard(vol.dev, sector, sectors);
+    if (err == MIMIC_ERR_NOSYS) {
+        erase_count = 0;                        // The device can't; stop asking
+    } else {
+        if (err == MIMIC_OK) mimic_perf_add(MIMIC_PERF_FS_ERASED, sectors);
+        run->cluster += n;
+        run->count -= n;
+        if (run->count == 0) erase_remove(0);
+    }
+    mimic_fs_unlock();
+    
+    if (err != MIMIC_OK && err != MIMIC_ERR_NOSYS) {
+        printf("[FS] Background erase failed (%d)\n", err);
+    }
+    mimic_kthread_sleep(MIMIC_ERASE_INTERVAL_MS);
+    return MIMIC_ERR_BUSY;
+}
+
+uint32_t mimic_fat32_erase_pending(void) {
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < erase_count; i++) total += erase_runs[i].count;
+    return total;
+}
+
 // ============================================================================
 // FS INFO
 // ============================================================================
 
-int mimic_fs_info(MimicFSInfo* info) {
-    if (!vol.initialized) return MIMIC_ERR_IO;
+static int fat32_fs_info(MimicFSInfo* info) {
+    if (!vol.mounted) return MIMIC_ERR_IO;
     
     info->sector_size = 512;
     info->cluster_size = vol.bytes_per_cluster;
@@ -1253,3 +2651,10 @@ int mimic_fs_info(MimicFSInfo* info) {
     
     return MIMIC_OK;
 }
+
+int mimic_fs_info(MimicFSInfo* info) {
+    fs_lock();
+    int err = fat32_fs_info(info);
+    fs_unlock();
+    return err;
+}
@@ -0,0 +1,263 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC I/O Scheduler - Write-behind sector queue in front of a device     ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  Elevator-ordered, merged multi-block writes from a kernel thread         ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * Sector writes from FAT32 land in a small queue and return at once. A
+ * rewrite of a queued sector just replaces its data, so FAT and directory
+ * sectors touched on every fwrite go to the card once per drain.
+ * 
+ * Draining sorts the queue by LBA and starts from the last LBA written,
+ * sweeping upward and then wrapping (C-SCAN). Runs of consecutive LBAs are
+ * written with one multi-block call. Slots are sorted in place, so a run
+ * is already contiguous in memory.
+ * 
+ * The "iosched" kthread drains the queue MIMIC_IOSCHED_DELAY_MS after the
+ * first write, under the FS lock (tried, never waited for). A full queue
+ * or an explicit flush drains it on the spot. Reads see queued data.
+ */
+
+#include "pico/stdlib.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "mimic.h"
+#include "mimic_blockdev.h"
+#include "mimic_fat32.h"
+#include "mimic_perf.h"
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+typedef struct {
+    uint32_t    lba[MIMIC_IOSCHED_SLOTS];
+    uint8_t     (*data)[MIMIC_BDEV_SECTOR];     // MIMIC_IOSCHED_SLOTS sectors
+    uint32_t    count;
+    uint32_t    head;               // Where the last drain stopped
+    uint64_t    first_us;           // Oldest queued write
+    MimicBlockDev* lower;
+    int         task_id;
+} IoSched;
+
+static IoSched sched = { .task_id = -1 };
+
+static int queue_find(uint32_t lba) {
+    for (uint32_t i = 0; i < sched.count; i++) {
+        if (sched.lba[i] == lba) return (int)i;
+    }
+    return -1;
+}
+
+// ============================================================================
+// DRAIN
+// ============================================================================
+
+static void slot_swap(uint32_t a, uint32_t b) {
+    uint8_t tmp[MIMIC_BDEV_SECTOR];
+    uint32_t lba = sched.lba[a];
+    sched.lba[a] = sched.lba[b];
+    sched.lba[b] = lba;
+    memcpy(tmp, sched.data[a], MIMIC_BDEV_SECTOR);
+    memcpy(sched.data[a], sched.data[b], MIMIC_BDEV_SECTOR);
+    memcpy(sched.data[b], tmp, MIMIC_BDEV_SECTOR);
+}
+
+// Selection sort: at most count - 1 sector swaps
+static void queue_sort(void) {
+    for (uint32_t i = 0; i + 1 < sched.count; i++) {
+        uint32_t min = i;
+        for (uint32_t j = i + 1; j < sched.count; j++) {
+            if (sched.lba[j] < sched.lba[min]) min = j;
+        }
+        if (min != i) slot_swap(i, min);
+    }
+}
+
+// Write slots [from, to) as runs of consecutive LBAs
+static int queue_write_range(uint32_t from, uint32_t to) {
+    while (from < to) {
+        uint32_t run = 1;
+        while (from + run < to && sched.lba[from + run] == sched.lba[from] + run) run++;
+        
+        int err = sched.lower->ops->write(sched.lower, sched.lba[from], sched.data[from], run);
+        if (err != MIMIC_OK) return err;
+        
+        if (run > 1) mimic_perf_add(MIMIC_PERF_IOSCHED_MERGED, run);
+        sched.head = sched.lba[from] + run;
+        from += run;
+    }
+    return MIMIC_OK;
+}
+
+static int queue_drain(void) {
+    if (sched.count == 0) return MIMIC_OK;
+    
+    queue_sort();
+    
+    // C-SCAN: from the head upward, then wrap to the lowest LBA
+    uint32_t start = 0;
+    while (start < sched.count && sched.lba[start] < sched.head) start++;
+    
+    uint32_t head = sched.head;
+    int err = queue_write_range(start, sched.count);
+    if (err == MIMIC_OK) err = queue_write_range(0, start);
+    
+    if (err != MIMIC_OK) {
+        // Keep everything queued; the next drain retries
+        sched.head = head;
+        return err;
+    }
+    
+    mimic_perf_inc(MIMIC_PERF_IOSCHED_DRAINS);
+    sched.count = 0;
+    return MIMIC_OK;
+}
+
+static int iosched_thread(void* arg) {
+    (void)arg;
+    
+    if (sched.count == 0) {
+        sched.task_id = -1;
+        return MIMIC_OK;
+    }
+    
+    uint64_t due = sched.first_us + MIMIC_IOSCHED_DELAY_MS * 1000ull;
+    uint64_t now = time_us_64();
+    if (now < due) {
+        mimic_kthread_sleep((uint32_t)((due - now) / 1000) + 1);
+        return MIMIC_ERR_BUSY;
+    }
+    
+    // The other core is in the FS; come back rather than stall core 0
+    if (!mimic_fs_try_lock()) {
+        mimic_kthread_sleep(1);
+        return MIMIC_ERR_BUSY;
+    }
+    
+    int err = queue_drain();
+    mimic_fs_unlock();
+    
+    if (err != MIMIC_OK) {
+        printf("[IOSCHED] Write-back failed (%d), retrying\n", err);
+        mimic_kthread_sleep(MIMIC_IOSCHED_DELAY_MS);
+    }
+    return MIMIC_ERR_BUSY;
+}
+
+// ============================================================================
+// DEVICE OPERATIONS
+// ============================================================================
+
+static int iosched_init(MimicBlockDev* dev) {
+    return mimic_bdev_init(sched.lower);
+}
+
+static int iosched_read(MimicBlockDev* dev, uint32_t sector, uint8_t* buf, uint32_t count) {
+    int err = sched.lower->ops->read(sched.lower, sector, buf, count);
+    if (err != MIMIC_OK) return err;
+    
+    // Queued writes are newer than the device
+    for (uint32_t i = 0; i < sched.count; i++) {
+        uint32_t off = sched.lba[i] - sector;
+        if (off < count) memcpy(buf + off * MIMIC_BDEV_SECTOR, sched.data[i], MIMIC_BDEV_SECTOR);
+    }
+    return MIMIC_OK;
+}
+
+// Forget queued writes to [sector, sector + count)
+static void queue_drop(uint32_t sector, uint32_t count) {
+    for (uint32_t i = 0; i < sched.count; ) {
+        if (sched.lba[i] - sector < count) {
+            sched.count--;
+            sched.lba[i] = sched.lba[sched.count];
+            memcpy(sched.data[i], sched.data[sched.count], MIMIC_BDEV_SECTOR);
+        } else {
+            i++;
+        }
+    }
+}
+
+static int iosched_write(MimicBlockDev* dev, uint32_t sector, const uint8_t* buf, uint32_t count) {
+    // A batch as big as the queue gains nothing from it; drop any queued
+    // copies it overwrites and send it straight down
+    if (count >= MIMIC_IOSCHED_SLOTS) {
+        queue_drop(sector, count);
+        return sched.lower->ops->write(sched.lower, sector, buf, count);
+    }
+    
+    for (uint32_t i = 0; i < count; i++, buf += MIMIC_BDEV_SECTOR) {
+        int slot = queue_find(sector + i);
+        if (slot < 0) {
+            if (sched.count == MIMIC_IOSCHED_SLOTS) {
+                int err = queue_drain();
+                if (err != MIMIC_OK) return err;
+            }
+            if (sched.count == 0) sched.first_us = time_us_64();
+            slot = (int)sched.count++;
+            sched.lba[slot] = sector + i;
+            mimic_perf_inc(MIMIC_PERF_IOSCHED_QUEUED);
+        }
+        memcpy(sched.data[slot], buf, MIMIC_BDEV_SECTOR);
+    }
+    
+    if (sched.task_id < 0 && sched.count > 0) {
+        sched.task_id = mimic_kthread_spawn("iosched", MIMIC_PRIO_BACKGROUND, iosched_thread, NULL);
+        
+        // No thread to drain later, so don't hold the data
+        if (sched.task_id < 0) return queue_drain();
+    }
+    return MIMIC_OK;
+}
+
+static int iosched_flush(MimicBlockDev* dev) {
+    int err = queue_drain();
+    if (err != MIMIC_OK) return err;
+    return mimic_bdev_flush(sched.lower);
+}
+
+// Queued data for a discarded range would only land on erased blocks
+static int iosched_discard(MimicBlockDev* dev, uint32_t sector, uint32_t count) {
+    queue_drop(sector, count);
+    return mimic_bdev_discard(sched.lower, sector, count);
+}
+
+static const MimicBlockOps iosched_ops = {
+    .init    = iosched_init,
+    .read    = iosched_read,
+    .write   = iosched_write,
+    .flush   = iosched_flush,
+    .discard = iosched_discard,
+};
+
+static MimicBlockDev iosched_dev = {
+    .ops = &iosched_ops,
+};
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+MimicBlockDev* mimic_iosched_attach(MimicBlockDev* lower) {
+    if (!sched.data) {
+        sched.data = mimic_kmalloc(MIMIC_IOSCHED_SLOTS * MIMIC_BDEV_SECTOR);
+        if (!sched.data) return lower;
+    }
+    
+    // Unmounting already flushed; this only catches a bare re-attach
+    if (sched.lower) queue_drain();
+    
+    sched.lower = lower;
+    sched.count = 0;
+    sched.head = 0;
+    iosched_dev.name = lower->name;
+    iosched_dev.sector_count = lower->sector_count;
+    return &iosched_dev;
+}
+
+uint32_t mimic_iosched_pending(void) {
+    return sched.count;
+}
@@ -0,0 +1,301 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC Data Logger - Append-only files fed from a RAM ring                ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  Ring buffers, extent preallocation and the "logger" drain thread         ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * Each log tracks two file offsets: written (end of the data accepted into
+ * the ring) and durable (whole sectors below it are on the device). The
+ * ring holds [durable, written); durable only moves by whole sectors, so
+ * a partial last sector stays in RAM and is rewritten whole once it fills.
+ * Writers only advance written and the drain only advances durable, so
+ * a write needs no lock and never waits for the card.
+ * 
+ * Sector addresses come from mimic_fat32_extent(); the data bypasses the
+ * FAT32 sector cache entirely.
+ */
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "mimic.h"
+#include "mimic_fat32.h"
+#include "mimic_log.h"
+#include "mimic_perf.h"
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+#define LOG_SECTOR          SD_SECTOR_SIZE
+#define LOG_MASK            (MIMIC_LOG_RING - 1)
+
+typedef struct {
+    bool                used;
+    int                 fat_fd;
+    uint8_t*            ring;
+    volatile uint32_t   written;
+    volatile uint32_t   durable;
+    uint32_t            allocated;      // Bytes the cluster chain covers
+    uint32_t            recorded;       // Size in the directory entry
+    uint64_t            checkpoint_us;
+    int                 err;            // Last drain error, reported once
+} MimicLog;
+
+static MimicLog logs[MIMIC_LOG_MAX];
+static int log_task = -1;
+
+static MimicLog* log_get(int fd) {
+    if (!mimic_log_fd(fd)) return NULL;
+    MimicLog* l = &logs[fd - MIMIC_LOG_FD_BASE];
+    return l->used ? l : NULL;
+}
+
+// ============================================================================
+// DRAIN (FS lock held)
+// ============================================================================
+
+// Keep half an extent allocated past need, growing a whole extent at a
+// time. A full volume only fails once the data actually reaches the end.
+static int log_reserve(MimicLog* l, uint32_t need) {
+    if (l->allocated >= need + MIMIC_LOG_EXTENT / 2) return MIMIC_OK;
+    
+    int n = mimic_fat32_extend(l->fat_fd, need + MIMIC_LOG_EXTENT);
+    if (n >= 0) l->allocated = (uint32_t)n;
+    if (l->allocated >= need) return MIMIC_OK;
+    return n < 0 ? n : MIMIC_ERR_NOMEM;
+}
+
+static int log_write_sectors(MimicLog* l, const uint8_t* data, uint32_t count) {
+    while (count > 0) {
+        uint32_t sector, run;
+        int err = mimic_fat32_extent(l->fat_fd, l->durable, count, &sector, &run);
+        if (err != MIMIC_OK) return err;
+        
+        err = mimic_fat32_write_raw(sector, data, run);
+        if (err != MIMIC_OK) return err;
+        
+        mimic_perf_add(MIMIC_PERF_LOG_SECTORS, run);
+        __dmb();
+        l->durable += run * LOG_SECTOR;
+        data += run * LOG_SECTOR;
+        count -= run;
+    }
+    return MIMIC_OK;
+}
+
+// Snapshot of how far the writer has got; the ring up to it is filled in
+static uint32_t log_end(const MimicLog* l) {
+    uint32_t end = l->written;
+    __dmb();
+    return end;
+}
+
+// Write out every whole sector in the ring up to end and, with tail set,
+// the partial one after them (zero padded). Writers may move on meanwhile,
+// so callers checkpoint the end they passed, never a fresh l->written.
+static int log_drain(MimicLog* l, uint32_t end, bool tail) {
+    int err = log_reserve(l, (end + LOG_SECTOR - 1) & ~(LOG_SECTOR - 1));
+    if (err != MIMIC_OK) return err;
+    
+    // One call per stretch up to the end of the ring; whole sectors never wrap
+    while ((end & ~(LOG_SECTOR - 1)) > l->durable) {
+        uint32_t idx = l->durable & LOG_MASK;
+        uint32_t bytes = (end & ~(LOG_SECTOR - 1)) - l->durable;
+        if (bytes > MIMIC_LOG_RING - idx) bytes = MIMIC_LOG_RING - idx;
+        
+        err = log_write_sectors(l, l->ring + idx, bytes / LOG_SECTOR);
+        if (err != MIMIC_OK) return err;
+    }
+    
+    if (tail && end > l->durable) {
+        uint8_t last[LOG_SECTOR];
+        uint32_t n = end - l->durable;
+        memcpy(last, l->ring + (l->durable & LOG_MASK), n);
+        memset(last + n, 0, LOG_SECTOR - n);
+        
+        // Written without moving durable: the sector is still open
+        uint32_t sector, run;
+        err = mimic_fat32_extent(l->fat_fd, l->durable, 1, &sector, &run);
+        if (err == MIMIC_OK) err = mimic_fat32_write_raw(sector, last, 1);
+        if (err != MIMIC_OK) return err;
+    }
+    return MIMIC_OK;
+}
+
+static int log_checkpoint(MimicLog* l, uint32_t size) {
+    int err = mimic_fat32_set_size(l->fat_fd, size);
+    if (err != MIMIC_OK) return err;
+    
+    l->recorded = size;
+    l->checkpoint_us = time_us_64();
+    return MIMIC_OK;
+}
+
+static int log_thread(void* arg) {
+    (void)arg;
+    
+    // Whoever holds the FS is doing I/O of its own; try again shortly
+    if (!mimic_fs_try_lock()) {
+        mimic_kthread_sleep(1);
+        return MIMIC_ERR_BUSY;
+    }
+    
+    bool any = false;
+    for (int i = 0; i < MIMIC_LOG_MAX; i++) {
+        MimicLog* l = &logs[i];
+        if (!l->used) continue;
+        any = true;
+        
+        int err = log_drain(l, log_end(l), false);
+        if (err == MIMIC_OK && l->durable > l->recorded &&
+            time_us_64() - l->checkpoint_us >= MIMIC_LOG_CHECKPOINT_MS * 1000ull) {
+            err = log_checkpoint(l, l->durable);
+        }
+        
+        if (err != MIMIC_OK && err != l->err) {
+            printf("[LOG] Write-out failed (%d), data is held in RAM\n", err);
+        }
+        l->err = err;
+    }
+    
+    if (!any) log_task = -1;
+    mimic_fs_unlock();
+    
+    if (!any) return MIMIC_OK;
+    mimic_kthread_sleep(MIMIC_LOG_PERIOD_MS);
+    return MIMIC_ERR_BUSY;
+}
+
+// ============================================================================
+// API
+// ============================================================================
+
+int mimic_log_open(const char* path, uint8_t mode) {
+    // The drain raw-writes from offset 0; on a directory that is its entries
+    if (mimic_is_dir(path)) return MIMIC_ERR_INVAL;
+    
+    uint8_t* ring = mimic_kmalloc(MIMIC_LOG_RING);
+    if (!ring) return MIMIC_ERR_NOMEM;
+    
+    int fat_fd = mimic_fat32_fopen(path, MIMIC_FILE_READ | MIMIC_FILE_WRITE | MIMIC_FILE_CREATE |
+                                         (mode & MIMIC_FILE_TRUNC));
+    if (fat_fd < 0) {
+        mimic_kfree(ring);
+        return fat_fd;
+    }
+    
+    // Appending: the partial last sector comes back into the ring
+    uint32_t size = (uint32_t)mimic_fsize(fat_fd);
+    uint32_t durable = size & ~(LOG_SECTOR - 1);
+    if (size > durable) {
+        if (mimic_fseek(fat_fd, durable, MIMIC_SEEK_SET) != MIMIC_OK ||
+            mimic_fread(fat_fd, ring + (durable & LOG_MASK), size - durable) != (int)(size - durable)) {
+            mimic_fclose(fat_fd);
+            mimic_kfree(ring);
+            return MIMIC_ERR_IO;
+        }
+    }
+    
+    mimic_fs_lock();
+    
+    int slot = -1;
+    for (int i = 0; i < MIMIC_LOG_MAX; i++) {
+        if (!logs[i].used) {
+            slot = i;
+            break;
+        }
+    }
+    
+    int err = slot < 0 ? MIMIC_ERR_NOMEM : MIMIC_OK;
+    if (err == MIMIC_OK) {
+        MimicLog* l = &logs[slot];
+        memset(l, 0, sizeof(MimicLog));
+        l->fat_fd = fat_fd;
+        l->ring = ring;
+        l->written = size;
+        l->durable = durable;
+        l->recorded = size;
+        l->checkpoint_us = time_us_64();
+        
+        err = log_reserve(l, size);
+    }
+    
+    // User priority: the drain has to keep pace with the tasks logging
+    if (err == MIMIC_OK && log_task < 0) {
+        log_task = mimic_kthread_spawn("logger", MIMIC_PRIO_USER, log_thread, NULL);
+        if (log_task < 0) err = log_task;
+    }
+    
+    if (err == MIMIC_OK) logs[slot].used = true;
+    mimic_fs_unlock();
+    
+    if (err != MIMIC_OK) {
+        mimic_fclose(fat_fd);
+        mimic_kfree(ring);
+        return err;
+    }
+    return MIMIC_LOG_FD_BASE + slot;
+}
+
+int mimic_log_write(int fd, const void* buf, size_t size) {
+    MimicLog* l = log_get(fd);
+    if (!l) return MIMIC_ERR_INVAL;
+    
+    const uint8_t* in = (const uint8_t*)buf;
+    uint32_t end = l->written;
+    uint32_t room = MIMIC_LOG_RING - (end - l->durable);
+    uint32_t n = size < room ? (uint32_t)size : room;
+    
+    uint32_t idx = end & LOG_MASK;
+    uint32_t first = n < MIMIC_LOG_RING - idx ? n : MIMIC_LOG_RING - idx;
+    memcpy(l->ring + idx, in, first);
+    memcpy(l->ring, in + first, n - first);
+    
+    __dmb();
+    l->written = end + n;
+    
+    if (n < size) mimic_perf_add(MIMIC_PERF_LOG_DROPPED, (uint32_t)(size - n));
+    return (int)n;
+}
+
+int mimic_log_sync(int fd) {
+    MimicLog* l = log_get(fd);
+    if (!l) return MIMIC_ERR_INVAL;
+    
+    mimic_fs_lock();
+    uint32_t end = log_end(l);
+    int err = log_drain(l, end, true);
+    if (err == MIMIC_OK) err = log_checkpoint(l, end);
+    mimic_fs_unlock();
+    return err;
+}
+
+int mimic_log_close(int fd) {
+    MimicLog* l = log_get(fd);
+    if (!l) return MIMIC_ERR_INVAL;
+    
+    mimic_fs_lock();
+    uint32_t end = log_end(l);
+    int err = log_drain(l, end, true);
+    if (err == MIMIC_OK) err = log_checkpoint(l, end);
+    
+    // The unused preallocation goes back (and on to the background erase)
+    if (err == MIMIC_OK) err = mimic_fat32_trim(l->fat_fd);
+    
+    mimic_fclose(l->fat_fd);
+    mimic_kfree(l->ring);
+    l->ring = NULL;
+    l->used = false;
+    mimic_fs_unlock();
+    return err;
+}
+
+int32_t mimic_log_size(int fd) {
+    MimicLog* l = log_get(fd);
+    return l ? (int32_t)l->written : MIMIC_ERR_INVAL;
+}
@@ -0,0 +1,381 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC tmpfs - RAM filesystem for compiler temporaries                    ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  Pooled kernel-heap blocks, spilled to SD under memory pressure           ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * A file is a singly linked chain of blocks. Handles keep only a byte
+ * position and walk the chain on each call: files are a few KB, and not
+ * caching block pointers means truncating or spilling a file can never
+ * leave another handle pointing at freed memory.
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include "mimic.h"
+#include "mimic_fat32.h"
+#include "mimic_tmpfs.h"
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+#define TMPFS_MAX_BLOCKS    (MIMIC_TMPFS_BUDGET / MIMIC_TMPFS_BLOCK)
+
+typedef struct TmpBlock {
+    struct TmpBlock*    next;
+    uint8_t             data[MIMIC_TMPFS_BLOCK];
+} TmpBlock;
+
+typedef struct {
+    bool        used;
+    uint8_t     opens;
+    char        name[MIMIC_TMPFS_NAME];
+    uint32_t    size;
+    TmpBlock*   head;
+} TmpNode;
+
+typedef struct {
+    bool        open;
+    uint8_t     mode;
+    TmpNode*    node;               // NULL once spilled
+    uint32_t    pos;
+    int         fat_fd;             // Spilled: the FAT32 handle, else -1
+} TmpHandle;
+
+static TmpNode nodes[MIMIC_TMPFS_MAX_FILES];
+static TmpHandle handles[MIMIC_TMPFS_MAX_OPEN];
+
+static TmpBlock* pool;
+static uint32_t pool_count;
+static uint32_t blocks_live;        // Linked into files
+static uint32_t spill_count;
+
+// ============================================================================
+// BLOCKS
+// ============================================================================
+
+static void tmpfs_free_chain(TmpNode* n) {
+    TmpBlock* b = n->head;
+    while (b) {
+        TmpBlock* next = b->next;
+        if (pool_count < MIMIC_TMPFS_POOL_KEEP) {
+            b->next = pool;
+            pool = b;
+            pool_count++;
+        } else {
+            mimic_kfree(b);
+        }
+        blocks_live--;
+        b = next;
+    }
+    n->head = NULL;
+    n->size = 0;
+}
+
+static int tmpfs_spill(TmpNode* n);
+
+// Largest file with no open handle, the cheapest one to move to SD
+static TmpNode* tmpfs_victim(void) {
+    TmpNode* best = NULL;
+    for (int i = 0; i < MIMIC_TMPFS_MAX_FILES; i++) {
+        TmpNode* n = &nodes[i];
+        if (!n->used || n->opens || !n->head) continue;
+        if (!best || n->size > best->size) best = n;
+    }
+    return best;
+}
+
+static TmpBlock* tmpfs_alloc_block(void) {
+    TmpBlock* b = NULL;
+    
+    while (!b) {
+        if (pool) {
+            b = pool;
+            pool = b->next;
+            pool_count--;
+        } else if (blocks_live < TMPFS_MAX_BLOCKS) {
+            b = mimic_kmalloc(sizeof(TmpBlock));
+        }
+        if (b) break;
+        
+        // Out of budget or heap: make room by moving a closed file out
+        TmpNode* victim = tmpfs_victim();
+        if (!victim) return NULL;
+        
+        int fd = tmpfs_spill(victim);
+        if (fd < 0) return NULL;
+        mimic_fclose(fd);
+        memset(victim, 0, sizeof(TmpNode));
+    }
+    
+    b->next = NULL;
+    blocks_live++;
+    return b;
+}
+
+// Block holding byte pos; with grow, a block starting exactly at the end
+// of the file is appended
+static TmpBlock* tmpfs_block_at(TmpNode* n, uint32_t pos, bool grow) {
+    TmpBlock** link = &n->head;
+    for (uint32_t i = pos / MIMIC_TMPFS_BLOCK; ; i--) {
+        if (!*link) {
+            if (!grow) return NULL;
+            *link = tmpfs_alloc_block();
+            if (!*link) return NULL;
+        }
+        if (i == 0) return *link;
+        link = &(*link)->next;
+    }
+}
+
+// ============================================================================
+// SPILLING
+// ============================================================================
+
+// Copy a file to the same path on SD and release its blocks. Returns the
+// open FAT32 handle, positioned at the end.
+static int tmpfs_spill(TmpNode* n) {
+    char path[MIMIC_MAX_PATH];
+    snprintf(path, sizeof(path), "%s/%s", MIMIC_TMPFS_ROOT, n->name);
+    
+    int fd = mimic_fat32_fopen(path, MIMIC_FILE_READ | MIMIC_FILE_WRITE |
+                                     MIMIC_FILE_CREATE | MIMIC_FILE_TRUNC);
+    if (fd < 0) return fd;
+    
+    uint32_t left = n->size;
+    for (TmpBlock* b = n->head; b && left; b = b->next) {
+        uint32_t len = left < MIMIC_TMPFS_BLOCK ? left : MIMIC_TMPFS_BLOCK;
+        if (mimic_fwrite(fd, b->data, len) != (int)len) {
+            mimic_fclose(fd);
+            return MIMIC_ERR_IO;
+        }
+        left -= len;
+    }
+    
+    printf("[TMPFS] Spilled %s (%lu bytes) to SD\n", n->name, (unsigned long)n->size);
+    tmpfs_free_chain(n);
+    spill_count++;
+    return fd;
+}
+
+// ============================================================================
+// LOOKUP
+// ============================================================================
+
+static const char* tmpfs_name(const char* path) {
+    size_t root = strlen(MIMIC_TMPFS_ROOT);
+    if (strncmp(path, MIMIC_TMPFS_ROOT, root) != 0 || path[root] != '/') return NULL;
+    
+    const char* name = path + root + 1;
+    if (!*name || strchr(name, '/') || strlen(name) >= MIMIC_TMPFS_NAME) return NULL;
+    return name;
+}
+
+bool mimic_tmpfs_owns(const char* path) {
+    return tmpfs_name(path) != NULL;
+}
+
+static TmpNode* tmpfs_find(const char* name) {
+    for (int i = 0; i < MIMIC_TMPFS_MAX_FILES; i++) {
+        if (nodes[i].used && strcmp(nodes[i].name, name) == 0) return &nodes[i];
+    }
+    return NULL;
+}
+
+static TmpHandle* tmpfs_handle(int fd) {
+    if (!mimic_tmpfs_fd(fd)) return NULL;
+    TmpHandle* h = &handles[fd - MIMIC_TMPFS_FD_BASE];
+    return h->open ? h : NULL;
+}
+
+bool mimic_tmpfs_exists(const char* path) {
+    const char* name = tmpfs_name(path);
+    return name && tmpfs_find(name);
+}
+
+// ============================================================================
+// FILE OPERATIONS
+// ============================================================================
+
+int mimic_tmpfs_open(const char* path, uint8_t mode) {
+    const char* name = tmpfs_name(path);
+    if (!name) return MIMIC_ERR_INVAL;
+    
+    TmpNode* n = tmpfs_find(name);
+    if (!n && !(mode & MIMIC_FILE_CREATE)) return MIMIC_ERR_NOENT;
+    
+    // A spilled file lives on SD now; only a truncating open replaces it
+    if (!n && !(mode & MIMIC_FILE_TRUNC) && mimic_exists(path)) return MIMIC_ERR_NOENT;
+    
+    int slot = -1;
+    for (int i = 0; i < MIMIC_TMPFS_MAX_OPEN; i++) {
+        if (!handles[i].open) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) return MIMIC_ERR_NOMEM;
+    
+    if (!n) {
+        for (int i = 0; i < MIMIC_TMPFS_MAX_FILES && !n; i++) {
+            if (!nodes[i].used) n = &nodes[i];
+        }
+        // Table full: let FAT32 hold this one
+        if (!n) return MIMIC_ERR_NOENT;
+        
+        memset(n, 0, sizeof(TmpNode));
+        n->used = true;
+        strcpy(n->name, name);
+    }
+    
+    if ((mode & MIMIC_FILE_TRUNC) && (mode & MIMIC_FILE_WRITE)) {
+        tmpfs_free_chain(n);
+    }
+    
+    TmpHandle* h = &handles[slot];
+    h->open = true;
+    h->mode = mode;
+    h->node = n;
+    h->pos = (mode & MIMIC_FILE_APPEND) ? n->size : 0;
+    h->fat_fd = -1;
+    n->opens++;
+    return MIMIC_TMPFS_FD_BASE + slot;
+}
+
+int mimic_tmpfs_close(int fd) {
+    TmpHandle* h = tmpfs_handle(fd);
+    if (!h) return MIMIC_ERR_INVAL;
+    
+    int err = MIMIC_OK;
+    if (h->fat_fd >= 0) {
+        err = mimic_fclose(h->fat_fd);
+    } else {
+        h->node->opens--;
+    }
+    h->open = false;
+    return err;
+}
+
+int mimic_tmpfs_read(int fd, void* buf, size_t size) {
+    TmpHandle* h = tmpfs_handle(fd);
+    if (!h) return MIMIC_ERR_INVAL;
+    if (!(h->mode & MIMIC_FILE_READ)) return MIMIC_ERR_PERM;
+    if (h->fat_fd >= 0) return mimic_fread(h->fat_fd, buf, size);
+    
+    TmpNode* n = h->node;
+    uint8_t* out = (uint8_t*)buf;
+    size_t done = 0;
+    
+    while (done < size && h->pos < n->size) {
+        TmpBlock* b = tmpfs_block_at(n, h->pos, false);
+        if (!b) break;
+        
+        uint32_t off = h->pos % MIMIC_TMPFS_BLOCK;
+        uint32_t len = MIMIC_TMPFS_BLOCK - off;
+        if (len > n->size - h->pos) len = n->size - h->pos;
+        if (len > size - done) len = size - done;
+        
+        memcpy(out + done, b->data + off, len);
+        done += len;
+        h->pos += len;
+    }
+    
+    return (int)done;
+}
+
+int mimic_tmpfs_write(int fd, const void* buf, size_t size) {
+    TmpHandle* h = tmpfs_handle(fd);
+    if (!h) return MIMIC_ERR_INVAL;
+    if (!(h->mode & MIMIC_FILE_WRITE)) return MIMIC_ERR_PERM;
+    if (h->fat_fd >= 0) return mimic_fwrite(h->fat_fd, buf, size);
+    
+    TmpNode* n = h->node;
+    const uint8_t* in = (const uint8_t*)buf;
+    size_t done = 0;
+    
+    // Another handle may have truncated the file under us
+    if (h->pos > n->size) h->pos = n->size;
+    
+    while (done < size) {
+        TmpBlock* b = tmpfs_block_at(n, h->pos, true);
+        if (!b) break;
+        
+        uint32_t off = h->pos % MIMIC_TMPFS_BLOCK;
+        uint32_t len = MIMIC_TMPFS_BLOCK - off;
+        if (len > size - done) len = size - done;
+        
+        memcpy(b->data + off, in + done, len);
+        done += len;
+        h->pos += len;
+        if (h->pos > n->size) n->size = h->pos;
+    }
+    
+    if (done == size) return (int)done;
+    
+    // Nothing else could be moved out, so this file goes to SD itself.
+    // Only when this is its sole handle; others would lose their data.
+    if (n->opens != 1) return done > 0 ? (int)done : MIMIC_ERR_NOMEM;
+    
+    int fat_fd = tmpfs_spill(n);
+    if (fat_fd < 0) return done > 0 ? (int)done : MIMIC_ERR_NOMEM;
+    
+    mimic_fseek(fat_fd, h->pos, MIMIC_SEEK_SET);
+    memset(n, 0, sizeof(TmpNode));
+    h->node = NULL;
+    h->fat_fd = fat_fd;
+    
+    int more = mimic_fwrite(fat_fd, in + done, size - done);
+    if (more > 0) done += more;
+    return done > 0 ? (int)done : more;
+}
+
+int mimic_tmpfs_seek(int fd, int32_t offset, int whence) {
+    TmpHandle* h = tmpfs_handle(fd);
+    if (!h) return MIMIC_ERR_INVAL;
+    if (h->fat_fd >= 0) return mimic_fseek(h->fat_fd, offset, whence);
+    
+    int32_t new_pos;
+    switch (whence) {
+        case MIMIC_SEEK_SET: new_pos = offset; break;
+        case MIMIC_SEEK_CUR: new_pos = h->pos + offset; break;
+        case MIMIC_SEEK_END: new_pos = h->node->size + offset; break;
+        default: return MIMIC_ERR_INVAL;
+    }
+    
+    if (new_pos < 0 || (uint32_t)new_pos > h->node->size) return MIMIC_ERR_INVAL;
+    h->pos = new_pos;
+    return MIMIC_OK;
+}
+
+int32_t mimic_tmpfs_tell(int fd) {
+    TmpHandle* h = tmpfs_handle(fd);
+    if (!h) return MIMIC_ERR_INVAL;
+    if (h->fat_fd >= 0) return mimic_ftell(h->fat_fd);
+    return h->pos;
+}
+
+int32_t mimic_tmpfs_size(int fd) {
+    TmpHandle* h = tmpfs_handle(fd);
+    if (!h) return MIMIC_ERR_INVAL;
+    if (h->fat_fd >= 0) return mimic_fsize(h->fat_fd);
+    return h->node->size;
+}
+
+// ============================================================================
+// STATUS
+// ============================================================================
+
+void mimic_tmpfs_info(MimicTmpfsInfo* info) {
+    memset(info, 0, sizeof(MimicTmpfsInfo));
+    for (int i = 0; i < MIMIC_TMPFS_MAX_FILES; i++) {
+        if (!nodes[i].used) continue;
+        info->files++;
+        info->bytes += nodes[i].size;
+    }
+    info->blocks = blocks_live;
+    info->pooled = pool_count;
+    info->spills = spill_count;
+}
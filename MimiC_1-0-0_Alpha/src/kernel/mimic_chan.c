@@ -0,0 +1,189 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC Channels - Shared-memory SPSC rings between tasks                  ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  The kernel sets rings up and parks/wakes endpoints; data never copies    ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * A channel is named so two independently loaded programs can meet: the
+ * first task to open a name creates the ring, the second attaches to it in
+ * the other role. The ring lives in the user heap under the kernel's id, so
+ * it outlives either endpoint and is freed when both have closed.
+ * 
+ * Producer:                          Consumer:
+ *     copy into data[head & mask]        n = CHAN_WAIT(id, timeout)
+ *     head += n                          copy from data[tail & mask]
+ *     if (waiting[CONSUMER]) NOTIFY      tail += n
+ *                                        if (waiting[PRODUCER]) NOTIFY
+ */
+
+#include "pico/stdlib.h"
+#include "pico/mutex.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "mimic.h"
+
+// ============================================================================
+// CHANNEL TABLE
+// ============================================================================
+
+typedef struct {
+    bool            used;
+    char            name[16];
+    uint8_t         task[2];        // Endpoint task ids by role, 0 = none
+    MimicChanRing*  ring;
+} MimicChannel;
+
+static MimicChannel channels[MIMIC_MAX_CHANNELS];
+auto_init_mutex(chan_lock);
+
+static MimicChannel* chan_get(uint32_t task_id, int id, int* role) {
+    if (id < 0 || id >= MIMIC_MAX_CHANNELS || !channels[id].used) return NULL;
+    
+    MimicChannel* ch = &channels[id];
+    if (ch->task[MIMIC_CHAN_PRODUCER] == task_id) *role = MIMIC_CHAN_PRODUCER;
+    else if (ch->task[MIMIC_CHAN_CONSUMER] == task_id) *role = MIMIC_CHAN_CONSUMER;
+    else return NULL;
+    return ch;
+}
+
+// Bytes the given role can move right now without waiting
+static uint32_t chan_ready(const MimicChanRing* ring, int role) {
+    uint32_t used = ring->head - ring->tail;
+    return role == MIMIC_CHAN_CONSUMER ? used : ring->size - used;
+}
+
+static void chan_detach(MimicChannel* ch, int role) {
+    ch->task[role] = 0;
+    if (ch->task[MIMIC_CHAN_PRODUCER] || ch->task[MIMIC_CHAN_CONSUMER]) return;
+    
+    mimic_ufree(0, ch->ring);
+    memset(ch, 0, sizeof(MimicChannel));
+}
+
+// ============================================================================
+// API
+// ============================================================================
+
+int mimic_chan_open(uint32_t task_id, const char* name, uint32_t size, uint32_t role) {
+    if (!name || role > MIMIC_CHAN_CONSUMER || task_id == 0) return MIMIC_ERR_INVAL;
+    
+    mutex_enter_blocking(&chan_lock);
+    
+    int free_slot = -1;
+    for (int i = 0; i < MIMIC_MAX_CHANNELS; i++) {
+        MimicChannel* ch = &channels[i];
+        if (!ch->used) {
+            if (free_slot < 0) free_slot = i;
+            continue;
+        }
+        if (strncmp(ch->name, name, sizeof(ch->name) - 1) != 0) continue;
+        
+        // Attach to the existing ring in the other role
+        int err = ch->task[role] ? MIMIC_ERR_BUSY : i;
+        if (err >= 0) ch->task[role] = task_id;
+        mutex_exit(&chan_lock);
+        return err;
+    }
+    
+    if (free_slot < 0) {
+        mutex_exit(&chan_lock);
+        return MIMIC_ERR_NOMEM;
+    }
+    
+    // Round up to a power of two so indices are a mask away
+    if (size == 0 || size > MIMIC_CHAN_MAX_SIZE) {
+        mutex_exit(&chan_lock);
+        return MIMIC_ERR_INVAL;
+    }
+    uint32_t ring_size = 16;
+    while (ring_size < size) ring_size <<= 1;
+    
+    MimicChanRing* ring = mimic_umalloc(0, sizeof(MimicChanRing) + ring_size);
+    if (!ring) {
+        mutex_exit(&chan_lock);
+        return MIMIC_ERR_NOMEM;
+    }
+    memset(ring, 0, sizeof(MimicChanRing));
+    ring->size = ring_size;
+    
+    MimicChannel* ch = &channels[free_slot];
+    ch->used = true;
+    strncpy(ch->name, name, sizeof(ch->name) - 1);
+    ch->task[role] = task_id;
+    ch->ring = ring;
+    
+    mutex_exit(&chan_lock);
+    return free_slot;
+}
+
+MimicChanRing* mimic_chan_map(uint32_t task_id, int id) {
+    int role;
+    MimicChannel* ch = chan_get(task_id, id, &role);
+    return ch ? ch->ring : NULL;
+}
+
+int mimic_chan_wait(uint32_t task_id, int id, uint32_t timeout_ms) {
+    int role;
+    MimicChannel* ch = chan_get(task_id, id, &role);
+    if (!ch) return MIMIC_ERR_INVAL;
+    
+    MimicChanRing* ring = ch->ring;
+    uint32_t ready = chan_ready(ring, role);
+    if (ready > 0) return ready;
+    
+    // Publish the flag before re-checking, so a peer that advances the
+    // ring after our first look is guaranteed to see it and notify.
+    ring->waiting[role] = 1;
+    __dmb();
+    ready = chan_ready(ring, role);
+    if (ready == 0) {
+        mimic_task_block(timeout_ms);
+        ready = chan_ready(ring, role);
+    }
+    ring->waiting[role] = 0;
+    return ready;
+}
+
+int mimic_chan_notify(uint32_t task_id, int id) {
+    int role;
+    MimicChannel* ch = chan_get(task_id, id, &role);
+    if (!ch) return MIMIC_ERR_INVAL;
+    
+    int peer = role ^ 1;
+    if (ch->ring->waiting[peer] && ch->task[peer]) {
+        ch->ring->waiting[peer] = 0;
+        mimic_task_wake(ch->task[peer]);
+    }
+    return MIMIC_OK;
+}
+
+int mimic_chan_close(uint32_t task_id, int id) {
+    mutex_enter_blocking(&chan_lock);
+    
+    int role;
+    MimicChannel* ch = chan_get(task_id, id, &role);
+    if (!ch) {
+        mutex_exit(&chan_lock);
+        return MIMIC_ERR_INVAL;
+    }
+    
+    // Let a blocked peer see the hang-up instead of sleeping forever
+    int peer = role ^ 1;
+    if (ch->task[peer]) mimic_task_wake(ch->task[peer]);
+    
+    chan_detach(ch, role);
+    mutex_exit(&chan_lock);
+    return MIMIC_OK;
+}
+
+void mimic_chan_release_task(uint32_t task_id) {
+    if (task_id == 0) return;
+    
+    // A task may hold both ends of a loopback channel
+    for (int i = 0; i < MIMIC_MAX_CHANNELS; i++) {
+        while (mimic_chan_close(task_id, i) == MIMIC_OK);
+    }
+}
@@ -0,0 +1,615 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC I/O - Peripheral syscalls with asynchronous DMA                    ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  SPI/I2C move data by DMA straight to/from user buffers; ADC free-runs    ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * A transfer claims DMA channels, starts them and returns a handle; the
+ * calling task goes on until it wants the result (IO_WAIT). The DMA
+ * completion interrupt only marks the transfer done. mimic_io_poll(),
+ * called from the kernel loop, releases the channels and wakes the owner,
+ * so no task state is touched from interrupt context.
+ * 
+ * Completion is always signalled by the channel that finishes last: the
+ * RX side of SPI (the TX side drains long before the bus is idle) and the
+ * data side of I2C reads.
+ * 
+ * ADC streaming uses two channels and no interrupt-time reprogramming:
+ * 
+ *     data:  ADC FIFO -> ring, half a ring per run, chains to ctrl
+ *     ctrl:  halves[] -> data.write_addr (trigger), read side wraps
+ * 
+ * so the converter keeps filling the ring even if interrupts are masked
+ * for longer than a half period. The completion interrupt only counts
+ * halves for ADC_POS.
+ */
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "hardware/irq.h"
+#include "hardware/dma.h"
+#include "hardware/spi.h"
+#include "hardware/i2c.h"
+#include "hardware/adc.h"
+#include "hardware/pwm.h"
+#include "hardware/pio.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "mimic.h"
+#include "mimic_perf.h"
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+#define IO_DMA_IRQ          DMA_IRQ_1   // DMA_IRQ_0 is left to SDK libraries
+#define IO_NO_CHANNEL       0xFF
+
+typedef enum {
+    XFER_SPI,
+    XFER_I2C,
+    XFER_PIO,
+} MimicXferKind;
+
+typedef struct {
+    bool            used;
+    volatile bool   done;       // Set by the DMA interrupt
+    bool            finished;   // Channels released, result final
+    bool            waiting;
+    uint8_t         task;
+    uint8_t         kind;
+    uint8_t         port;
+    uint8_t         tx_ch;
+    uint8_t         rx_ch;
+    uint8_t         irq_ch;     // Channel whose completion ends the transfer
+    int32_t         result;
+    uint32_t*       cmds;       // I2C data_cmd words
+} MimicXfer;
+
+typedef struct {
+    bool            running;
+    bool            waiting;
+    uint8_t         task;
+    uint8_t         data_ch;
+    uint8_t         ctrl_ch;
+    uint32_t        half;       // Samples per DMA run
+    volatile uint32_t halves;   // Runs completed
+    uint32_t        notified;
+} MimicAdcStream;
+
+static MimicXfer xfers[MIMIC_IO_MAX_XFERS];
+static MimicAdcStream adc_stream;
+static bool adc_ready;
+static bool dma_hooked;
+
+// Write addresses the ctrl channel feeds back into the data channel.
+// Aligned for DMA read-address wrapping.
+static uint32_t adc_halves[2] __aligned(8);
+
+// SPI filler: clocked out on reads, sink for RX on writes
+static uint8_t spi_fill = 0xFF;
+static uint8_t spi_sink;
+
+static spi_inst_t* io_spi(uint32_t port) {
+    return port == 0 ? spi0 : port == 1 ? spi1 : NULL;
+}
+
+static i2c_inst_t* io_i2c(uint32_t port) {
+    return port == 0 ? i2c0 : port == 1 ? i2c1 : NULL;
+}
+
+// ============================================================================
+// INTERRUPT SIDE
+// ============================================================================
+
+static void adc_stream_service(void) {
+    if (adc_stream.running && dma_channel_get_irq1_status(adc_stream.data_ch)) {
+        dma_channel_acknowledge_irq1(adc_stream.data_ch);
+        adc_stream.halves++;
+    }
+}
+
+static void __not_in_flash_func(io_dma_isr)(void) {
+    for (int i = 0; i < MIMIC_IO_MAX_XFERS; i++) {
+        MimicXfer* x = &xfers[i];
+        if (x->used && !x->done && dma_channel_get_irq1_status(x->irq_ch)) {
+            dma_channel_acknowledge_irq1(x->irq_ch);
+            x->done = true;
+        }
+    }
+    adc_stream_service();
+}
+
+static void io_hook_dma(void) {
+    if (dma_hooked) return;
+    
+    // Shared: the SD driver or PIO programs may want this line too
+    irq_add_shared_handler(IO_DMA_IRQ, io_dma_isr,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(IO_DMA_IRQ, true);
+    dma_hooked = true;
+}
+
+// ============================================================================
+// TRANSFERS
+// ============================================================================
+
+static void xfer_release_channels(MimicXfer* x) {
+    uint8_t chans[2] = {x->tx_ch, x->rx_ch};
+    for (int i = 0; i < 2; i++) {
+        if (chans[i] == IO_NO_CHANNEL) continue;
+        dma_channel_set_irq1_enabled(chans[i], false);
+        dma_channel_abort(chans[i]);
+        dma_channel_acknowledge_irq1(chans[i]);
+        dma_channel_unclaim(chans[i]);
+    }
+    x->tx_ch = x->rx_ch = IO_NO_CHANNEL;
+    
+    if (x->cmds) {
+        mimic_kfree(x->cmds);
+        x->cmds = NULL;
+    }
+}
+
+static void xfer_free(MimicXfer* x) {
+    xfer_release_channels(x);
+    memset(x, 0, sizeof(MimicXfer));
+}
+
+// Reserve a slot and both channels; the port must be idle
+static MimicXfer* xfer_alloc(uint32_t task_id, uint8_t kind, uint8_t port) {
+    MimicXfer* slot = NULL;
+    for (int i = 0; i < MIMIC_IO_MAX_XFERS; i++) {
+        MimicXfer* x = &xfers[i];
+        if (x->used && !x->finished && x->kind == kind && x->port == port) return NULL;
+        if (!x->used && !slot) slot = x;
+    }
+    if (!slot) return NULL;
+    
+    int tx = dma_claim_unused_channel(false);
+    int rx = dma_claim_unused_channel(false);
+    if (tx < 0 || rx < 0) {
+        if (tx >= 0) dma_channel_unclaim(tx);
+        if (rx >= 0) dma_channel_unclaim(rx);
+        return NULL;
+    }
+    
+    memset(slot, 0, sizeof(MimicXfer));
+    slot->used = true;
+    slot->task = task_id;
+    slot->kind = kind;
+    slot->port = port;
+    slot->tx_ch = tx;
+    slot->rx_ch = rx;
+    return slot;
+}
+
+static void xfer_channel(uint32_t ch, uint32_t size, bool read_inc, bool write_inc,
+                         uint32_t dreq, volatile void* dst, const volatile void* src,
+                         uint32_t count) {
+    dma_channel_config c = dma_channel_get_default_config(ch);
+    channel_config_set_transfer_data_size(&c, size);
+    channel_config_set_read_increment(&c, read_inc);
+    channel_config_set_write_increment(&c, write_inc);
+    channel_config_set_dreq(&c, dreq);
+    dma_channel_configure(ch, &c, dst, src, count, false);
+}
+
+static int xfer_start(MimicXfer* x, uint32_t irq_ch, uint32_t len) {
+    io_hook_dma();
+    
+    x->irq_ch = irq_ch;
+    x->result = len;
+    dma_channel_acknowledge_irq1(irq_ch);
+    dma_channel_set_irq1_enabled(irq_ch, true);
+    
+    // Both sides in the same cycle, so RX is listening before TX clocks
+    uint32_t mask = 0;
+    if (x->tx_ch != IO_NO_CHANNEL) mask |= 1u << x->tx_ch;
+    if (x->rx_ch != IO_NO_CHANNEL) mask |= 1u << x->rx_ch;
+    dma_start_channel_mask(mask);
+    
+    mimic_perf_inc(MIMIC_PERF_IO_XFERS);
+    return x - xfers;
+}
+
+static int spi_xfer(uint32_t task_id, uint32_t port, const uint8_t* tx,
+                    uint8_t* rx, uint32_t len) {
+    spi_inst_t* spi = io_spi(port);
+    if (!spi || len == 0) return MIMIC_ERR_INVAL;
+    if (port == MIMIC_IO_SD_SPI) return MIMIC_ERR_PERM;
+    
+    MimicXfer* x = xfer_alloc(task_id, XFER_SPI, port);
+    if (!x) return MIMIC_ERR_BUSY;
+    
+    volatile void* dr = &spi_get_hw(spi)->dr;
+    xfer_channel(x->tx_ch, DMA_SIZE_8, tx != NULL, false, spi_get_dreq(spi, true),
+                 dr, tx ? tx : &spi_fill, len);
+    xfer_channel(x->rx_ch, DMA_SIZE_8, false, rx != NULL, spi_get_dreq(spi, false),
+                 rx ? rx : &spi_sink, dr, len);
+    return xfer_start(x, x->rx_ch, len);
+}
+
+static int i2c_xfer(uint32_t task_id, uint32_t port, uint32_t addr,
+                    const uint8_t* tx, uint8_t* rx, uint32_t len) {
+    i2c_inst_t* i2c = io_i2c(port);
+    if (!i2c || len == 0 || addr > 0x7F) return MIMIC_ERR_INVAL;
+    
+    MimicXfer* x = xfer_alloc(task_id, XFER_I2C, port);
+    if (!x) return MIMIC_ERR_BUSY;
+    
+    // The controller takes one command word per byte: data to send, or a
+    // read request. STOP goes on the last.
+    x->cmds = mimic_kmalloc(len * sizeof(uint32_t));
+    if (!x->cmds) {
+        xfer_free(x);
+        return MIMIC_ERR_NOMEM;
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        x->cmds[i] = tx ? tx[i] : I2C_IC_DATA_CMD_CMD_BITS;
+    }
+    x->cmds[len - 1] |= I2C_IC_DATA_CMD_STOP_BITS;
+    
+    i2c_hw_t* hw = i2c_get_hw(i2c);
+    hw->enable = 0;
+    hw->tar = addr;
+    hw->enable = 1;
+    
+    xfer_channel(x->tx_ch, DMA_SIZE_32, true, false, i2c_get_dreq(i2c, true),
+                 &hw->data_cmd, x->cmds, len);
+                 
+    if (!tx) {
+        xfer_channel(x->rx_ch, DMA_SIZE_8, false, true, i2c_get_dreq(i2c, false),
+                     rx, &hw->data_cmd, len);
+        return xfer_start(x, x->rx_ch, len);
+    }
+    
+    // Writes have no RX side
+    dma_channel_unclaim(x->rx_ch);
+    x->rx_ch = IO_NO_CHANNEL;
+    return xfer_start(x, x->tx_ch, len);
+}
+
+// Feed or drain a PIO state machine FIFO; the PIO syscalls check
+// ownership first. Each direction is its own port, so a state machine
+// can send and receive at the same time.
+int mimic_io_pio_xfer(uint32_t task_id, uint32_t pio_index, uint32_t sm,
+                      const uint32_t* tx, uint32_t* rx, uint32_t count) {
+    if (pio_index >= NUM_PIOS || sm >= 4 || count == 0 || (!tx == !rx)) {
+        return MIMIC_ERR_INVAL;
+    }
+    
+    MimicXfer* x = xfer_alloc(task_id, XFER_PIO, (pio_index * 4 + sm) * 2 + (rx != NULL));
+    if (!x) return MIMIC_ERR_BUSY;
+    
+    PIO pio = pio_get_instance(pio_index);
+    if (tx) {
+        xfer_channel(x->tx_ch, DMA_SIZE_32, true, false, pio_get_dreq(pio, sm, true),
+                     &pio->txf[sm], tx, count);
+        dma_channel_unclaim(x->rx_ch);
+        x->rx_ch = IO_NO_CHANNEL;
+        return xfer_start(x, x->tx_ch, count * sizeof(uint32_t));
+    }
+    
+    xfer_channel(x->rx_ch, DMA_SIZE_32, false, true, pio_get_dreq(pio, sm, false),
+                 rx, &pio->rxf[sm], count);
+    dma_channel_unclaim(x->tx_ch);
+    x->tx_ch = IO_NO_CHANNEL;
+    return xfer_start(x, x->rx_ch, count * sizeof(uint32_t));
+}
+
+// Abort transfers in either direction before the state machine goes away;
+// their handles are gone, so a later IO_WAIT gets MIMIC_ERR_INVAL
+void mimic_io_pio_abort(uint32_t pio_index, uint32_t sm) {
+    for (int i = 0; i < MIMIC_IO_MAX_XFERS; i++) {
+        MimicXfer* x = &xfers[i];
+        if (x->used && x->kind == XFER_PIO && x->port / 2 == pio_index * 4 + sm) xfer_free(x);
+    }
+}
+
+static int io_wait(uint32_t task_id, uint32_t handle, uint32_t timeout_ms) {
+    if (handle >= MIMIC_IO_MAX_XFERS) return MIMIC_ERR_INVAL;
+    
+    MimicXfer* x = &xfers[handle];
+    if (!x->used || x->task != task_id) return MIMIC_ERR_INVAL;
+    
+    mimic_io_poll();
+    if (!x->finished) {
+        x->waiting = true;
+        mimic_task_block(timeout_ms);
+        x->waiting = false;
+        mimic_io_poll();
+    }
+    if (!x->finished) return MIMIC_ERR_BUSY;
+    
+    int32_t result = x->result;
+    xfer_free(x);
+    return result;
+}
+
+// ============================================================================
+// ADC
+// ============================================================================
+
+static int adc_temp_milli_c(void) {
+    uint32_t input = adc_get_selected_input();
+    adc_set_temp_sensor_enabled(true);
+    adc_select_input(ADC_TEMPERATURE_CHANNEL_NUM);
+    uint32_t raw = adc_read();
+    adc_select_input(input);
+    
+    // Datasheet: 0.706 V at 27 C, -1.721 mV/C; 3.3 V reference
+    int32_t uv = (int32_t)((uint64_t)raw * 3300000 / 4096);
+    return 27000 - (int32_t)((int64_t)(uv - 706000) * 1000 / 1721);
+}
+
+static int adc_stream_start(uint32_t task_id, uint16_t* ring, uint32_t samples,
+                            uint32_t rate_hz) {
+    if (!ring || samples < 2 || (samples & 1) || rate_hz == 0 ||
+        rate_hz > MIMIC_ADC_MAX_RATE) return MIMIC_ERR_INVAL;
+    if (!adc_ready || adc_stream.running) return MIMIC_ERR_BUSY;
+    
+    int data = dma_claim_unused_channel(false);
+    int ctrl = dma_claim_unused_channel(false);
+    if (data < 0 || ctrl < 0) {
+        if (data >= 0) dma_channel_unclaim(data);
+        if (ctrl >= 0) dma_channel_unclaim(ctrl);
+        return MIMIC_ERR_BUSY;
+    }
+    
+    memset(&adc_stream, 0, sizeof(adc_stream));
+    adc_stream.task = task_id;
+    adc_stream.data_ch = data;
+    adc_stream.ctrl_ch = ctrl;
+    adc_stream.half = samples / 2;
+    adc_halves[0] = (uint32_t)(ring + adc_stream.half);
+    adc_halves[1] = (uint32_t)ring;
+    
+    // Sample period is (div + 1) ADC clocks, floored at the 96 clocks one
+    // conversion takes
+    adc_fifo_setup(true, true, 1, false, false);
+    adc_fifo_drain();
+    adc_set_clkdiv(rate_hz >= MIMIC_ADC_MAX_RATE ? 0 : 48000000.0f / rate_hz - 1);
+    
+    dma_channel_config c = dma_channel_get_default_config(data);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, DREQ_ADC);
+    channel_config_set_chain_to(&c, ctrl);
+    dma_channel_configure(data, &c, ring, &adc_hw->fifo, adc_stream.half, false);
+    
+    c = dma_channel_get_default_config(ctrl);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_ring(&c, false, 3);
+    dma_channel_configure(ctrl, &c, &dma_channel_hw_addr(data)->al2_write_addr_trig,
+                          adc_halves, 1, false);
+                          
+    io_hook_dma();
+    dma_channel_acknowledge_irq1(data);
+    dma_channel_set_irq1_enabled(data, true);
+    adc_stream.running = true;
+    
+    dma_channel_start(data);
+    adc_run(true);
+    return MIMIC_OK;
+}
+
+static uint32_t adc_stream_pos(void) {
+    uint32_t save = save_and_disable_interrupts();
+    adc_stream_service();
+    
+    uint32_t remaining = dma_channel_hw_addr(adc_stream.data_ch)->transfer_count;
+    uint32_t done = adc_stream.half - remaining;
+    
+    // A run that just ended reads 0 until ctrl restarts it; it only adds
+    // to the position if its completion hasn't been counted yet.
+    if (remaining == 0 && !dma_channel_get_irq1_status(adc_stream.data_ch)) done = 0;
+    
+    uint32_t pos = adc_stream.halves * adc_stream.half + done;
+    restore_interrupts(save);
+    return pos;
+}
+
+static void adc_stream_stop(void) {
+    if (!adc_stream.running) return;
+    
+    adc_run(false);
+    
+    // ctrl first, or it could restart data after the abort
+    dma_channel_set_irq1_enabled(adc_stream.data_ch, false);
+    dma_channel_abort(adc_stream.ctrl_ch);
+    dma_channel_abort(adc_stream.data_ch);
+    dma_channel_acknowledge_irq1(adc_stream.data_ch);
+    dma_channel_unclaim(adc_stream.ctrl_ch);
+    dma_channel_unclaim(adc_stream.data_ch);
+    
+    adc_fifo_setup(false, false, 0, false, false);
+    adc_fifo_drain();
+    adc_stream.running = false;
+}
+
+static int adc_pos(uint32_t task_id, uint32_t timeout_ms) {
+    if (!adc_stream.running || adc_stream.task != task_id) return MIMIC_ERR_INVAL;
+    
+    if (timeout_ms) {
+        // io_dma_isr services the stream too; don't let it run in between
+        uint32_t save = save_and_disable_interrupts();
+        uint32_t start = adc_stream.halves;
+        adc_stream_service();
+        restore_interrupts(save);
+        
+        if (adc_stream.halves == start) {
+            adc_stream.waiting = true;
+            mimic_task_block(timeout_ms);
+            adc_stream.waiting = false;
+        }
+    }
+    return adc_stream_pos() & 0x7FFFFFFF;
+}
+
+// ============================================================================
+// SYSCALLS
+// ============================================================================
+
+int32_t mimic_io_syscall(uint32_t task_id, uint32_t num,
+                         uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    switch (num) {
+        case MIMIC_SYS_PWM_INIT:
+            if (a0 >= NUM_BANK0_GPIOS) return MIMIC_ERR_INVAL;
+            gpio_set_function(a0, GPIO_FUNC_PWM);
+            return pwm_gpio_to_slice_num(a0);
+            
+        case MIMIC_SYS_PWM_SET_WRAP:
+            if (a0 >= NUM_BANK0_GPIOS) return MIMIC_ERR_INVAL;
+            pwm_set_wrap(pwm_gpio_to_slice_num(a0), a1);
+            return 0;
+            
+        case MIMIC_SYS_PWM_SET_LEVEL:
+            if (a0 >= NUM_BANK0_GPIOS) return MIMIC_ERR_INVAL;
+            pwm_set_gpio_level(a0, a1);
+            return 0;
+            
+        case MIMIC_SYS_PWM_ENABLE:
+            if (a0 >= NUM_BANK0_GPIOS) return MIMIC_ERR_INVAL;
+            pwm_set_enabled(pwm_gpio_to_slice_num(a0), a1 != 0);
+            return 0;
+            
+        case MIMIC_SYS_ADC_INIT:
+            if (!adc_ready) {
+                adc_init();
+                adc_ready = true;
+            }
+            if (a0 >= ADC_BASE_PIN && a0 < ADC_BASE_PIN + NUM_ADC_CHANNELS - 1) {
+                adc_gpio_init(a0);
+            }
+            return 0;
+            
+        case MIMIC_SYS_ADC_SELECT:
+            if (!adc_ready || a0 >= NUM_ADC_CHANNELS) return MIMIC_ERR_INVAL;
+            adc_select_input(a0);
+            return 0;
+            
+        case MIMIC_SYS_ADC_READ:
+            if (!adc_ready) return MIMIC_ERR_INVAL;
+            if (adc_stream.running) return MIMIC_ERR_BUSY;
+            return adc_read();
+            
+        case MIMIC_SYS_ADC_TEMP:
+            if (!adc_ready) return MIMIC_ERR_INVAL;
+            if (adc_stream.running) return MIMIC_ERR_BUSY;
+            return adc_temp_milli_c();
+            
+        case MIMIC_SYS_ADC_STREAM:
+            return adc_stream_start(task_id, (uint16_t*)a0, a1, a2);
+            
+        case MIMIC_SYS_ADC_POS:
+            return adc_pos(task_id, a0);
+            
+        case MIMIC_SYS_ADC_STOP:
+            if (!adc_stream.running || adc_stream.task != task_id) return MIMIC_ERR_INVAL;
+            adc_stream_stop();
+            return 0;
+            
+        case MIMIC_SYS_SPI_INIT: {
+            spi_inst_t* spi = io_spi(a0);
+            if (!spi) return MIMIC_ERR_INVAL;
+            if (a0 == MIMIC_IO_SD_SPI) return MIMIC_ERR_PERM;
+            
+            uint32_t baud = spi_init(spi, a1);
+            for (int shift = 0; shift < 24; shift += 8) {
+                uint32_t pin = (a2 >> shift) & 0xFF;
+                if (pin < NUM_BANK0_GPIOS) gpio_set_function(pin, GPIO_FUNC_SPI);
+            }
+            return baud;
+        }
+        
+        case MIMIC_SYS_SPI_WRITE:
+            return spi_xfer(task_id, a0, (const uint8_t*)a1, NULL, a2);
+            
+        case MIMIC_SYS_SPI_READ:
+            return spi_xfer(task_id, a0, NULL, (uint8_t*)a1, a2);
+            
+        case MIMIC_SYS_SPI_TRANSFER:
+            if (!a1 || !a2) return MIMIC_ERR_INVAL;
+            return spi_xfer(task_id, a0, (const uint8_t*)a1, (uint8_t*)a2, a3);
+            
+        case MIMIC_SYS_I2C_INIT: {
+            i2c_inst_t* i2c = io_i2c(a0);
+            if (!i2c) return MIMIC_ERR_INVAL;
+            
+            uint32_t baud = i2c_init(i2c, a1);
+            for (int shift = 0; shift < 16; shift += 8) {
+                uint32_t pin = (a2 >> shift) & 0xFF;
+                if (pin < NUM_BANK0_GPIOS) {
+                    gpio_set_function(pin, GPIO_FUNC_I2C);
+                    gpio_pull_up(pin);
+                }
+            }
+            return baud;
+        }
+        
+        case MIMIC_SYS_I2C_WRITE:
+            if (!a2) return MIMIC_ERR_INVAL;
+            return i2c_xfer(task_id, a0, a1, (const uint8_t*)a2, NULL, a3);
+            
+        case MIMIC_SYS_I2C_READ:
+            if (!a2) return MIMIC_ERR_INVAL;
+            return i2c_xfer(task_id, a0, a1, NULL, (uint8_t*)a2, a3);
+            
+        case MIMIC_SYS_IO_WAIT:
+            return io_wait(task_id, a0, a1);
+            
+        default:
+            return MIMIC_ERR_NOSYS;
+    }
+}
+
+// ============================================================================
+// KERNEL HOOKS
+// ============================================================================
+
+void mimic_io_poll(void) {
+    for (int i = 0; i < MIMIC_IO_MAX_XFERS; i++) {
+        MimicXfer* x = &xfers[i];
+        if (!x->used || x->finished) continue;
+        
+        // A NAK aborts the controller and flushes its FIFO, so the DMA
+        // would wait forever; catch it here instead.
+        if (!x->done && x->kind == XFER_I2C) {
+            i2c_hw_t* hw = i2c_get_hw(io_i2c(x->port));
+            if (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+                (void)hw->clr_tx_abrt;
+                x->result = MIMIC_ERR_IO;
+                x->done = true;
+            }
+        }
+        if (!x->done) continue;
+        
+        xfer_release_channels(x);
+        x->finished = true;
+        if (x->result >= 0) mimic_perf_add(MIMIC_PERF_IO_BYTES, x->result);
+        else mimic_perf_inc(MIMIC_PERF_IO_ERRORS);
+        if (x->waiting) mimic_task_wake(x->task);
+    }
+    
+    if (adc_stream.running && adc_stream.halves != adc_stream.notified) {
+        adc_stream.notified = adc_stream.halves;
+        if (adc_stream.waiting) mimic_task_wake(adc_stream.task);
+    }
+}
+
+void mimic_io_release_task(uint32_t task_id) {
+    if (task_id == 0) return;
+    
+    // DMA must stop before the task's buffers are freed
+    for (int i = 0; i < MIMIC_IO_MAX_XFERS; i++) {
+        if (xfers[i].used && xfers[i].task == task_id) xfer_free(&xfers[i]);
+    }
+    if (adc_stream.running && adc_stream.task == task_id) adc_stream_stop();
+}
@@ -0,0 +1,342 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC IRQ - User interrupt handlers with deferred dispatch               ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  ISRs only timestamp and queue; handlers run from the kernel loop         ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * User code never runs in interrupt context. Each ISR pushes a 12-byte
+ * event into a ring with interrupts masked for a handful of stores, which
+ * makes it safe against nested ISRs on the same core. The kernel drains
+ * the ring from mimic_kernel_poll() and from every kthread preemption
+ * point, so an event that lands during a long compile is still handled
+ * within one preemption interval rather than one slice.
+ * 
+ * All sources are armed from core 0 (syscalls run there), so their ISRs,
+ * the ring's producers, and its only consumer share a core.
+ * 
+ * Latency is measured from the ISR's timestamp to the start of dispatch
+ * and kept per handler (min/avg/max), in the perf counters, and in the
+ * trace as MIMIC_TRACE_IRQ.
+ */
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "mimic.h"
+#include "mimic_trace.h"
+#include "mimic_perf.h"
+
+// ============================================================================
+// HANDLER TABLE
+// ============================================================================
+
+typedef struct {
+    bool        used;
+    uint8_t     gen;            // Bumped on detach so stale events are dropped
+    uint8_t     task;
+    uint8_t     source;
+    uint32_t    param;
+    uint32_t    handler;        // User function, 0 = collect with IRQ_WAIT
+    repeating_timer_t timer;
+    uint32_t    fires;
+    
+    // IRQ_WAIT delivery
+    uint32_t    pending;
+    uint32_t    last_data;
+    
+    // Statistics
+    uint32_t    events;
+    uint32_t    dropped;
+    uint32_t    lat_min_us;
+    uint32_t    lat_max_us;
+    uint64_t    lat_total_us;
+} MimicIrq;
+
+typedef struct {
+    uint32_t    time_us;
+    uint8_t     id;
+    uint8_t     gen;
+    uint8_t     _pad[2];
+    uint32_t    data;
+} MimicIrqEvent;
+
+static MimicIrq irqs[MIMIC_IRQ_MAX_HANDLERS];
+
+static MimicIrqEvent irq_queue[MIMIC_IRQ_QUEUE];
+static volatile uint32_t irq_head;     // Written by ISRs
+static volatile uint32_t irq_tail;     // Written by the dispatcher
+static bool irq_dispatching;
+static bool pio_hooked[NUM_PIOS];
+
+// ============================================================================
+// INTERRUPT SIDE
+// ============================================================================
+
+static void __not_in_flash_func(irq_post)(int id, uint32_t data) {
+    uint32_t now = time_us_32();
+    uint32_t save = save_and_disable_interrupts();
+    
+    if (irq_head - irq_tail >= MIMIC_IRQ_QUEUE) {
+        irqs[id].dropped++;
+        mimic_perf_inc(MIMIC_PERF_IRQ_DROPPED);
+    } else {
+        MimicIrqEvent* ev = &irq_queue[irq_head & (MIMIC_IRQ_QUEUE - 1)];
+        ev->time_us = now;
+        ev->id = id;
+        ev->gen = irqs[id].gen;
+        ev->data = data;
+        irq_head++;
+    }
+    
+    restore_interrupts(save);
+}
+
+static void __not_in_flash_func(irq_gpio_isr)(unsigned gpio, uint32_t events) {
+    for (int i = 0; i < MIMIC_IRQ_MAX_HANDLERS; i++) {
+        MimicIrq* q = &irqs[i];
+        if (q->used && q->source == MIMIC_IRQ_SRC_GPIO && (q->param & 0xFF) == gpio) {
+            irq_post(i, gpio | events << 8);
+        }
+    }
+}
+
+static bool __not_in_flash_func(irq_timer_isr)(repeating_timer_t* t) {
+    MimicIrq* q = t->user_data;
+    irq_post(q - irqs, ++q->fires & 0x7FFFFFFF);
+    return true;
+}
+
+static void __not_in_flash_func(irq_pio_isr)(void) {
+    for (int i = 0; i < MIMIC_IRQ_MAX_HANDLERS; i++) {
+        MimicIrq* q = &irqs[i];
+        if (!q->used || q->source != MIMIC_IRQ_SRC_PIO) continue;
+        
+        PIO pio = pio_get_instance(q->param >> 8);
+        uint32_t flag = q->param & 3;
+        if (pio_interrupt_get(pio, flag)) {
+            pio_interrupt_clear(pio, flag);
+            irq_post(i, q->param);
+        }
+    }
+}
+
+// ============================================================================
+// SOURCES
+// ============================================================================
+
+static int irq_arm(MimicIrq* q) {
+    switch (q->source) {
+        case MIMIC_IRQ_SRC_GPIO: {
+            uint32_t pin = q->param & 0xFF;
+            uint32_t edges = (q->param >> 8) & (GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL);
+            if (pin >= NUM_BANK0_GPIOS || edges == 0) return MIMIC_ERR_INVAL;
+            
+            // The SDK keeps one GPIO callback per core; ours demuxes by pin
+            gpio_set_irq_enabled_with_callback(pin, edges, true, irq_gpio_isr);
+            return MIMIC_OK;
+        }
+        
+        case MIMIC_IRQ_SRC_TIMER:
+            if (q->param < MIMIC_IRQ_MIN_PERIOD_US) return MIMIC_ERR_INVAL;
+            
+            // Negative period: fixed rate from the previous target, no drift
+            if (!add_repeating_timer_us(-(int64_t)q->param, irq_timer_isr, q, &q->timer)) {
+                return MIMIC_ERR_NOMEM;
+            }
+            return MIMIC_OK;
+            
+        case MIMIC_IRQ_SRC_PIO: {
+            uint32_t index = q->param >> 8;
+            if (index >= NUM_PIOS || (q->param & 0xFC)) return MIMIC_ERR_INVAL;
+            
+            PIO pio = pio_get_instance(index);
+            if (!pio_hooked[index]) {
+                // Shared, so PIO programs loaded by the kernel keep theirs
+                uint32_t line = pio_get_irq_num(pio, 0);
+                irq_add_shared_handler(line, irq_pio_isr,
+                                       PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+                irq_set_enabled(line, true);
+                pio_hooked[index] = true;
+            }
+            pio_interrupt_clear(pio, q->param & 3);
+            pio_set_irq0_source_enabled(pio, pis_interrupt0 + (q->param & 3), true);
+            return MIMIC_OK;
+        }
+        
+        default:
+            return MIMIC_ERR_INVAL;
+    }
+}
+
+static void irq_disarm(MimicIrq* q) {
+    switch (q->source) {
+        case MIMIC_IRQ_SRC_GPIO: {
+            // Leave the pin armed if another handler still listens on it
+            uint32_t pin = q->param & 0xFF;
+            for (int i = 0; i < MIMIC_IRQ_MAX_HANDLERS; i++) {
+                MimicIrq* other = &irqs[i];
+                if (other != q && other->used && other->source == MIMIC_IRQ_SRC_GPIO &&
+                    (other->param & 0xFF) == pin) return;
+            }
+            gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+            break;
+        }
+        
+        case MIMIC_IRQ_SRC_TIMER:
+            cancel_repeating_timer(&q->timer);
+            break;
+            
+        case MIMIC_IRQ_SRC_PIO:
+            pio_set_irq0_source_enabled(pio_get_instance(q->param >> 8),
+                                        pis_interrupt0 + (q->param & 3), false);
+            break;
+    }
+}
+
+// ============================================================================
+// API
+// ============================================================================
+
+int mimic_irq_attach(uint32_t task_id, uint32_t source, uint32_t param, uint32_t handler) {
+    if (task_id == 0 || task_id >= MIMIC_MAX_TASKS) return MIMIC_ERR_INVAL;
+    
+    int id = -1;
+    for (int i = 0; i < MIMIC_IRQ_MAX_HANDLERS; i++) {
+        if (!irqs[i].used) {
+            id = i;
+            break;
+        }
+    }
+    if (id < 0) return MIMIC_ERR_NOMEM;
+    
+    MimicIrq* q = &irqs[id];
+    uint8_t gen = q->gen;
+    memset(q, 0, sizeof(MimicIrq));
+    q->gen = gen;
+    q->task = task_id;
+    q->source = source;
+    q->param = param;
+    q->handler = handler;
+    q->lat_min_us = UINT32_MAX;
+    
+    // Publish before arming: the first edge may fire inside irq_arm()
+    q->used = true;
+    int err = irq_arm(q);
+    if (err != MIMIC_OK) {
+        q->used = false;
+        return err;
+    }
+    return id;
+}
+
+int mimic_irq_detach(uint32_t task_id, int id) {
+    if (id < 0 || id >= MIMIC_IRQ_MAX_HANDLERS) return MIMIC_ERR_INVAL;
+    
+    MimicIrq* q = &irqs[id];
+    if (!q->used || q->task != task_id) return MIMIC_ERR_INVAL;
+    
+    irq_disarm(q);
+    q->used = false;
+    q->gen++;
+    return MIMIC_OK;
+}
+
+int mimic_irq_wait(uint32_t task_id, int id, uint32_t timeout_ms) {
+    if (id < 0 || id >= MIMIC_IRQ_MAX_HANDLERS) return MIMIC_ERR_INVAL;
+    
+    MimicIrq* q = &irqs[id];
+    if (!q->used || q->task != task_id || q->handler) return MIMIC_ERR_INVAL;
+    
+    // Only the dispatcher raises pending, and it runs on this core
+    if (q->pending == 0) {
+        mimic_irq_dispatch();
+        if (q->pending == 0) mimic_task_block(timeout_ms);
+    }
+    if (q->pending == 0) return MIMIC_ERR_BUSY;
+    
+    q->pending--;
+    return q->last_data;
+}
+
+bool mimic_irq_pending(void) {
+    return irq_head != irq_tail;
+}
+
+void mimic_irq_dispatch(void) {
+    // The ring has a single consumer: core 0, never re-entered from a
+    // handler that reaches a preemption point itself.
+    if (get_core_num() != 0 || irq_dispatching) return;
+    irq_dispatching = true;
+    
+    while (irq_tail != irq_head) {
+        MimicIrqEvent ev = irq_queue[irq_tail & (MIMIC_IRQ_QUEUE - 1)];
+        irq_tail++;
+        
+        MimicIrq* q = &irqs[ev.id];
+        if (!q->used || q->gen != ev.gen) continue;
+        
+        uint32_t latency = time_us_32() - ev.time_us;
+        q->events++;
+        q->lat_total_us += latency;
+        if (latency < q->lat_min_us) q->lat_min_us = latency;
+        if (latency > q->lat_max_us) q->lat_max_us = latency;
+        mimic_perf_inc(MIMIC_PERF_IRQ_EVENTS);
+        mimic_perf_add(MIMIC_PERF_IRQ_LATENCY_US, latency);
+        mimic_trace(MIMIC_TRACE_IRQ, ev.id, latency);
+        
+        if (q->handler) {
+            mimic_task_call(q->task, q->handler, ev.id, ev.data);
+        } else {
+            q->pending++;
+            q->last_data = ev.data;
+            mimic_task_wake(q->task);
+        }
+    }
+    
+    irq_dispatching = false;
+}
+
+void mimic_irq_release_task(uint32_t task_id) {
+    if (task_id == 0) return;
+    
+    for (int i = 0; i < MIMIC_IRQ_MAX_HANDLERS; i++) {
+        mimic_irq_detach(task_id, i);
+    }
+}
+
+// ============================================================================
+// DEBUG
+// ============================================================================
+
+void mimic_irq_dump(void) {
+    static const char* const sources[] = {"gpio", "timer", "pio"};
+    
+    printf("\n=== IRQ HANDLERS ===\n");
+    printf("%-3s %-6s %-8s %-5s %8s %6s %8s %8s %8s\n",
+           "ID", "SOURCE", "PARAM", "TASK", "EVENTS", "DROP",
+           "MIN us", "AVG us", "MAX us");
+           
+    int shown = 0;
+    for (int i = 0; i < MIMIC_IRQ_MAX_HANDLERS; i++) {
+        MimicIrq* q = &irqs[i];
+        if (!q->used) continue;
+        
+        uint32_t avg = q->events ? (uint32_t)(q->lat_total_us / q->events) : 0;
+        printf("%-3d %-6s %-8lx %-5u %8lu %6lu %8lu %8lu %8lu\n",
+               i, sources[q->source], (unsigned long)q->param, q->task,
+               (unsigned long)q->events, (unsigned long)q->dropped,
+               (unsigned long)(q->events ? q->lat_min_us : 0),
+               (unsigned long)avg, (unsigned long)q->lat_max_us);
+        shown++;
+    }
+    if (shown == 0) printf("(none attached)\n");
+    
+    printf("Queue: %lu/%d pending\n\n",
+           (unsigned long)(irq_head - irq_tail), MIMIC_IRQ_QUEUE);
+}
@@ -16,12 +16,15 @@
 #include "hardware/adc.h"
 #include "hardware/pwm.h"
 #include "hardware/watchdog.h"
+#include "hardware/structs/sio.h"
 
 #include <string.h>
 #include <stdio.h>
 
 #include "mimic.h"
 #include "mimic_fat32.h"
+#include "mimic_trace.h"
+#include "mimic_perf.h"
 
 // ============================================================================
 // COMPILER HINTS
@@ -65,13 +68,6 @@ typedef struct {
     
     uint64_t        boot_time_us;
     
-    uint32_t        total_allocs;
-    uint32_t        total_frees;
-    uint32_t        failed_allocs;
-    uint32_t        programs_loaded;
-    uint32_t        syscalls_handled;
-    uint32_t        context_switches;
-    
     uint32_t        kernel_free;
     uint32_t        user_free;
     
@@ -107,7 +103,8 @@ static void mem_init(void) {
 
 static void* mem_alloc_from_pool(MimicMemBlock* blocks, uint32_t* block_count,
                                   uint32_t* free_bytes, mutex_t* lock,
-                                  size_t size, uint32_t task_id, uint32_t max_blocks) {
+                                  size_t size, uint32_t task_id, uint32_t max_blocks,
+                                  uint32_t counter) {
     if (size == 0) return NULL;
     
     size = (size + MIMIC_MEM_ALIGN - 1) & ~(MIMIC_MEM_ALIGN - 1);
@@ -146,19 +143,23 @@ static void* mem_alloc_from_pool(MimicMemBlock* blocks, uint32_t* block_count,
         block->free = false;
         block->task_id = task_id;
         *free_bytes -= block->size;
-        kernel.total_allocs++;
+        mimic_perf_inc(counter);
+        mimic_perf_add(MIMIC_PERF_ALLOC_BYTES, block->size);
         
         result = block->addr;
     } else {
-        kernel.failed_allocs++;
+        mimic_perf_inc(MIMIC_PERF_ALLOC_FAILS);
     }
     
     mutex_exit(lock);
+    
+    if (result) mimic_trace(MIMIC_TRACE_ALLOC, task_id, size);
     return result;
 }
 
 static void mem_free_in_pool(MimicMemBlock* blocks, uint32_t* block_count,
-                              uint32_t* free_bytes, mutex_t* lock, void* ptr) {
+                              uint32_t* free_bytes, mutex_t* lock, void* ptr,
+                              uint32_t counter) {
     if (!ptr) return;
     
     mutex_enter_blocking(lock);
@@ -172,7 +173,8 @@ static void mem_free_in_pool(MimicMemBlock* blocks, uint32_t* block_count,
             
             blocks[i].free = true;
             *free_bytes += blocks[i].size;
-            kernel.total_frees++;
+            mimic_perf_inc(counter);
+            mimic_trace(MIMIC_TRACE_FREE, blocks[i].task_id, (uint32_t)ptr);
             break;
         }
     }
@@ -183,12 +185,12 @@ static void mem_free_in_pool(MimicMemBlock* blocks, uint32_t* block_count,
 void* HOT_FUNC mimic_kmalloc(size_t size) {
     return mem_alloc_from_pool(kernel.mem_blocks, &kernel.mem_block_count,
                                 &kernel.kernel_free, &kernel.mem_lock,
-                                size, 0, MIMIC_MAX_MEM_BLOCKS);
+                                size, 0, MIMIC_MAX_MEM_BLOCKS, MIMIC_PERF_KALLOCS);
 }
 
 void HOT_FUNC mimic_kfree(void* ptr) {
     mem_free_in_pool(kernel.mem_blocks, &kernel.mem_block_count,
-                      &kernel.kernel_free, &kernel.mem_lock, ptr);
+                      &kernel.kernel_free, &kernel.mem_lock, ptr, MIMIC_PERF_KFREES);
 }
 
 void* mimic_krealloc(void* ptr, size_t size) {
@@ -222,13 +224,13 @@ void* mimic_krealloc(void* ptr, size_t size) {
 void* mimic_umalloc(uint32_t task_id, size_t size) {
     return mem_alloc_from_pool(kernel.user_blocks, &kernel.user_block_count,
                                 &kernel.user_free, &kernel.user_lock,
-                                size, task_id, MIMIC_MAX_MEM_BLOCKS);
+                                size, task_id, MIMIC_MAX_MEM_BLOCKS, MIMIC_PERF_UALLOCS);
 }
 
 void mimic_ufree(uint32_t task_id, void* ptr) {
     (void)task_id;  // TODO: verify ownership
     mem_free_in_pool(kernel.user_blocks, &kernel.user_block_count,
-                      &kernel.user_free, &kernel.user_lock, ptr);
+                      &kernel.user_free, &kernel.user_lock, ptr, MIMIC_PERF_UFREES);
 }
 
 void mimic_task_free_all_memory(uint32_t task_id) {
@@ -238,7 +240,7 @@ void mimic_task_free_all_memory(uint32_t task_id) {
         if (kernel.user_blocks[i].task_id == task_id && !kernel.user_blocks[i].free) {
             kernel.user_blocks[i].free = true;
             kernel.user_free += kernel.user_blocks[i].size;
-            kernel.total_frees++;
+            mimic_perf_inc(MIMIC_PERF_UFREES);
         }
     }
     
@@ -300,140 +302,194 @@ int mimic_validate_header(const MimiHeader* hdr) {
     return MIMIC_OK;
 }
 
-int mimic_load_binary(const char* path, MimicTCB* task) {
-    int fd = mimic_fopen(path, MIMIC_FILE_READ);
-    if (fd < 0) return fd;
-    
-    // Read header
-    MimiHeader hdr;
-    int n = mimic_fread(fd, &hdr, sizeof(hdr));
-    if (n != sizeof(hdr)) {
-        mimic_fclose(fd);
-        return MIMIC_ERR_CORRUPT;
-    }
-    
-    int err = mimic_validate_header(&hdr);
-    if (err != MIMIC_OK) {
-        mimic_fclose(fd);
-        return err;
-    }
-    
+#if MIMIC_STACK_PAINT
+static void task_paint_stack(MimicTCB* task) {
+    uint32_t* p = (uint32_t*)(task->mem.base + task->mem.stack_top - task->mem.stack_size);
+    uint32_t* end = (uint32_t*)(task->mem.base + task->mem.stack_top);
+    while (p < end) *p++ = MIMIC_STACK_PAINT_WORD;
+}
+#endif
+
+uint32_t mimic_task_stack_peak(const MimicTCB* task) {
+#if MIMIC_STACK_PAINT
+    if (task->kthread || task->mem.stack_size == 0) return 0;
+    
+    // Stacks grow down, so the lowest overwritten word marks the peak
+    const uint32_t* p = (const uint32_t*)(task->mem.base + task->mem.stack_top - task->mem.stack_size);
+    const uint32_t* end = (const uint32_t*)(task->mem.base + task->mem.stack_top);
+    while (p < end && *p == MIMIC_STACK_PAINT_WORD) p++;
+    return (uintptr_t)end - (uintptr_t)p;
+#else
+    (void)task;
+    return 0;
+#endif
+}
+
+// Allocate the task image and lay out its sections from the header
+static int task_alloc_image(MimicTCB* task, const MimiHeader* hdr) {
     // Calculate total memory needed
-    uint32_t code_size = hdr.text_size + hdr.rodata_size;
-    uint32_t data_size = hdr.data_size + hdr.bss_size;
-    uint32_t stack_size = hdr.stack_request ? hdr.stack_request : 4096;
-    uint32_t heap_size = hdr.heap_request ? hdr.heap_request : 8192;
-    uint32_t total_size = code_size + data_size + stack_size + heap_size;
+    uint32_t code_size = hdr->text_size + hdr->rodata_size + hdr->pio_size;
+    uint32_t data_size = hdr->data_size + hdr->bss_size;
+    uint32_t stack_size = hdr->stack_request ? hdr->stack_request : 4096;
+    uint32_t heap_size = hdr->heap_request ? hdr->heap_request : 8192;
+    if (hdr->flags & MIMI_FLAG_HEAP_HINT) heap_size = hdr->heap_request;
+    // Slack so the guard can sit on an MPU region boundary
+    uint32_t total_size = code_size + data_size + heap_size + stack_size +
+                          2 * MIMIC_STACK_GUARD + 8;
     
     total_size = (total_size + 31) & ~31;  // Align
     
     // Allocate memory
     void* mem = mimic_umalloc(task->id, total_size);
-    if (!mem) {
-        mimic_fclose(fd);
-        return MIMIC_ERR_NOMEM;
-    }
+    if (!mem) return MIMIC_ERR_NOMEM;
     
     // Setup memory layout
     task->mem.base = (uintptr_t)mem;
     task->mem.total_size = total_size;
     
     task->mem.text_start = 0;
-    task->mem.text_size = hdr.text_size;
+    task->mem.text_size = hdr->text_size;
     
-    task->mem.rodata_start = hdr.text_size;
-    task->mem.rodata_size = hdr.rodata_size;
+    task->mem.rodata_start = hdr->text_size;
+    task->mem.rodata_size = hdr->rodata_size;
+    
+    task->mem.pio_start = hdr->text_size + hdr->rodata_size;
+    task->mem.pio_size = hdr->pio_size;
     
     task->mem.data_start = code_size;
-    task->mem.data_size = hdr.data_size;
+    task->mem.data_size = hdr->data_size;
+    
+    task->mem.bss_start = code_size + hdr->data_size;
+    task->mem.bss_size = hdr->bss_size;
     
-    task->mem.bss_start = code_size + hdr.data_size;
-    task->mem.bss_size = hdr.bss_size;
+    // Stack at the top, guard aligned just below it; the heap and the
+    // stack each keep whatever the alignment leaves over
+    uintptr_t top = ((uintptr_t)mem + total_size) & ~7u;
+    uintptr_t guard = (top - stack_size - MIMIC_STACK_GUARD) & ~(uintptr_t)(MIMIC_STACK_GUARD - 1);
     
     task->mem.heap_start = code_size + data_size;
-    task->mem.heap_size = heap_size;
+    task->mem.heap_size = (guard - (uintptr_t)mem) - task->mem.heap_start;
     task->mem.heap_used = 0;
     
-    task->mem.stack_top = total_size;
-    task->mem.stack_size = stack_size;
+    task->mem.guard_start = guard - (uintptr_t)mem;
+    task->mem.stack_top = top - (uintptr_t)mem;
+    task->mem.stack_size = task->mem.stack_top - (task->mem.guard_start + MIMIC_STACK_GUARD);
     
-    // Load sections
-    uint8_t* base = (uint8_t*)mem;
-    
-    // Load .text
-    if (hdr.text_size > 0) {
-        n = mimic_fread(fd, base + task->mem.text_start, hdr.text_size);
-        if (n != (int)hdr.text_size) {
-            mimic_ufree(task->id, mem);
-            mimic_fclose(fd);
-            return MIMIC_ERR_CORRUPT;
-        }
-    }
+#if MIMIC_STACK_PAINT
+    task_paint_stack(task);
+#endif
     
-    // Load .rodata
-    if (hdr.rodata_size > 0) {
-        n = mimic_fread(fd, base + task->mem.rodata_start, hdr.rodata_size);
-        if (n != (int)hdr.rodata_size) {
-            mimic_ufree(task->id, mem);
-            mimic_fclose(fd);
-            return MIMIC_ERR_CORRUPT;
-        }
+    // Zero .bss
+    if (hdr->bss_size > 0) {
+        memset((uint8_t*)mem + task->mem.bss_start, 0, hdr->bss_size);
     }
     
-    // Load .data
-    if (hdr.data_size > 0) {
-        n = mimic_fread(fd, base + task->mem.data_start, hdr.data_size);
-        if (n != (int)hdr.data_size) {
-            mimic_ufree(task->id, mem);
-            mimic_fclose(fd);
-            return MIMIC_ERR_CORRUPT;
-        }
-    }
+    return MIMIC_OK;
+}
+
+static void task_relocate(MimicTCB* task, const MimiReloc* reloc) {
+    uint8_t* base = (uint8_t*)task->mem.base;
+    uint32_t* target = NULL;
     
-    // Zero .bss
-    if (hdr.bss_size > 0) {
-        memset(base + task->mem.bss_start, 0, hdr.bss_size);
+    switch (reloc->section) {
+        case MIMI_SECT_TEXT:
+            target = (uint32_t*)(base + task->mem.text_start + reloc->offset);
+            break;
+        case MIMI_SECT_RODATA:
+            target = (uint32_t*)(base + task->mem.rodata_start + reloc->offset);
+            break;
+        case MIMI_SECT_DATA:
+            target = (uint32_t*)(base + task->mem.data_start + reloc->offset);
+            break;
     }
     
-    // Process relocations
-    for (uint32_t i = 0; i < hdr.reloc_count; i++) {
-        MimiReloc reloc;
-        n = mimic_fread(fd, &reloc, sizeof(reloc));
-        if (n != sizeof(reloc)) break;
-        
-        uint32_t* target = NULL;
-        switch (reloc.section) {
-            case MIMI_SECT_TEXT:
-                target = (uint32_t*)(base + task->mem.text_start + reloc.offset);
-                break;
-            case MIMI_SECT_RODATA:
-                target = (uint32_t*)(base + task->mem.rodata_start + reloc.offset);
-                break;
-            case MIMI_SECT_DATA:
-                target = (uint32_t*)(base + task->mem.data_start + reloc.offset);
-                break;
-        }
-        
-        if (target) {
-            // Add base address to relocation
-            *target += (uint32_t)task->mem.base;
-        }
+    if (target) {
+        // Add base address to relocation
+        *target += (uint32_t)task->mem.base;
     }
-    
-    mimic_fclose(fd);
-    
+}
+
+static void task_finish_image(MimicTCB* task, const MimiHeader* hdr) {
     // Set entry point
-    task->entry = (void*)(task->mem.base + task->mem.text_start + hdr.entry_offset);
+    task->entry = (void*)(task->mem.base + task->mem.text_start + hdr->entry_offset);
     
     // Copy name
-    strncpy(task->name, hdr.name, 15);
+    strncpy(task->name, hdr->name, 15);
     task->name[15] = '\0';
     
     // Initialize stack pointer
     task->sp = task->mem.base + task->mem.stack_top;
     
-    kernel.programs_loaded++;
+    mimic_perf_inc(MIMIC_PERF_TASKS_LOADED);
+}
+
+int mimic_load_binary(const char* path, MimicTCB* task) {
+    uint8_t buf[SD_SECTOR_SIZE];
+    MimicStream in;
+    int err = mimic_stream_open(&in, path, MIMIC_FILE_READ, buf, sizeof(buf));
+    if (err < 0) return err;
+    
+    // Read header
+    MimiHeader hdr;
+    int n = mimic_stream_read(&in, &hdr, sizeof(hdr));
+    if (n != sizeof(hdr)) {
+        mimic_stream_close(&in);
+        return MIMIC_ERR_CORRUPT;
+    }
     
+    err = mimic_validate_header(&hdr);
+    if (err != MIMIC_OK) {
+        mimic_stream_close(&in);
+        return err;
+    }
+    
+    err = task_alloc_image(task, &hdr);
+    if (err != MIMIC_OK) {
+        mimic_stream_close(&in);
+        return err;
+    }
+    
+    // Load .text, .rodata, PIO and .data; they are contiguous in the file
+    uint8_t* base = (uint8_t*)task->mem.base;
+    uint32_t load_size = hdr.text_size + hdr.rodata_size + hdr.pio_size + hdr.data_size;
+    if (load_size > 0) {
+        n = mimic_stream_read(&in, base + task->mem.text_start, load_size);
+        if (n != (int)load_size) {
+            mimic_ufree(task->id, base);
+            mimic_stream_close(&in);
+            return MIMIC_ERR_CORRUPT;
+        }
+    }
+    
+    // Process relocations straight out of the stream buffer; a record
+    // split across two refills is copied out the slow way
+    uint32_t remaining = hdr.reloc_count;
+    while (remaining > 0) {
+        const uint8_t* p;
+        uint32_t len;
+        if (mimic_stream_peek(&in, &p, &len) != MIMIC_OK || len == 0) break;
+        
+        MimiReloc reloc;
+        if (len < sizeof(reloc)) {
+            if (mimic_stream_read(&in, &reloc, sizeof(reloc)) != sizeof(reloc)) break;
+            task_relocate(task, &reloc);
+            remaining--;
+            continue;
+        }
+        
+        uint32_t count = len / sizeof(reloc);
+        if (count > remaining) count = remaining;
+        for (uint32_t i = 0; i < count; i++) {
+            memcpy(&reloc, p + i * sizeof(reloc), sizeof(reloc));
+            task_relocate(task, &reloc);
+        }
+        mimic_stream_consume(&in, count * sizeof(reloc));
+        remaining -= count;
+    }
+    
+    mimic_stream_close(&in);
+    
+    task_finish_image(task, &hdr);
     return MIMIC_OK;
 }
 
@@ -455,13 +511,75 @@ int mimic_task_load(const char* path, uint8_t priority) {
     return (int)task->id;
 }
 
+// Start a task from an image already in RAM (e.g. fresh from the
+// compiler): data holds the sections and relocations that follow the
+// header in a .mimi file. Nothing touches the SD card.
+int mimic_task_spawn(const MimiHeader* hdr, const uint8_t* data, uint8_t priority) {
+    if (!hdr || !data) return MIMIC_ERR_INVAL;
+    
+    int err = mimic_validate_header(hdr);
+    if (err != MIMIC_OK) return err;
+    
+    MimicTCB* task = task_alloc();
+    if (!task) return MIMIC_ERR_NOMEM;
+    
+    err = task_alloc_image(task, hdr);
+    if (err != MIMIC_OK) {
+        task->state = TASK_STATE_FREE;
+        kernel.task_count--;
+        return err;
+    }
+    
+    uint32_t load_size = hdr->text_size + hdr->rodata_size + hdr->pio_size + hdr->data_size;
+    memcpy((uint8_t*)task->mem.base + task->mem.text_start, data, load_size);
+    
+    const MimiReloc* relocs = (const MimiReloc*)(data + load_size);
+    for (uint32_t i = 0; i < hdr->reloc_count; i++) {
+        MimiReloc reloc;
+        memcpy(&reloc, &relocs[i], sizeof(reloc));  // Unaligned in the image
+        task_relocate(task, &reloc);
+    }
+    
+    task_finish_image(task, hdr);
+    
+    task->priority = priority;
+    task->start_time = time_us_64() / 1000;
+    task->state = TASK_STATE_READY;
+    
+    return (int)task->id;
+}
+
+MimicTCB* mimic_task_get(uint32_t task_id) {
+    if (task_id >= MIMIC_MAX_TASKS) return NULL;
+    if (kernel.tasks[task_id].state == TASK_STATE_FREE) return NULL;
+    return &kernel.tasks[task_id];
+}
+
+int mimic_task_find(const char* name) {
+    for (uint8_t i = 1; i < MIMIC_MAX_TASKS; i++) {
+        MimicTCB* t = &kernel.tasks[i];
+        if (t->state != TASK_STATE_FREE && strncmp(t->name, name, 15) == 0) {
+            return i;
+        }
+    }
+    return MIMIC_ERR_NOENT;
+}
+
 void mimic_task_kill(uint32_t task_id) {
     if (task_id == 0 || task_id >= MIMIC_MAX_TASKS) return;
     
     MimicTCB* task = &kernel.tasks[task_id];
     if (task->state == TASK_STATE_FREE) return;
     
-    // Free all task memory
+    // Silence interrupt sources, stop DMA, PIO and channel endpoints
+    // before the memory they point into goes away
+    mimic_mpu_release_task(task_id);
+    mimic_irq_release_task(task_id);
+    mimic_io_release_task(task_id);
+    mimic_pio_release_task(task_id);
+    mimic_chan_release_task(task_id);
+    mimic_out_release_task(task_id);
+    mimic_compile_release_task(task_id);
     mimic_task_free_all_memory(task_id);
     
     // Mark as free
@@ -478,6 +596,7 @@ static void scheduler_tick(void) {
     
     uint64_t now_us = time_us_64();
     kernel.tick_count++;
+    mimic_perf_inc(MIMIC_PERF_SCHED_TICKS);
     
     critical_section_enter_blocking(&kernel.sched_cs);
     
@@ -503,10 +622,13 @@ static void scheduler_tick(void) {
     }
     
     if (next->id != kernel.current_task) {
-        kernel.tasks[kernel.current_task].state = TASK_STATE_READY;
+        MimicTCB* prev = &kernel.tasks[kernel.current_task];
+        if (prev->state == TASK_STATE_RUNNING) prev->state = TASK_STATE_READY;
+        mimic_trace(MIMIC_TRACE_SWITCH, kernel.current_task, next->id);
         kernel.current_task = next->id;
         next->state = TASK_STATE_RUNNING;
-        kernel.context_switches++;
+        mimic_mpu_switch(next);
+        mimic_perf_inc(MIMIC_PERF_SCHED_SWITCHES);
     }
     
     kernel.last_schedule_us = now_us;
@@ -514,14 +636,220 @@ static void scheduler_tick(void) {
     critical_section_exit(&kernel.sched_cs);
 }
 
+// ============================================================================
+// KERNEL THREADS
+// ============================================================================
+
+// Kernel threads have no user memory image; the scheduler calls their
+// step function directly, one slice at a time. Long-running work (the
+// background compiler) additionally calls mimic_kthread_preempt_point()
+// at fine-grained boundaries so higher-priority threads still get served
+// while a slice is in progress.
+
+static uint32_t kthread_slice_start_us;
+static uint8_t  kthread_depth;
+
+static void kthread_run_slice(MimicTCB* t) {
+    uint32_t saved_start = kthread_slice_start_us;
+    uint32_t start = time_us_32();
+    kthread_slice_start_us = start;
+    kthread_depth++;
+    
+    uint8_t saved_task = mimic_trace_get_task();
+    mimic_trace_set_task(t->id);
+    mimic_trace(MIMIC_TRACE_KTHREAD_BEGIN, t->id, 0);
+    
+    int ret = t->kthread(t->kthread_arg);
+    
+    mimic_trace(MIMIC_TRACE_KTHREAD_END, t->id, ret);
+    mimic_trace_set_task(saved_task);
+    
+    kthread_depth--;
+    kthread_slice_start_us = saved_start;
+    
+    uint32_t elapsed = time_us_32() - start;
+    t->total_time_us += elapsed;
+    mimic_perf_inc(MIMIC_PERF_KTHREAD_SLICES);
+    mimic_perf_add(MIMIC_PERF_KTHREAD_US, elapsed);
+    
+    if (ret != MIMIC_ERR_BUSY) {
+        mimic_task_kill(t->id);
+    }
+}
+
+int mimic_kthread_spawn(const char* name, uint8_t priority,
+                        MimicKThreadFn fn, void* arg) {
+    if (!fn) return MIMIC_ERR_INVAL;
+    
+    MimicTCB* task = task_alloc();
+    if (!task) return MIMIC_ERR_NOMEM;
+    
+    strncpy(task->name, name, 15);
+    task->name[15] = '\0';
+    task->priority = priority;
+    task->kthread = fn;
+    task->kthread_arg = arg;
+    task->start_time = time_us_64() / 1000;
+    task->state = TASK_STATE_READY;
+    
+    return (int)task->id;
+}
+
+void mimic_kthread_sleep(uint32_t ms) {
+    MimicTCB* task = &kernel.tasks[kernel.current_task];
+    if (!task->kthread) return;
+    
+    // Just park the TCB; the caller returns MIMIC_ERR_BUSY right after
+    // and the scheduler wakes it once wake_time passes.
+    task->wake_time = (time_us_64() / 1000) + ms;
+    task->state = TASK_STATE_SLEEPING;
+}
+
+bool mimic_kthread_should_yield(void) {
+    // Kernel threads only live on core 0; work offloaded to core 1 runs
+    // to completion.
+    if (kthread_depth == 0 || get_core_num() != 0) return false;
+    return (time_us_32() - kthread_slice_start_us) >= MIMIC_KTHREAD_SLICE_US;
+}
+
+void mimic_kthread_preempt_point(void) {
+    // User interrupts don't wait for the slice budget
+    if (mimic_irq_pending()) mimic_irq_dispatch();
+    
+    if (!mimic_kthread_should_yield()) return;
+    
+    // Only threads strictly more urgent than the caller may cut in, and
+    // never one that is already somewhere up the call stack (RUNNING).
+    uint8_t prio = kernel.tasks[kernel.current_task].priority;
+    uint8_t saved_current = kernel.current_task;
+    
+    for (uint8_t i = 1; i < MIMIC_MAX_TASKS; i++) {
+        MimicTCB* t = &kernel.tasks[i];
+        if (t->kthread && t->state == TASK_STATE_READY && t->priority < prio) {
+            kernel.current_task = i;
+            t->state = TASK_STATE_RUNNING;
+            mimic_perf_inc(MIMIC_PERF_SCHED_SWITCHES);
+            mimic_perf_inc(MIMIC_PERF_KTHREAD_PREEMPTS);
+            kthread_run_slice(t);
+            if (t->state == TASK_STATE_RUNNING) t->state = TASK_STATE_READY;
+        }
+    }
+    
+    kernel.current_task = saved_current;
+    kthread_slice_start_us = time_us_32();
+}
+
+void mimic_kernel_poll(void) {
+    // Handlers and I/O completions first, so tasks they wake are seen by
+    // this tick
+    mimic_irq_dispatch();
+    mimic_io_poll();
+    mimic_out_flush();
+    
+    // A task that faulted inside a call is killed here, outside it
+    uint32_t fault_pc;
+    int faulted = mimic_mpu_take_fault(&fault_pc);
+    if (faulted > 0) {
+        printf("[MPU] Task %d faulted (pc 0x%08lx), killed\n", faulted, (unsigned long)fault_pc);
+        mimic_task_kill(faulted);
+    }
+    
+    scheduler_tick();
+    
+    MimicTCB* current = &kernel.tasks[kernel.current_task];
+    if (current->kthread && current->state == TASK_STATE_RUNNING) {
+        kthread_run_slice(current);
+        return;
+    }
+    
+    // User tasks are not dispatched from this loop (no context switch
+    // yet), so hand the rest of the tick to the most urgent ready kthread.
+    MimicTCB* best = NULL;
+    for (uint8_t i = 1; i < MIMIC_MAX_TASKS; i++) {
+        MimicTCB* t = &kernel.tasks[i];
+        if (t->kthread && t->state == TASK_STATE_READY &&
+            (!best || t->priority < best->priority)) {
+            best = t;
+        }
+    }
+    if (best) {
+        uint8_t saved_current = kernel.current_task;
+        kernel.current_task = best->id;
+        best->state = TASK_STATE_RUNNING;
+        kthread_run_slice(best);
+        if (best->state == TASK_STATE_RUNNING) best->state = TASK_STATE_READY;
+        kernel.current_task = saved_current;
+    }
+}
+
+// ============================================================================
+// CORE 1 OFFLOAD
+// ============================================================================
+
+// Core 1 sits in a loop popping (fn, arg) pairs from the inter-core FIFO
+// and pushing back the result. One job at a time; core 0 polls.
+// The loop and its FIFO accesses live in RAM so that between jobs core 1
+// never touches XIP, which lets core 0 erase flash without a lockout.
+
+static uint32_t ALIGNED(8) core1_stack[MIMIC_CORE1_STACK / 4];
+static bool core1_started;
+static bool core1_busy;
+
+static uint32_t __not_in_flash_func(core1_fifo_pop)(void) {
+    while (!(sio_hw->fifo_st & SIO_FIFO_ST_VLD_BITS)) __wfe();
+    return sio_hw->fifo_rd;
+}
+
+static void __not_in_flash_func(core1_fifo_push)(uint32_t value) {
+    while (!(sio_hw->fifo_st & SIO_FIFO_ST_RDY_BITS)) tight_loop_contents();
+    sio_hw->fifo_wr = value;
+    __sev();
+}
+
+static void __not_in_flash_func(core1_main)(void) {
+    while (true) {
+        MimicKThreadFn fn = (MimicKThreadFn)core1_fifo_pop();
+        void* arg = (void*)core1_fifo_pop();
+        core1_fifo_push((uint32_t)fn(arg));
+    }
+}
+
+int mimic_core1_submit(MimicKThreadFn fn, void* arg) {
+    if (!fn) return MIMIC_ERR_INVAL;
+    if (core1_busy) return MIMIC_ERR_BUSY;
+    
+    if (!core1_started) {
+        multicore_launch_core1_with_stack(core1_main, core1_stack, sizeof(core1_stack));
+        core1_started = true;
+    }
+    
+    core1_busy = true;
+    multicore_fifo_push_blocking((uint32_t)fn);
+    multicore_fifo_push_blocking((uint32_t)arg);
+    return MIMIC_OK;
+}
+
+int mimic_core1_poll(int* result) {
+    if (!core1_busy) return MIMIC_ERR_INVAL;
+    if (!multicore_fifo_rvalid()) return MIMIC_ERR_BUSY;
+    
+    *result = (int)multicore_fifo_pop_blocking();
+    core1_busy = false;
+    return MIMIC_OK;
+}
+
+bool mimic_core1_idle(void) {
+    return !core1_busy;
+}
+
 // ============================================================================
 // SYSCALL HANDLERS
 // ============================================================================
 
 int32_t mimic_syscall(uint32_t num, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
-    (void)a3;
-    kernel.syscalls_handled++;
+    mimic_perf_inc(MIMIC_PERF_SYSCALLS);
     uint32_t task_id = kernel.current_task;
+    mimic_trace(MIMIC_TRACE_SYSCALL, num, a0);
     
     switch (num) {
         case MIMIC_SYS_EXIT:
@@ -546,16 +874,23 @@ int32_t mimic_syscall(uint32_t num, uint32_t a0, uint32_t a1, uint32_t a2, uint3
             mimic_ufree(task_id, (void*)a0);
             return 0;
             
-        case MIMIC_SYS_PUTCHAR:
-            putchar(a0);
-            return a0;
+        case MIMIC_SYS_PUTCHAR: {
+            char c = a0;
+            return mimic_out_write(task_id, &c, 1) == 1 ? (int32_t)(a0 & 0xFF) : -1;
+        }
             
         case MIMIC_SYS_GETCHAR:
+            mimic_out_flush_task(task_id);
             return getchar();
             
         case MIMIC_SYS_PUTS:
-            printf("%s", (const char*)a0);
-            return 0;
+            return mimic_out_write(task_id, (const char*)a0, strlen((const char*)a0));
+            
+        case MIMIC_SYS_OUT_WRITE:
+            return mimic_out_write(task_id, (const void*)a0, a1);
+            
+        case MIMIC_SYS_OUT_MODE:
+            return mimic_out_set_mode(task_id, a0);
             
         case MIMIC_SYS_GPIO_INIT:
             gpio_init(a0);
@@ -578,6 +913,34 @@ int32_t mimic_syscall(uint32_t num, uint32_t a0, uint32_t a1, uint32_t a2, uint3
             else gpio_disable_pulls(a0);
             return 0;
             
+        case MIMIC_SYS_PWM_INIT:
+        case MIMIC_SYS_PWM_SET_WRAP:
+        case MIMIC_SYS_PWM_SET_LEVEL:
+        case MIMIC_SYS_PWM_ENABLE:
+        case MIMIC_SYS_ADC_INIT:
+        case MIMIC_SYS_ADC_SELECT:
+        case MIMIC_SYS_ADC_READ:
+        case MIMIC_SYS_ADC_TEMP:
+        case MIMIC_SYS_ADC_STREAM:
+        case MIMIC_SYS_ADC_POS:
+        case MIMIC_SYS_ADC_STOP:
+        case MIMIC_SYS_SPI_INIT:
+        case MIMIC_SYS_SPI_WRITE:
+        case MIMIC_SYS_SPI_READ:
+        case MIMIC_SYS_SPI_TRANSFER:
+        case MIMIC_SYS_I2C_INIT:
+        case MIMIC_SYS_I2C_WRITE:
+        case MIMIC_SYS_I2C_READ:
+        case MIMIC_SYS_IO_WAIT:
+            return mimic_io_syscall(task_id, num, a0, a1, a2, a3);
+            
+        case MIMIC_SYS_PIO_CLAIM:
+        case MIMIC_SYS_PIO_LOAD:
+        case MIMIC_SYS_PIO_PUT:
+        case MIMIC_SYS_PIO_GET:
+        case MIMIC_SYS_PIO_RELEASE:
+            return mimic_pio_syscall(task_id, num, a0, a1, a2);
+            
         case MIMIC_SYS_OPEN:
             return mimic_fopen((const char*)a0, a1);
             
@@ -593,6 +956,48 @@ int32_t mimic_syscall(uint32_t num, uint32_t a0, uint32_t a1, uint32_t a2, uint3
         case MIMIC_SYS_SEEK:
             return mimic_fseek(a0, a1, a2);
             
+        case MIMIC_SYS_CHAN_OPEN:
+            return mimic_chan_open(task_id, (const char*)a0, a1, a2);
+            
+        case MIMIC_SYS_CHAN_MAP:
+            return (int32_t)mimic_chan_map(task_id, a0);
+            
+        case MIMIC_SYS_CHAN_WAIT:
+            return mimic_chan_wait(task_id, a0, a1);
+            
+        case MIMIC_SYS_CHAN_NOTIFY:
+            return mimic_chan_notify(task_id, a0);
+            
+        case MIMIC_SYS_CHAN_CLOSE:
+            return mimic_chan_close(task_id, a0);
+            
+        case MIMIC_SYS_IRQ_ATTACH: {
+            // Handlers must point into the caller's own code
+            MimicTCB* task = &kernel.tasks[task_id];
+            uint32_t text = task->mem.base + task->mem.text_start;
+            if (a2 && (a2 < text || a2 >= text + task->mem.text_size)) {
+                return MIMIC_ERR_INVAL;
+            }
+            return mimic_irq_attach(task_id, a0, a1, a2);
+        }
+            
+        case MIMIC_SYS_IRQ_DETACH:
+            return mimic_irq_detach(task_id, a0);
+            
+        case MIMIC_SYS_IRQ_WAIT:
+            return mimic_irq_wait(task_id, a0, a1);
+            
+        case MIMIC_SYS_PERF_READ: {
+            if (a0 >= MIMIC_PERF_COUNT) return MIMIC_ERR_INVAL;
+            uint32_t* out = (uint32_t*)a1;
+            uint32_t n = 0;
+            while (n < a2 && a0 + n < MIMIC_PERF_COUNT) {
+                out[n] = mimic_perf_read(a0 + n);
+                n++;
+            }
+            return n;
+        }
+            
         default:
             return MIMIC_ERR_NOSYS;
     }
@@ -613,6 +1018,52 @@ void mimic_task_sleep(uint32_t ms) {
     scheduler_tick();
 }
 
+// Block the current task until mimic_task_wake(), or for at most
+// timeout_ms if that is non-zero.
+void mimic_task_block(uint32_t timeout_ms) {
+    if (kernel.current_task == 0) return;
+    
+    MimicTCB* task = &kernel.tasks[kernel.current_task];
+    if (timeout_ms) {
+        task->wake_time = (time_us_64() / 1000) + timeout_ms;
+        task->state = TASK_STATE_SLEEPING;
+    } else {
+        task->state = TASK_STATE_BLOCKED;
+    }
+    
+    scheduler_tick();
+}
+
+void mimic_task_wake(uint32_t task_id) {
+    if (task_id == 0 || task_id >= MIMIC_MAX_TASKS) return;
+    
+    MimicTCB* task = &kernel.tasks[task_id];
+    if (task->state == TASK_STATE_BLOCKED || task->state == TASK_STATE_SLEEPING) {
+        task->state = TASK_STATE_READY;
+    }
+}
+
+// Run a user function on behalf of a task (IRQ handlers). Syscalls it
+// makes are attributed to that task.
+int32_t mimic_task_call(uint32_t task_id, uint32_t fn, uint32_t a0, uint32_t a1) {
+    if (task_id == 0 || task_id >= MIMIC_MAX_TASKS || fn == 0) return MIMIC_ERR_INVAL;
+    
+    MimicTCB* task = &kernel.tasks[task_id];
+    if (task->state == TASK_STATE_FREE || task->kthread) return MIMIC_ERR_INVAL;
+    
+    uint8_t saved_current = kernel.current_task;
+    uint8_t saved_trace = mimic_trace_get_task();
+    kernel.current_task = task_id;
+    mimic_trace_set_task(task_id);
+    
+    // On the task's own stack, behind its guard
+    int32_t ret = mimic_mpu_call(task, fn, a0, a1);
+    
+    mimic_trace_set_task(saved_trace);
+    kernel.current_task = saved_current;
+    return ret;
+}
+
 void mimic_task_exit(int code) {
     (void)code;
     mimic_task_kill(kernel.current_task);
@@ -641,26 +1092,70 @@ float mimic_get_cpu_usage(void) {
 
 void mimic_dump_tasks(void) {
     printf("\n=== MIMIC TASKS ===\n");
-    printf("ID  NAME            STATE    PRI  MEM\n");
+    printf("ID  NAME            STATE    PRI  MEM     STACK\n");
     for (uint8_t i = 0; i < MIMIC_MAX_TASKS; i++) {
         MimicTCB* t = &kernel.tasks[i];
         if (t->state != TASK_STATE_FREE) {
             const char* state_str[] = {"FREE", "READY", "RUN", "BLOCK", "SLEEP", "ZOMB"};
-            printf("%2lu %-15s %-7s  %3d  %lu\n",
+            printf("%2lu %-15s %-7s  %3d  %-6lu  ",
                    (unsigned long)t->id, t->name, state_str[t->state], 
                    t->priority, (unsigned long)t->mem.total_size);
+            if (t->kthread || !MIMIC_STACK_PAINT) {
+                printf("-\n");
+            } else {
+                printf("%lu/%lu\n", (unsigned long)mimic_task_stack_peak(t),
+                       (unsigned long)t->mem.stack_size);
+            }
         }
     }
 }
 
+// Peak stack use per user task, with the stack_request that would still
+// leave MIMIC_STACK_MARGIN of headroom. Only meaningful once the task has
+// been through its deepest path.
+void mimic_dump_stacks(void) {
+#if MIMIC_STACK_PAINT
+    printf("\n=== TASK STACKS ===\n");
+    printf("ID  NAME            SIZE   PEAK   SUGGEST\n");
+    
+    uint32_t reclaimable = 0;
+    for (uint8_t i = 1; i < MIMIC_MAX_TASKS; i++) {
+        MimicTCB* t = &kernel.tasks[i];
+        if (t->state == TASK_STATE_FREE || t->kthread) continue;
+        
+        uint32_t peak = mimic_task_stack_peak(t);
+        printf("%2lu %-15s %5lu  %5lu  ", (unsigned long)t->id, t->name,
+               (unsigned long)t->mem.stack_size, (unsigned long)peak);
+        
+        if (peak == 0) {
+            printf("(not run yet)\n");
+            continue;
+        }
+        
+        uint32_t suggest = (peak + MIMIC_STACK_MARGIN + 7) & ~7u;
+        if (suggest < t->mem.stack_size) {
+            reclaimable += t->mem.stack_size - suggest;
+            printf("%5lu\n", (unsigned long)suggest);
+        } else {
+            printf("%5lu  (near limit)\n", (unsigned long)suggest);
+        }
+    }
+    
+    printf("Reclaimable: %lu bytes ('#pragma mimic stack N' and rebuild)\n",
+           (unsigned long)reclaimable);
+#else
+    printf("Stack profiling disabled (MIMIC_STACK_PAINT=0)\n");
+#endif
+}
+
 void mimic_dump_memory(void) {
     printf("\n=== MIMIC MEMORY ===\n");
     printf("Kernel: %lu / %d bytes free\n", (unsigned long)kernel.kernel_free, MIMIC_KERNEL_HEAP);
     printf("User:   %lu / %d bytes free\n", (unsigned long)kernel.user_free, MIMIC_USER_HEAP);
     printf("Allocs: %lu  Frees: %lu  Failed: %lu\n",
-           (unsigned long)kernel.total_allocs, 
-           (unsigned long)kernel.total_frees, 
-           (unsigned long)kernel.failed_allocs);
+           (unsigned long)(mimic_perf_read(MIMIC_PERF_KALLOCS) + mimic_perf_read(MIMIC_PERF_UALLOCS)),
+           (unsigned long)(mimic_perf_read(MIMIC_PERF_KFREES) + mimic_perf_read(MIMIC_PERF_UFREES)),
+           (unsigned long)mimic_perf_read(MIMIC_PERF_ALLOC_FAILS));
 }
 
 // ============================================================================
@@ -673,6 +1168,11 @@ void mimic_kernel_init(void) {
     
     mem_init();
     task_init();
+    mimic_mpu_init();
+    
+    // Scheduler is live from here on; the shell drives it through
+    // mimic_kernel_poll() while waiting for input.
+    kernel.running = true;
     
     printf("\n");
     printf("╔═══════════════════════════════════════════════╗\n");
@@ -684,7 +1184,8 @@ void mimic_kernel_init(void) {
 }
 
 void mimic_kernel_run(void) {
-    int err = mimic_fat32_mount();
+    // Boot has normally mounted already; a second mount re-inits the card
+    int err = mimic_fat32_mounted() ? MIMIC_OK : mimic_fat32_mount();
     if (err == MIMIC_OK) {
         kernel.fs_mounted = true;
         printf("[FS] SD card mounted\n");
@@ -697,12 +1198,7 @@ void mimic_kernel_run(void) {
     printf("[KERNEL] Running...\n\n");
     
     while (kernel.running) {
-        scheduler_tick();
-        
-        MimicTCB* current = &kernel.tasks[kernel.current_task];
-        if (current->id != 0 && current->state == TASK_STATE_RUNNING) {
-            // Execute task - in real implementation would do context switch
-        }
+        mimic_kernel_poll();
         
         if (kernel.current_task == 0) {
             __wfi();
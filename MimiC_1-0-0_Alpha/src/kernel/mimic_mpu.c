@@ -0,0 +1,431 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC MPU - Stack guards and execute-never task data                     ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  Regions follow the current task; overflows fault instead of corrupting   ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * Whenever the scheduler switches tasks, or the kernel calls into user
+ * code, the MPU is loaded with the task's layout: a guard region right
+ * below its stack and execute-never regions from .data to the top of the
+ * image. The kernel itself runs on the default memory map (PRIVDEFENA),
+ * so there is no cost outside the switch.
+ * 
+ * User code runs in Thread mode on the process stack, pointed at the
+ * task's own stack; exceptions and syscalls stay on the main stack. A
+ * fault taken from the process stack can only be the task's, so the
+ * handler rewrites the return into a stub that unwinds back to
+ * mimic_mpu_call() with MIMIC_ERR_FAULT, and the kernel loop kills the
+ * task. Faults on the main stack go to the original HardFault handler.
+ * 
+ * ARMv6-M (RP2040): regions are naturally aligned powers of two, so the
+ * guard is 256 bytes and the execute-never span is covered greedily with
+ * what regions are left. A push that lands in the guard faults again while
+ * stacking the exception frame, and ARMv6-M has no way around that: the
+ * frame always goes below the faulting SP, into the guard. The core locks
+ * up rather than corrupting the heap, and the watchdog turns that into a
+ * reset. It is fed from a timer interrupt, so it only expires once core 0
+ * stops taking interrupts altogether; a task that computes for a long
+ * time without syscalls keeps running.
+ * 
+ * ARMv8-M (RP2350): regions are base/limit with 32-byte granules. There is
+ * no access-permission encoding that denies privileged reads, and user
+ * code runs privileged (syscalls are plain calls), so the guard is covered
+ * by two regions instead: an address that hits more than one region
+ * always faults. PSPLIM is set to the top of the guard as well, so an
+ * overflowing push raises a stack-limit UsageFault without writing below
+ * the limit and the task is killed cleanly.
+ */
+
+#include "pico/stdlib.h"
+#include "hardware/structs/mpu.h"
+#include "hardware/structs/scb.h"
+#include "hardware/exception.h"
+#include "hardware/sync.h"
+#include "hardware/watchdog.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "mimic.h"
+#include "mimic_perf.h"
+
+// ============================================================================
+// REGIONS
+// ============================================================================
+
+#define MPU_CTRL_ENABLE         (1u << 0)
+#define MPU_CTRL_PRIVDEFENA     (1u << 2)
+
+#if MIMIC_TARGET_RP2350
+  #define MPU_XN_REGIONS        2       // Below and above the guard
+  #define MPU_GUARD_REGION      2
+  #define MPU_GUARD_OVERLAP     3       // Same span: any access faults
+  #define MPU_REGIONS_USED      4
+  
+  #define MPU_RBAR_XN           (1u << 0)
+  #define MPU_RBAR_AP_RW        (1u << 1)   // Read/write, any privilege
+  #define MPU_RBAR_AP_RO_PRIV   (2u << 1)   // Read-only, privileged
+  #define MPU_RLAR_EN           (1u << 0)
+  #define MPU_MAIR_NORMAL_WB    0xFF        // Attribute 0
+  
+  #define SHCSR_MEMFAULTENA     (1u << 16)
+  #define SHCSR_USGFAULTENA     (1u << 18)
+#else
+  #define MPU_XN_REGIONS        6       // Greedy power-of-two cover
+  #define MPU_GUARD_REGION      6       // Highest used: wins over XN cover
+  
+  #define MPU_RASR_XN           (1u << 28)
+  #define MPU_RASR_AP_NONE      (0u << 24)
+  #define MPU_RASR_AP_RW        (3u << 24)
+  #define MPU_RASR_NORMAL       ((1u << 17) | (1u << 16))  // C, B
+  #define MPU_RASR_ENABLE       (1u << 0)
+  #define MPU_MIN_REGION        256
+  #define MPU_REGIONS_USED      (MPU_GUARD_REGION + 1)
+  #define MPU_WATCHDOG_MS       2000    // Core 0 deaf to interrupts this long
+#endif
+
+static struct {
+    bool                present;
+    const MimicTCB*     armed;          // Layout currently in the MPU
+    const MimicTCB*     calling;        // Innermost mimic_mpu_call()
+    uint32_t            fault_task;     // Pending kill, 0 = none
+    uint32_t            fault_pc;
+    uint32_t            regions;        // DREGION, for the boot report
+    bool                watchdog_reset; // Last reset came from the watchdog
+} mpu;
+
+// Read by the fault path and the call trampoline
+static uint32_t __attribute__((used)) mpu_call_sp;
+static exception_handler_t __attribute__((used)) mpu_prev_handler;
+
+static void mpu_clear_region(uint32_t n) {
+    mpu_hw->rnr = n;
+#if MIMIC_TARGET_RP2350
+    mpu_hw->rlar = 0;
+#else
+    mpu_hw->rasr = 0;
+#endif
+}
+
+#if MIMIC_TARGET_RP2350
+
+static void mpu_set_region(uint32_t n, uintptr_t lo, uintptr_t hi, uint32_t access) {
+    if (hi <= lo) {
+        mpu_clear_region(n);
+        return;
+    }
+    mpu_hw->rnr = n;
+    mpu_hw->rbar = (lo & ~31u) | access;
+    mpu_hw->rlar = ((hi - 1) & ~31u) | MPU_RLAR_EN;
+}
+
+static void mpu_load(const MimicTCB* t) {
+    uintptr_t base = t->mem.base;
+    uintptr_t guard = base + t->mem.guard_start;
+    uintptr_t data = (base + t->mem.data_start + 31) & ~31u;
+    uintptr_t top = (base + t->mem.stack_top) & ~31u;
+    
+    mpu_set_region(0, data, guard, MPU_RBAR_XN | MPU_RBAR_AP_RW);
+    mpu_set_region(1, guard + MIMIC_STACK_GUARD, top, MPU_RBAR_XN | MPU_RBAR_AP_RW);
+    mpu_set_region(MPU_GUARD_REGION, guard, guard + MIMIC_STACK_GUARD,
+                   MPU_RBAR_XN | MPU_RBAR_AP_RO_PRIV);
+    mpu_set_region(MPU_GUARD_OVERLAP, guard, guard + MIMIC_STACK_GUARD,
+                   MPU_RBAR_XN | MPU_RBAR_AP_RO_PRIV);
+}
+
+#else
+
+static void mpu_set_region(uint32_t n, uintptr_t addr, uint32_t size, uint32_t access) {
+    uint32_t size_field = 31 - __builtin_clz(size) - 1;    // 2^(SIZE+1) bytes
+    mpu_hw->rnr = n;
+    mpu_hw->rbar = addr;
+    mpu_hw->rasr = access | MPU_RASR_NORMAL | (size_field << 1) | MPU_RASR_ENABLE;
+}
+
+static void mpu_load(const MimicTCB* t) {
+    uintptr_t base = t->mem.base;
+    uintptr_t lo = (base + t->mem.data_start + MPU_MIN_REGION - 1) & ~(MPU_MIN_REGION - 1);
+    uintptr_t hi = (base + t->mem.stack_top) & ~(MPU_MIN_REGION - 1);
+    
+    // Largest aligned block at each step; unaligned edges stay executable
+    uint32_t n = 0;
+    while (lo < hi && n < MPU_XN_REGIONS) {
+        uint32_t size = lo & -lo;
+        while (size > hi - lo) size >>= 1;
+        mpu_set_region(n++, lo, size, MPU_RASR_XN | MPU_RASR_AP_RW);
+        lo += size;
+    }
+    while (n < MPU_XN_REGIONS) mpu_clear_region(n++);
+    
+    mpu_set_region(MPU_GUARD_REGION, base + t->mem.guard_start, MIMIC_STACK_GUARD,
+                   MPU_RASR_XN | MPU_RASR_AP_NONE);
+}
+
+#endif
+
+static void mpu_arm(const MimicTCB* t) {
+    if (!mpu.present || t == mpu.armed) return;
+    
+    if (t) {
+        mpu_load(t);
+    } else {
+        for (uint32_t n = 0; n < MPU_REGIONS_USED; n++) mpu_clear_region(n);
+    }
+    __dsb();
+    __isb();
+    
+    mpu.armed = t;
+    mimic_perf_inc(MIMIC_PERF_MPU_SWITCHES);
+}
+
+// ============================================================================
+// USER CALLS
+// ============================================================================
+
+// int32_t call_on_process_stack(a0, a1, fn, sp): run fn(a0, a1) in Thread
+// mode on the given stack. Saves r4-r11 on the main stack so the fault
+// path can unwind through mpu_fault_exit with the same epilogue.
+static int32_t __attribute__((naked, noinline))
+call_on_process_stack(uint32_t a0, uint32_t a1, uint32_t fn, uint32_t sp) {
+    __asm volatile(
+        "push {r3, r4, r5, r6, r7, lr}\n"
+        "mov r4, r8\n"
+        "mov r5, r9\n"
+        "mov r6, r10\n"
+        "mov r7, r11\n"
+        "push {r4, r5, r6, r7}\n"
+        "ldr r4, =mpu_call_sp\n"
+        "mov r5, sp\n"
+        "str r5, [r4]\n"
+        "msr psp, r3\n"
+        "mrs r4, control\n"
+        "movs r5, #2\n"                 // SPSEL: Thread mode uses PSP
+        "orrs r4, r5\n"
+        "msr control, r4\n"
+        "isb\n"
+        "blx r2\n"
+        "mrs r4, control\n"
+        "movs r5, #2\n"
+        "bics r4, r5\n"
+        "msr control, r4\n"
+        "isb\n"
+        "pop {r4, r5, r6, r7}\n"
+        "mov r8, r4\n"
+        "mov r9, r5\n"
+        "mov r10, r6\n"
+        "mov r11, r7\n"
+        "pop {r3, r4, r5, r6, r7, pc}\n"
+        ".ltorg\n"
+    );
+}
+
+// Where a faulting call resumes: back on the main stack at mpu_call_sp,
+// r0 already holds MIMIC_ERR_FAULT
+static void __attribute__((naked, used)) mpu_fault_exit(void) {
+    __asm volatile(
+        "pop {r4, r5, r6, r7}\n"
+        "mov r8, r4\n"
+        "mov r9, r5\n"
+        "mov r10, r6\n"
+        "mov r11, r7\n"
+        "pop {r3, r4, r5, r6, r7, pc}\n"
+    );
+}
+
+#if MIMIC_TARGET_RP2350
+static inline uint32_t mpu_get_psplim(void) {
+    uint32_t v;
+    __asm volatile("mrs %0, psplim" : "=r"(v));
+    return v;
+}
+
+static inline void mpu_set_psplim(uint32_t v) {
+    __asm volatile("msr psplim, %0" :: "r"(v));
+}
+#endif
+
+int32_t mimic_mpu_call(const MimicTCB* task, uint32_t fn, uint32_t a0, uint32_t a1) {
+    if (task->id == mpu.fault_task) return MIMIC_ERR_FAULT;
+    
+    // Thumb bit, in case the address came from a plain label
+    fn |= 1;
+    
+    // Handler mode can't switch to the process stack; this only happens
+    // for calls made from inside another call's syscall
+    if (__get_current_exception() != 0 || mpu.calling) {
+        int32_t (*func)(uint32_t, uint32_t) = (int32_t (*)(uint32_t, uint32_t))fn;
+        return func(a0, a1);
+    }
+    
+    const MimicTCB* saved_armed = mpu.armed;
+    uint32_t saved_sp = mpu_call_sp;
+    
+    mpu_arm(task);
+    mpu.calling = task;
+#if MIMIC_TARGET_RP2350
+    uint32_t saved_limit = mpu_get_psplim();
+    mpu_set_psplim(task->mem.base + task->mem.guard_start + MIMIC_STACK_GUARD);
+#endif
+    
+    int32_t ret = call_on_process_stack(a0, a1, fn, (task->mem.base + task->mem.stack_top) & ~7u);
+    
+#if MIMIC_TARGET_RP2350
+    mpu_set_psplim(saved_limit);
+#endif
+    mpu.calling = NULL;
+    mpu_call_sp = saved_sp;
+    mpu_arm(saved_armed);
+    return ret;
+}
+
+// ============================================================================
+// FAULTS
+// ============================================================================
+
+// Called with the process-stack frame; true if the fault belongs to the
+// task being called, in which case the regions are already disarmed
+static bool __attribute__((used)) mpu_fault(const uint32_t* frame) {
+    const MimicTCB* t = mpu.calling;
+    if (!t) return false;
+    
+    uintptr_t lo = t->mem.base + t->mem.guard_start + MIMIC_STACK_GUARD;
+    uintptr_t hi = t->mem.base + t->mem.stack_top;
+    uintptr_t f = (uintptr_t)frame;
+    mpu.fault_pc = (f >= lo && f + 32 <= hi) ? frame[6] : 0;
+    
+#if MIMIC_TARGET_RP2350
+    scb_hw->cfsr = scb_hw->cfsr;    // Write-one-to-clear
+#endif
+    
+    mpu.fault_task = t->id;
+    mpu.calling = NULL;
+    mpu_arm(NULL);
+    mimic_perf_inc(MIMIC_PERF_MPU_FAULTS);
+    return true;
+}
+
+#define MPU_STR_(x) #x
+#define MPU_STR(x)  MPU_STR_(x)
+
+// Only faults taken from the process stack (EXC_RETURN bit 2) are a
+// task's. For those, build a fresh basic frame at mpu_call_sp that
+// returns to mpu_fault_exit in Thread mode on the main stack.
+static void __attribute__((naked)) mpu_fault_isr(void) {
+    __asm volatile(
+        "mov r1, lr\n"
+        "movs r2, #4\n"
+        "tst r1, r2\n"
+        "beq 1f\n"
+        "mrs r0, psp\n"
+        "push {r1, r2}\n"
+        "bl mpu_fault\n"
+        "pop {r1, r2}\n"
+        "cmp r0, #0\n"
+        "beq 1f\n"
+        "ldr r0, =mpu_call_sp\n"
+        "ldr r0, [r0]\n"
+        "subs r0, #32\n"
+        "ldr r3, =" MPU_STR(MIMIC_ERR_FAULT) "\n"
+        "str r3, [r0, #0]\n"            // r0
+        "ldr r3, =mpu_fault_exit\n"
+        "movs r2, #1\n"
+        "bics r3, r2\n"
+        "str r3, [r0, #24]\n"           // pc
+        "ldr r3, =0x01000000\n"
+        "str r3, [r0, #28]\n"           // xPSR: Thumb
+        "msr msp, r0\n"
+        "movs r2, #4\n"
+        "bics r1, r2\n"                 // Return on the main stack
+        "movs r2, #16\n"
+        "orrs r1, r2\n"                 // with a basic frame
+        "bx r1\n"
+        "1:\n"
+        "mov lr, r1\n"
+        "ldr r0, =mpu_prev_handler\n"
+        "ldr r0, [r0]\n"
+        "bx r0\n"
+        ".ltorg\n"
+    );
+}
+
+// ============================================================================
+// LOCKUP WATCHDOG
+// ============================================================================
+
+#if !MIMIC_TARGET_RP2350
+static repeating_timer_t mpu_watchdog_timer;
+
+static bool mpu_watchdog_feed(repeating_timer_t* rt) {
+    (void)rt;
+    watchdog_update();
+    return true;
+}
+#endif
+
+// ============================================================================
+// API
+// ============================================================================
+
+void mimic_mpu_init(void) {
+    // Runs before the console is up; mimic_mpu_report() tells the story
+#if !MIMIC_TARGET_RP2350
+    mpu.watchdog_reset = watchdog_caused_reboot();
+#endif
+    
+    // DREGION: 0 when the core was built without an MPU
+    mpu.regions = (mpu_hw->type >> 8) & 0xFF;
+    if (mpu.regions < MPU_REGIONS_USED) return;
+    mpu.present = true;
+    
+    for (uint32_t n = 0; n < MPU_REGIONS_USED; n++) mpu_clear_region(n);
+#if MIMIC_TARGET_RP2350
+    mpu_hw->mair[0] = (mpu_hw->mair[0] & ~0xFFu) | MPU_MAIR_NORMAL_WB;
+#endif
+    
+    // Anything the kernel doesn't handle still ends up where it used to
+    mpu_prev_handler = exception_get_vtable_handler(HARDFAULT_EXCEPTION);
+    exception_set_exclusive_handler(HARDFAULT_EXCEPTION, mpu_fault_isr);
+#if MIMIC_TARGET_RP2350
+    exception_set_exclusive_handler(MEMMANAGE_EXCEPTION, mpu_fault_isr);
+    exception_set_exclusive_handler(USAGEFAULT_EXCEPTION, mpu_fault_isr);
+    scb_hw->shcsr |= SHCSR_MEMFAULTENA | SHCSR_USGFAULTENA;
+#else
+    // The timer interrupt belongs to core 0, the core that runs tasks
+    watchdog_enable(MPU_WATCHDOG_MS, true);
+    add_repeating_timer_ms(MPU_WATCHDOG_MS / 4, mpu_watchdog_feed, NULL, &mpu_watchdog_timer);
+#endif
+    
+    mpu_hw->ctrl = MPU_CTRL_PRIVDEFENA | MPU_CTRL_ENABLE;
+    __dsb();
+    __isb();
+}
+
+void mimic_mpu_report(void) {
+    if (mpu.watchdog_reset) {
+        printf("[MPU] Reset by watchdog: a task overflowed its stack or hung\n");
+    }
+    if (!mpu.present) {
+        printf("[MPU] %lu regions, stack guards disabled\n", (unsigned long)mpu.regions);
+    }
+}
+
+void mimic_mpu_switch(const MimicTCB* task) {
+    // Kernel threads and the shell run on the default map
+    if (task && (task->id == 0 || task->kthread)) task = NULL;
+    if (!mpu.calling) mpu_arm(task);
+}
+
+int mimic_mpu_take_fault(uint32_t* pc) {
+    uint32_t id = mpu.fault_task;
+    if (id == 0) return 0;
+    
+    if (pc) *pc = mpu.fault_pc;
+    mpu.fault_task = 0;
+    return id;
+}
+
+void mimic_mpu_release_task(uint32_t task_id) {
+    // The task's memory is about to be handed out again
+    if (mpu.armed && mpu.armed->id == task_id) mpu_arm(NULL);
+}
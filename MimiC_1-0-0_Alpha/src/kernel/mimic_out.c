@@ -0,0 +1,195 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC Out - Buffered task console output                                 ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  Tasks fill per-task rings; the kernel loop drains them to stdio          ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * A syscall that prints only copies into the task's ring, so a task is
+ * not held up by the USB host until its ring fills. mimic_out_flush() runs from the kernel
+ * loop and hands each ring's contents to stdio in one call, bounded by
+ * the room left in the CDC transmit FIFO so it doesn't block either.
+ * Rings are served round-robin so one chatty task can't starve the rest.
+ * 
+ * Rings are allocated on a task's first write. Producer (syscalls) and
+ * consumer (kernel loop) both run on core 0, so no locking is needed.
+ */
+
+#include "pico/stdlib.h"
+
+#if LIB_PICO_STDIO_USB
+#include "pico/stdio_usb.h"
+#include "tusb.h"
+#endif
+
+#include <string.h>
+#include <stdio.h>
+
+#include "mimic.h"
+#include "mimic_perf.h"
+
+// ============================================================================
+// RINGS
+// ============================================================================
+
+typedef struct {
+    uint32_t    head;           // Bytes ever written
+    uint32_t    tail;           // Bytes ever drained
+    uint32_t    dropped;
+    uint8_t     mode;
+    char        data[MIMIC_OUT_BUF_SIZE];
+} MimicOutRing;
+
+static MimicOutRing* out_rings[MIMIC_MAX_TASKS];
+static uint32_t out_next;      // Round-robin start for the next flush
+
+static MimicOutRing* out_ring(uint32_t task_id) {
+    MimicOutRing* ring = out_rings[task_id];
+    if (ring) return ring;
+    
+    ring = mimic_kmalloc(sizeof(MimicOutRing));
+    if (!ring) return NULL;
+    memset(ring, 0, sizeof(MimicOutRing));
+    ring->mode = MIMIC_OUT_BLOCK;
+    out_rings[task_id] = ring;
+    return ring;
+}
+
+// Bytes the console can take right now without blocking
+static uint32_t out_room(void) {
+#if LIB_PICO_STDIO_USB
+    // With no host attached the SDK discards output anyway
+    if (!stdio_usb_connected()) return UINT32_MAX;
+    return tud_cdc_write_available();
+#else
+    return UINT32_MAX;
+#endif
+}
+
+// Hand up to max bytes of the ring to stdio; returns bytes written
+static uint32_t out_drain(MimicOutRing* ring, uint32_t max) {
+    uint32_t pending = ring->head - ring->tail;
+    if (pending > max) pending = max;
+    
+    uint32_t written = 0;
+    while (written < pending) {
+        uint32_t start = ring->tail & (MIMIC_OUT_BUF_SIZE - 1);
+        uint32_t run = MIMIC_OUT_BUF_SIZE - start;
+        if (run > pending - written) run = pending - written;
+        
+        stdio_put_string(&ring->data[start], run, false, true);
+        ring->tail += run;
+        written += run;
+    }
+    return written;
+}
+
+// Copy as much of buf as fits; returns bytes taken
+static uint32_t out_fill(MimicOutRing* ring, const char* buf, uint32_t len) {
+    uint32_t room = MIMIC_OUT_BUF_SIZE - (ring->head - ring->tail);
+    uint32_t n = len < room ? len : room;
+    
+    for (uint32_t done = 0; done < n; ) {
+        uint32_t start = ring->head & (MIMIC_OUT_BUF_SIZE - 1);
+        uint32_t run = MIMIC_OUT_BUF_SIZE - start;
+        if (run > n - done) run = n - done;
+        
+        memcpy(&ring->data[start], buf + done, run);
+        ring->head += run;
+        done += run;
+    }
+    mimic_perf_add(MIMIC_PERF_OUT_BYTES, n);
+    return n;
+}
+
+// ============================================================================
+// API
+// ============================================================================
+
+int mimic_out_write(uint32_t task_id, const void* buf, uint32_t len) {
+    if (!buf && len) return MIMIC_ERR_INVAL;
+    
+    // The shell and kernel threads print directly
+    MimicOutRing* ring = task_id && task_id < MIMIC_MAX_TASKS ? out_ring(task_id) : NULL;
+    if (!ring) {
+        stdio_put_string(buf, len, false, true);
+        return len;
+    }
+    
+    const char* src = buf;
+    uint32_t done = out_fill(ring, src, len);
+    
+    // Nothing else runs while a task is in a syscall, so BLOCK drains its
+    // own ring here until the rest fits or the console stops taking data
+    if (done < len && ring->mode == MIMIC_OUT_BLOCK) {
+        mimic_perf_inc(MIMIC_PERF_OUT_STALLS);
+        uint64_t progress_us = time_us_64();
+        
+        while (done < len && time_us_64() - progress_us < MIMIC_OUT_BLOCK_MS * 1000ull) {
+            if (out_drain(ring, out_room()) > 0) {
+                done += out_fill(ring, src + done, len - done);
+                progress_us = time_us_64();
+            } else {
+                sleep_us(100);
+            }
+        }
+    }
+    
+    if (done < len) {
+        ring->dropped += len - done;
+        mimic_perf_add(MIMIC_PERF_OUT_DROPPED, len - done);
+    }
+    return len;
+}
+
+int mimic_out_set_mode(uint32_t task_id, uint32_t mode) {
+    if (mode > MIMIC_OUT_DROP || task_id == 0 || task_id >= MIMIC_MAX_TASKS) {
+        return MIMIC_ERR_INVAL;
+    }
+    
+    MimicOutRing* ring = out_ring(task_id);
+    if (!ring) return MIMIC_ERR_NOMEM;
+    
+    int old = ring->mode;
+    ring->mode = mode;
+    return old;
+}
+
+void mimic_out_flush(void) {
+    uint32_t room = out_room();
+    
+    for (uint32_t i = 0; i < MIMIC_MAX_TASKS && room > 0; i++) {
+        uint32_t id = (out_next + i) % MIMIC_MAX_TASKS;
+        MimicOutRing* ring = out_rings[id];
+        if (!ring || ring->head == ring->tail) continue;
+        
+        uint32_t n = out_drain(ring, room);
+        if (room != UINT32_MAX) room -= n;
+        mimic_perf_inc(MIMIC_PERF_OUT_FLUSHES);
+        
+        out_next = id + 1;
+    }
+}
+
+void mimic_out_flush_task(uint32_t task_id) {
+    if (task_id == 0 || task_id >= MIMIC_MAX_TASKS) return;
+    
+    // A prompt must be on screen before its task waits for the answer
+    MimicOutRing* ring = out_rings[task_id];
+    if (ring && ring->head != ring->tail) {
+        out_drain(ring, UINT32_MAX);
+        mimic_perf_inc(MIMIC_PERF_OUT_FLUSHES);
+    }
+}
+
+void mimic_out_release_task(uint32_t task_id) {
+    if (task_id == 0 || task_id >= MIMIC_MAX_TASKS) return;
+    
+    MimicOutRing* ring = out_rings[task_id];
+    if (!ring) return;
+    
+    // Last words are worth a short wait on the console
+    out_drain(ring, UINT32_MAX);
+    mimic_kfree(ring);
+    out_rings[task_id] = NULL;
+}
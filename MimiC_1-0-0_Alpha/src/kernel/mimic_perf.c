@@ -0,0 +1,101 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC Perf - Counter registry                                            ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  Counting is inline in mimic_perf.h; this file owns storage and names     ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ */
+
+#include <string.h>
+
+#include "mimic.h"
+#include "mimic_perf.h"
+
+uint32_t mimic_perf_counters[MIMIC_CORE_COUNT][MIMIC_PERF_COUNT];
+
+static const char* const perf_names[MIMIC_PERF_COUNT] = {
+    [MIMIC_PERF_SCHED_TICKS]        = "sched.ticks",
+    [MIMIC_PERF_SCHED_SWITCHES]     = "sched.switches",
+    [MIMIC_PERF_KTHREAD_SLICES]     = "sched.kthread_slices",
+    [MIMIC_PERF_KTHREAD_US]         = "sched.kthread_us",
+    [MIMIC_PERF_KTHREAD_PREEMPTS]   = "sched.preempts",
+    [MIMIC_PERF_TASKS_LOADED]       = "sched.tasks_loaded",
+    
+    [MIMIC_PERF_KALLOCS]            = "mem.kallocs",
+    [MIMIC_PERF_KFREES]             = "mem.kfrees",
+    [MIMIC_PERF_UALLOCS]            = "mem.uallocs",
+    [MIMIC_PERF_UFREES]             = "mem.ufrees",
+    [MIMIC_PERF_ALLOC_BYTES]        = "mem.alloc_bytes",
+    [MIMIC_PERF_ALLOC_FAILS]        = "mem.alloc_fails",
+    
+    [MIMIC_PERF_FS_CACHE_HITS]      = "fs.cache_hits",
+    [MIMIC_PERF_FS_CACHE_MISSES]    = "fs.cache_misses",
+    [MIMIC_PERF_FS_WRITEBACKS]      = "fs.writebacks",
+    
+    [MIMIC_PERF_SD_CMDS]            = "sd.cmds",
+    [MIMIC_PERF_SD_READS]           = "sd.reads",
+    [MIMIC_PERF_SD_WRITES]          = "sd.writes",
+    [MIMIC_PERF_SD_READ_US]         = "sd.read_us",
+    [MIMIC_PERF_SD_WRITE_US]        = "sd.write_us",
+    [MIMIC_PERF_SD_ERRORS]          = "sd.errors",
+    
+    [MIMIC_PERF_SYSCALLS]           = "sys.calls",
+    
+    [MIMIC_PERF_CC_JOBS]            = "cc.jobs",
+    [MIMIC_PERF_CC_TOKENS]          = "cc.tokens",
+    [MIMIC_PERF_CC_FUNCTIONS]       = "cc.functions",
+    [MIMIC_PERF_CC_BYTES]           = "cc.bytes",
+    [MIMIC_PERF_CC_ERRORS]          = "cc.errors",
+    
+    [MIMIC_PERF_IRQ_EVENTS]         = "irq.events",
+    [MIMIC_PERF_IRQ_DROPPED]        = "irq.dropped",
+    [MIMIC_PERF_IRQ_LATENCY_US]     = "irq.latency_us",
+    
+    [MIMIC_PERF_IO_XFERS]           = "io.xfers",
+    [MIMIC_PERF_IO_BYTES]           = "io.bytes",
+    [MIMIC_PERF_IO_ERRORS]          = "io.errors",
+    
+    [MIMIC_PERF_OUT_BYTES]          = "out.bytes",
+    [MIMIC_PERF_OUT_DROPPED]        = "out.dropped",
+    [MIMIC_PERF_OUT_FLUSHES]        = "out.flushes",
+    [MIMIC_PERF_OUT_STALLS]         = "out.stalls",
+    
+    [MIMIC_PERF_MPU_SWITCHES]       = "mpu.switches",
+    [MIMIC_PERF_MPU_FAULTS]         = "mpu.faults",
+    
+    [MIMIC_PERF_IOSCHED_QUEUED]     = "iosched.queued",
+    [MIMIC_PERF_IOSCHED_MERGED]     = "iosched.merged",
+    [MIMIC_PERF_IOSCHED_DRAINS]     = "iosched.drains",
+    
+    [MIMIC_PERF_FS_ERASED]          = "fs.erased",
+    
+    [MIMIC_PERF_LOG_SECTORS]        = "log.sectors",
+    [MIMIC_PERF_LOG_DROPPED]        = "log.dropped",
+    
+    [MIMIC_PERF_FS_DIR_INDEXED]     = "fs.dir_indexed",
+};
+
+uint32_t mimic_perf_read(uint32_t id) {
+    if (id >= MIMIC_PERF_COUNT) return 0;
+    
+    uint32_t sum = 0;
+    for (uint32_t core = 0; core < MIMIC_CORE_COUNT; core++) {
+        sum += mimic_perf_counters[core][id];
+    }
+    return sum;
+}
+
+void mimic_perf_snapshot(uint32_t* values) {
+    for (uint32_t id = 0; id < MIMIC_PERF_COUNT; id++) {
+        values[id] = mimic_perf_read(id);
+    }
+}
+
+void mimic_perf_reset(void) {
+    memset(mimic_perf_counters, 0, sizeof(mimic_perf_counters));
+}
+
+const char* mimic_perf_name(uint32_t id) {
+    if (id >= MIMIC_PERF_COUNT || !perf_names[id]) return "?";
+    return perf_names[id];
+}
@@ -0,0 +1,290 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC PIO - User-loadable PIO programs                                   ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  State machine ownership and program memory tracked per task              ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * Programs travel in the task's own .mimi PIO section, so loading one
+ * needs no file access: PIO_LOAD copies it from the task image into the
+ * PIO's instruction memory. Two state machines of the same task running
+ * the same program on one PIO share a copy.
+ * 
+ * Everything here runs on core 0 from syscalls and mimic_task_kill(), so
+ * the tables need no lock; the SDK's claim bits arbitrate with any kernel
+ * code that uses PIO directly.
+ */
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "mimic.h"
+
+// ============================================================================
+// OWNERSHIP TABLES
+// ============================================================================
+
+#define PIO_MAX_PROGRAMS    8       // Loaded programs per PIO block
+#define PIO_SM_PER_BLOCK    4
+#define PIO_NO_PROGRAM      0xFF
+
+typedef struct {
+    uint8_t     task;           // Owner, 0 = free
+    uint8_t     prog;           // Slot in pio_progs, or PIO_NO_PROGRAM
+} MimicPioSm;
+
+typedef struct {
+    uint8_t     task;           // Owner, 0 = free slot
+    uint8_t     index;          // Program number in the task's PIO section
+    uint8_t     offset;         // Load address in instruction memory
+    uint8_t     length;
+    int8_t      origin;
+    uint8_t     refs;           // State machines running it
+} MimicPioProg;
+
+static MimicPioSm   pio_sms[NUM_PIOS][PIO_SM_PER_BLOCK];
+static MimicPioProg pio_progs[NUM_PIOS][PIO_MAX_PROGRAMS];
+
+static bool pio_sm_owned(uint32_t task_id, uint32_t id) {
+    return id < NUM_PIOS * PIO_SM_PER_BLOCK &&
+           pio_sms[id / PIO_SM_PER_BLOCK][id % PIO_SM_PER_BLOCK].task == task_id;
+}
+
+// ============================================================================
+// PROGRAMS
+// ============================================================================
+
+static const MimiPioProgram* pio_find_program(MimicTCB* task, uint32_t index) {
+    const uint8_t* p = (const uint8_t*)task->mem.base + task->mem.pio_start;
+    const uint8_t* end = p + task->mem.pio_size;
+    
+    while (p + sizeof(MimiPioProgram) <= end) {
+        const MimiPioProgram* prog = (const MimiPioProgram*)p;
+        uint32_t bytes = sizeof(MimiPioProgram) + prog->length * sizeof(uint16_t);
+        if (p + bytes > end) break;
+        if (index-- == 0) return prog;
+        p += bytes;
+    }
+    return NULL;
+}
+
+// Load (or share) a program; returns its slot or an error
+static int pio_get_program(uint32_t pio_index, MimicTCB* task, uint32_t index,
+                           const MimiPioProgram* desc) {
+    MimicPioProg* progs = pio_progs[pio_index];
+    int free_slot = -1;
+    
+    for (int i = 0; i < PIO_MAX_PROGRAMS; i++) {
+        if (progs[i].task == task->id && progs[i].index == index) {
+            progs[i].refs++;
+            return i;
+        }
+        if (!progs[i].task && free_slot < 0) free_slot = i;
+    }
+    if (free_slot < 0) return MIMIC_ERR_NOMEM;
+    
+    // The section may sit at an odd address in the image; the SDK reads
+    // instructions as halfwords.
+    uint16_t instr[MIMI_PIO_MAX_INSTR];
+    memcpy(instr, desc + 1, desc->length * sizeof(uint16_t));
+    
+    pio_program_t program = {
+        .instructions = instr,
+        .length = desc->length,
+        .origin = desc->origin,
+    };
+    
+    PIO pio = pio_get_instance(pio_index);
+    if (!pio_can_add_program(pio, &program)) return MIMIC_ERR_NOMEM;
+    
+    MimicPioProg* slot = &progs[free_slot];
+    slot->task = task->id;
+    slot->index = index;
+    slot->offset = pio_add_program(pio, &program);
+    slot->length = desc->length;
+    slot->origin = desc->origin;
+    slot->refs = 1;
+    return free_slot;
+}
+
+static void pio_put_program(uint32_t pio_index, uint8_t prog) {
+    MimicPioProg* slot = &pio_progs[pio_index][prog];
+    if (--slot->refs > 0) return;
+    
+    // Removal only looks at the footprint, not the instructions
+    pio_program_t program = {
+        .instructions = NULL,
+        .length = slot->length,
+        .origin = slot->origin,
+    };
+    pio_remove_program(pio_get_instance(pio_index), &program, slot->offset);
+    memset(slot, 0, sizeof(MimicPioProg));
+}
+
+// ============================================================================
+// STATE MACHINES
+// ============================================================================
+
+static int pio_claim(uint32_t task_id, uint32_t which) {
+    for (uint32_t p = 0; p < NUM_PIOS; p++) {
+        if (which != (uint32_t)-1 && which != p) continue;
+        
+        int sm = pio_claim_unused_sm(pio_get_instance(p), false);
+        if (sm < 0) continue;
+        
+        pio_sms[p][sm].task = task_id;
+        pio_sms[p][sm].prog = PIO_NO_PROGRAM;
+        return p * PIO_SM_PER_BLOCK + sm;
+    }
+    return which == (uint32_t)-1 || which < NUM_PIOS ? MIMIC_ERR_BUSY : MIMIC_ERR_INVAL;
+}
+
+static void pio_stop(uint32_t pio_index, uint32_t sm) {
+    MimicPioSm* s = &pio_sms[pio_index][sm];
+    pio_sm_set_enabled(pio_get_instance(pio_index), sm, false);
+    
+    if (s->prog != PIO_NO_PROGRAM) {
+        pio_put_program(pio_index, s->prog);
+        s->prog = PIO_NO_PROGRAM;
+    }
+}
+
+static bool pio_pins_ok(uint32_t base, uint32_t count) {
+    return count == 0 || base == MIMIC_PIO_PIN_NONE || base + count <= NUM_BANK0_GPIOS;
+}
+
+// Hand count pins from base to this PIO and make them outputs
+static void pio_claim_pins(PIO pio, uint32_t sm, uint32_t base, uint32_t count) {
+    if (count == 0 || base == MIMIC_PIO_PIN_NONE) return;
+    
+    for (uint32_t pin = base; pin < base + count; pin++) {
+        pio_gpio_init(pio, pin);
+    }
+    pio_sm_set_consecutive_pindirs(pio, sm, base, count, true);
+}
+
+static int pio_load(MimicTCB* task, uint32_t id, const MimicPioConfig* cfg) {
+    uint32_t pio_index = id / PIO_SM_PER_BLOCK;
+    uint32_t sm = id % PIO_SM_PER_BLOCK;
+    
+    const MimiPioProgram* desc = pio_find_program(task, cfg->program);
+    if (!desc || desc->length == 0 || desc->length > MIMI_PIO_MAX_INSTR ||
+        desc->wrap_target >= desc->length || desc->wrap >= desc->length) {
+        return MIMIC_ERR_NOENT;
+    }
+    
+    uint32_t opt_bit = (desc->sideset_flags & MIMI_PIO_SIDESET_OPT) ? 1 : 0;
+    if (!pio_pins_ok(cfg->out_base, cfg->out_count) ||
+        !pio_pins_ok(cfg->set_base, cfg->set_count) ||
+        !pio_pins_ok(cfg->sideset_base, desc->sideset_bits)) {
+        return MIMIC_ERR_INVAL;
+    }
+    
+    // Reloading a running state machine replaces its program
+    pio_stop(pio_index, sm);
+    
+    int prog = pio_get_program(pio_index, task, cfg->program, desc);
+    if (prog < 0) return prog;
+    pio_sms[pio_index][sm].prog = prog;
+    
+    PIO pio = pio_get_instance(pio_index);
+    uint32_t offset = pio_progs[pio_index][prog].offset;
+    
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + desc->wrap_target, offset + desc->wrap);
+    
+    if (desc->sideset_bits) {
+        sm_config_set_sideset(&c, desc->sideset_bits + opt_bit,
+                              desc->sideset_flags & MIMI_PIO_SIDESET_OPT,
+                              desc->sideset_flags & MIMI_PIO_SIDESET_PINDIRS);
+        if (cfg->sideset_base != MIMIC_PIO_PIN_NONE) {
+            sm_config_set_sideset_pins(&c, cfg->sideset_base);
+        }
+    }
+    if (cfg->out_count && cfg->out_base != MIMIC_PIO_PIN_NONE) {
+        sm_config_set_out_pins(&c, cfg->out_base, cfg->out_count);
+    }
+    if (cfg->set_count && cfg->set_base != MIMIC_PIO_PIN_NONE) {
+        sm_config_set_set_pins(&c, cfg->set_base, cfg->set_count);
+    }
+    if (cfg->in_base < NUM_BANK0_GPIOS) sm_config_set_in_pins(&c, cfg->in_base);
+    if (cfg->jmp_pin < NUM_BANK0_GPIOS) sm_config_set_jmp_pin(&c, cfg->jmp_pin);
+    
+    uint32_t threshold = cfg->out_shift & 0x3F;
+    sm_config_set_out_shift(&c, cfg->out_shift & MIMIC_PIO_SHIFT_RIGHT,
+                            cfg->out_shift & MIMIC_PIO_SHIFT_AUTO, threshold ? threshold : 32);
+    threshold = cfg->in_shift & 0x3F;
+    sm_config_set_in_shift(&c, cfg->in_shift & MIMIC_PIO_SHIFT_RIGHT,
+                           cfg->in_shift & MIMIC_PIO_SHIFT_AUTO, threshold ? threshold : 32);
+    if (cfg->fifo_join <= 2) sm_config_set_fifo_join(&c, cfg->fifo_join);
+    
+    uint32_t div = cfg->clkdiv ? cfg->clkdiv : 0x100;
+    sm_config_set_clkdiv_int_frac(&c, div >> 8, div & 0xFF);
+    
+    pio_claim_pins(pio, sm, cfg->out_base, cfg->out_count);
+    pio_claim_pins(pio, sm, cfg->set_base, cfg->set_count);
+    if (desc->sideset_bits) {
+        pio_claim_pins(pio, sm, cfg->sideset_base, desc->sideset_bits);
+    }
+    
+    pio_sm_init(pio, sm, offset, &c);
+    pio_sm_set_enabled(pio, sm, true);
+    return offset;
+}
+
+static void pio_release(uint32_t id) {
+    uint32_t pio_index = id / PIO_SM_PER_BLOCK;
+    uint32_t sm = id % PIO_SM_PER_BLOCK;
+    
+    // DMA still pointed at the FIFOs would outlive the claim
+    mimic_io_pio_abort(pio_index, sm);
+    pio_stop(pio_index, sm);
+    pio_sm_clear_fifos(pio_get_instance(pio_index), sm);
+    pio_sm_unclaim(pio_get_instance(pio_index), sm);
+    pio_sms[pio_index][sm].task = 0;
+}
+
+// ============================================================================
+// SYSCALLS
+// ============================================================================
+
+int32_t mimic_pio_syscall(uint32_t task_id, uint32_t num,
+                          uint32_t a0, uint32_t a1, uint32_t a2) {
+    MimicTCB* task = mimic_task_get(task_id);
+    if (!task || task_id == 0) return MIMIC_ERR_PERM;
+    
+    if (num == MIMIC_SYS_PIO_CLAIM) return pio_claim(task_id, a0);
+    if (!pio_sm_owned(task_id, a0)) return MIMIC_ERR_INVAL;
+    
+    switch (num) {
+        case MIMIC_SYS_PIO_LOAD:
+            if (!a1) return MIMIC_ERR_INVAL;
+            return pio_load(task, a0, (const MimicPioConfig*)a1);
+            
+        case MIMIC_SYS_PIO_PUT:
+            return mimic_io_pio_xfer(task_id, a0 / PIO_SM_PER_BLOCK, a0 % PIO_SM_PER_BLOCK,
+                                     (const uint32_t*)a1, NULL, a2);
+                                     
+        case MIMIC_SYS_PIO_GET:
+            return mimic_io_pio_xfer(task_id, a0 / PIO_SM_PER_BLOCK, a0 % PIO_SM_PER_BLOCK,
+                                     NULL, (uint32_t*)a1, a2);
+                                     
+        case MIMIC_SYS_PIO_RELEASE:
+            pio_release(a0);
+            return MIMIC_OK;
+            
+        default:
+            return MIMIC_ERR_NOSYS;
+    }
+}
+
+void mimic_pio_release_task(uint32_t task_id) {
+    if (task_id == 0) return;
+    
+    for (uint32_t id = 0; id < NUM_PIOS * PIO_SM_PER_BLOCK; id++) {
+        if (pio_sm_owned(task_id, id)) pio_release(id);
+    }
+}
@@ -0,0 +1,118 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  MimiC Trace - Event rings and SD dump                                    ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  Recording is inline in mimic_trace.h; this file owns the rings           ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ */
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include "mimic.h"
+#include "mimic_fat32.h"
+#include "mimic_trace.h"
+
+// ============================================================================
+// RINGS
+// ============================================================================
+
+#if MIMIC_TRACE_ENABLED
+MimicTraceRing mimic_trace_rings[MIMIC_CORE_COUNT];
+#endif
+
+volatile bool mimic_trace_on = MIMIC_TRACE_ENABLED;
+
+void mimic_trace_enable(bool on) {
+    mimic_trace_on = on && MIMIC_TRACE_ENABLED;
+}
+
+void mimic_trace_clear(void) {
+#if MIMIC_TRACE_ENABLED
+    for (uint32_t core = 0; core < MIMIC_CORE_COUNT; core++) {
+        mimic_trace_rings[core].head = 0;
+    }
+#endif
+}
+
+uint32_t mimic_trace_count(uint32_t core) {
+#if MIMIC_TRACE_ENABLED
+    if (core >= MIMIC_CORE_COUNT) return 0;
+    uint32_t head = mimic_trace_rings[core].head;
+    return head < MIMIC_TRACE_ENTRIES ? head : MIMIC_TRACE_ENTRIES;
+#else
+    (void)core;
+    return 0;
+#endif
+}
+
+// ============================================================================
+// DUMP
+// ============================================================================
+
+int mimic_trace_dump(const char* path) {
+#if MIMIC_TRACE_ENABLED
+    // Stop recording so the rings hold still while they are written out;
+    // the SD driver would otherwise trace its own writes into them.
+    bool was_on = mimic_trace_on;
+    mimic_trace_on = false;
+    
+    int fd = mimic_fopen(path, MIMIC_FILE_WRITE | MIMIC_FILE_CREATE | MIMIC_FILE_TRUNC);
+    if (fd < 0) {
+        mimic_trace_on = was_on;
+        return fd;
+    }
+    
+    MimicTraceFileHeader hdr = {
+        .magic = MIMIC_TRACE_MAGIC,
+        .version = MIMIC_TRACE_VERSION,
+        .record_size = sizeof(MimicTraceRecord),
+        .cores = MIMIC_CORE_COUNT,
+        .name_count = MIMIC_MAX_TASKS,
+    };
+    mimic_fwrite(fd, &hdr, sizeof(hdr));
+    
+    // Task names as they are now; slots reused since are misattributed
+    for (uint32_t i = 0; i < MIMIC_MAX_TASKS; i++) {
+        char name[16] = {0};
+        MimicTCB* t = mimic_task_get(i);
+        if (t) strncpy(name, t->name, sizeof(name) - 1);
+        mimic_fwrite(fd, name, sizeof(name));
+    }
+    
+    int err = MIMIC_OK;
+    for (uint32_t core = 0; core < MIMIC_CORE_COUNT && err == MIMIC_OK; core++) {
+        MimicTraceRing* ring = &mimic_trace_rings[core];
+        uint32_t count = mimic_trace_count(core);
+        uint32_t first = ring->head - count;
+        
+        mimic_fwrite(fd, &count, sizeof(count));
+        
+        // Oldest first: up to two contiguous runs of the ring
+        uint32_t start = first & (MIMIC_TRACE_ENTRIES - 1);
+        uint32_t run = MIMIC_TRACE_ENTRIES - start;
+        if (run > count) run = count;
+        
+        uint32_t bytes = run * sizeof(MimicTraceRecord);
+        if (mimic_fwrite(fd, &ring->records[start], bytes) != (int)bytes) {
+            err = MIMIC_ERR_IO;
+        }
+        
+        bytes = (count - run) * sizeof(MimicTraceRecord);
+        if (err == MIMIC_OK && bytes > 0 &&
+            mimic_fwrite(fd, &ring->records[0], bytes) != (int)bytes) {
+            err = MIMIC_ERR_IO;
+        }
+    }
+    
+    mimic_fclose(fd);
+    mimic_trace_on = was_on;
+    return err;
+#else
+    (void)path;
+    return MIMIC_ERR_NOSYS;
+#endif
+}
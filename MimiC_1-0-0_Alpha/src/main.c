@@ -7,11 +7,21 @@
  */
 
 #include "pico/stdlib.h"
+#include "pico/stdio/driver.h"
+
+#if LIB_PICO_STDIO_USB
+#include "pico/stdio_usb.h"
+#endif
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "mimic.h"
 #include "mimic_fat32.h"
+#include "mimic_tmpfs.h"
+#include "mimic_trace.h"
+#include "mimic_perf.h"
 
 // ============================================================================
 // BANNER
@@ -29,6 +39,51 @@ static void print_banner(void) {
     printf("\n");
 }
 
+// ============================================================================
+// BOOT STATE
+// ============================================================================
+
+enum {
+    BOOT_KERNEL,
+    BOOT_MOUNT,
+    BOOT_AUTORUN,
+    BOOT_PHASES
+};
+
+static const char* const boot_phase_names[BOOT_PHASES] = {
+    "kernel", "mount", "autorun"
+};
+
+static uint32_t boot_done_us[BOOT_PHASES];  // Time since reset at phase end
+static int boot_mount_err;
+static int boot_autorun_count;
+
+// Autorun failures, held until the console is up to report them
+static struct {
+    char        path[48];
+    int         err;
+} boot_autorun_failed[MIMIC_AUTORUN_MAX];
+static int boot_autorun_failures;
+static bool boot_autorun_truncated;
+
+// Output printed before the console exists (kernel init, mount, autorun);
+// a stdio driver of its own until console_thread replays it
+static char boot_log[MIMIC_BOOT_LOG_SIZE];
+static uint32_t boot_log_len;
+static uint32_t boot_log_lost;
+
+static void boot_log_out(const char* buf, int len) {
+    uint32_t room = sizeof(boot_log) - boot_log_len;
+    uint32_t n = (uint32_t)len < room ? (uint32_t)len : room;
+    memcpy(boot_log + boot_log_len, buf, n);
+    boot_log_len += n;
+    boot_log_lost += len - n;
+}
+
+static stdio_driver_t boot_log_driver = {
+    .out_chars = boot_log_out,
+};
+
 // ============================================================================
 // SHELL COMMANDS
 // ============================================================================
@@ -51,10 +106,12 @@ static int cmd_mem(int argc, char* argv[]);
 static int cmd_tasks(int argc, char* argv[]);
 static int cmd_info(int argc, char* argv[]);
 static int cmd_test(int argc, char* argv[]);
-
-// From mimic_compiler.c
-int mimic_compile(const char* input, const char* output);
-const char* mimic_compile_error(void);
+static int cmd_jobs(int argc, char* argv[]);
+static int cmd_watch(int argc, char* argv[]);
+static int cmd_make(int argc, char* argv[]);
+static int cmd_trace(int argc, char* argv[]);
+static int cmd_perf(int argc, char* argv[]);
+static int cmd_irq(int argc, char* argv[]);
 
 static const Command commands[] = {
     {"help",    "Show this help message",           cmd_help},
@@ -63,9 +120,15 @@ static const Command commands[] = {
     {"cc",      "Compile C source file",            cmd_cc},
     {"run",     "Load and run .mimi binary",        cmd_run},
     {"mem",     "Show memory usage",                cmd_mem},
-    {"tasks",   "Show running tasks",               cmd_tasks},
+    {"tasks",   "Show running tasks (-v: stacks)",  cmd_tasks},
     {"info",    "Show system information",          cmd_info},
     {"test",    "Run compiler tests",               cmd_test},
+    {"jobs",    "Show background compile progress", cmd_jobs},
+    {"watch",   "Auto-rebuild sources on change",   cmd_watch},
+    {"make",    "Build a project on both cores",    cmd_make},
+    {"trace",   "Kernel event trace (on/off/dump)", cmd_trace},
+    {"perf",    "Kernel counters and rates",        cmd_perf},
+    {"irq",     "User IRQ handlers and latency",    cmd_irq},
     {NULL, NULL, NULL}
 };
 
@@ -115,12 +178,25 @@ static int cmd_cat(int argc, char* argv[]) {
         return -1;
     }
     
-    char buf[128];
-    int n;
     printf("\n");
-    while ((n = mimic_fread(fd, buf, sizeof(buf) - 1)) > 0) {
-        buf[n] = '\0';
-        printf("%s", buf);
+    
+    // Print straight out of the cached sectors; tmpfs files can't be mapped
+    MimicFileView view;
+    uint32_t offset = 0;
+    int err;
+    while ((err = mimic_fmap(fd, offset, UINT32_MAX, &view)) == MIMIC_OK && view.len > 0) {
+        printf("%.*s", (int)view.len, (const char*)view.data);
+        offset += view.len;
+        mimic_funmap(&view);
+    }
+    
+    if (err == MIMIC_ERR_NOSYS) {
+        char buf[128];
+        int n;
+        while ((n = mimic_fread(fd, buf, sizeof(buf) - 1)) > 0) {
+            buf[n] = '\0';
+            printf("%s", buf);
+        }
     }
     printf("\n");
     
@@ -129,8 +205,18 @@ static int cmd_cat(int argc, char* argv[]) {
 }
 
 static int cmd_cc(int argc, char* argv[]) {
-    if (argc < 2) {
-        printf("Usage: cc <source.c> [output.mimi]\n");
+    bool background = false;
+    bool run = false;
+    while (argc > 1 && argv[1][0] == '-') {
+        if (strcmp(argv[1], "-b") == 0) background = true;
+        else if (strcmp(argv[1], "-r") == 0) run = true;
+        else break;
+        argc--;
+        argv++;
+    }
+    
+    if (argc < 2 || (background && run)) {
+        printf("Usage: cc [-b | -r] <source.c> [output.mimi]\n");
         return -1;
     }
     
@@ -139,6 +225,7 @@ static int cmd_cc(int argc, char* argv[]) {
     
     if (argc >= 3) {
         strncpy(output, argv[2], 63);
+        output[63] = '\0';
     } else {
         // Generate output name
         strncpy(output, input, 59);
@@ -147,8 +234,45 @@ static int cmd_cc(int argc, char* argv[]) {
         else strcat(output, ".mimi");
     }
     
+    if (background) {
+        int task_id = mimic_compile_bg(input, output);
+        if (task_id == MIMIC_ERR_BUSY) {
+            printf("Error: Compiler busy (see 'jobs')\n");
+        } else if (task_id < 0) {
+            printf("Error: %s\n", mimic_compile_error());
+        } else {
+            printf("Compiling %s -> %s in background (task %d)\n", input, output, task_id);
+        }
+        return task_id < 0 ? task_id : 0;
+    }
+    
+    if (run) {
+        // Compile into RAM and start it there; the card copy is written
+        // behind the running program.
+        uint8_t* image;
+        uint32_t size;
+        int err = mimic_compile_mem(input, output, &image, &size);
+        if (err != MIMIC_OK) {
+            printf("Error: %s\n", mimic_compile_error());
+            return err;
+        }
+        
+        int task_id = mimic_task_spawn((const MimiHeader*)image,
+                                       image + sizeof(MimiHeader), MIMIC_PRIO_USER);
+        if (task_id < 0) {
+            printf("Error: Failed to start program (%d)\n", task_id);
+        } else {
+            printf("Started task %d, saving %s in background\n", task_id, output);
+        }
+        
+        mimic_persist(output, image, size);
+        return task_id < 0 ? task_id : 0;
+    }
+    
     int err = mimic_compile(input, output);
-    if (err == MIMIC_OK) {
+    if (err == MIMIC_ERR_BUSY) {
+        printf("Error: Compiler busy (see 'jobs')\n");
+    } else if (err == MIMIC_OK) {
         printf("Compiled: %s -> %s\n", input, output);
     } else {
         printf("Error: %s\n", mimic_compile_error());
@@ -182,8 +306,10 @@ static int cmd_mem(int argc, char* argv[]) {
 }
 
 static int cmd_tasks(int argc, char* argv[]) {
-    (void)argc; (void)argv;
     mimic_dump_tasks();
+    if (argc > 1 && strcmp(argv[1], "-v") == 0) {
+        mimic_dump_stacks();
+    }
     return 0;
 }
 
@@ -192,6 +318,7 @@ static int cmd_info(int argc, char* argv[]) {
     printf("\n=== SYSTEM INFO ===\n");
     printf("Chip:        " MIMIC_CHIP_NAME "\n");
     printf("Uptime:      %lu ms\n", (unsigned long)mimic_get_uptime_ms());
+    printf("Boot:        %lu us to autorun\n", (unsigned long)boot_done_us[BOOT_AUTORUN]);
     printf("Free memory: %lu bytes\n", (unsigned long)mimic_get_free_memory());
     printf("Tasks:       %lu\n", (unsigned long)mimic_get_task_count());
     
@@ -202,8 +329,28 @@ static int cmd_info(int argc, char* argv[]) {
             printf("Total:       %llu MB\n", info.total_bytes / (1024*1024));
             printf("Free:        %llu MB\n", info.free_bytes / (1024*1024));
             printf("Cluster:     %lu bytes\n", (unsigned long)info.cluster_size);
+            printf("To erase:    %lu clusters\n", (unsigned long)mimic_fat32_erase_pending());
         }
     }
+    
+    if (mimic_sd_present()) {
+        MimicSdStats sd;
+        mimic_sd_get_stats(&sd);
+        printf("\n=== SD CARD ===\n");
+        printf("Clock:       %lu Hz, CRC %s\n", (unsigned long)sd.baud, sd.crc ? "on" : "off");
+        printf("CRC errors:  %lu read, %lu write, %lu cmd\n", (unsigned long)sd.read_crc_errors,
+               (unsigned long)sd.write_crc_errors, (unsigned long)sd.cmd_crc_errors);
+        printf("Retries:     %lu (%lu failed)\n", (unsigned long)sd.retries,
+               (unsigned long)sd.failures);
+    }
+    
+    MimicTmpfsInfo tmp;
+    mimic_tmpfs_info(&tmp);
+    printf("\n=== TMPFS (" MIMIC_TMPFS_ROOT ") ===\n");
+    printf("Files:       %lu, %lu bytes\n", (unsigned long)tmp.files, (unsigned long)tmp.bytes);
+    printf("Blocks:      %lu used, %lu pooled, %lu max\n", (unsigned long)tmp.blocks,
+           (unsigned long)tmp.pooled, (unsigned long)(MIMIC_TMPFS_BUDGET / MIMIC_TMPFS_BLOCK));
+    printf("Spills:      %lu\n", (unsigned long)tmp.spills);
     printf("\n");
     return 0;
 }
@@ -274,6 +421,163 @@ static int cmd_test(int argc, char* argv[]) {
     return 0;
 }
 
+static int cmd_jobs(int argc, char* argv[]) {
+    (void)argc; (void)argv;
+    
+    MimicCompileProgress p;
+    if (mimic_compile_progress(&p) != MIMIC_OK) {
+        printf("No compile jobs\n");
+        return 0;
+    }
+    
+    uint32_t pct = p.bytes_total ? (p.bytes_in * 100) / p.bytes_total : 0;
+    
+    printf("\n=== COMPILE JOB ===\n");
+    printf("Source:      %s -> %s\n", p.input, p.output);
+    if (p.active) {
+        printf("State:       running (task %d), %lu%%\n", p.task_id, (unsigned long)pct);
+    } else {
+        printf("State:       %s (%d)\n", p.result == MIMIC_OK ? "done" : "failed", p.result);
+    }
+    printf("Line:        %lu\n", (unsigned long)p.line);
+    printf("Tokens:      %lu\n", (unsigned long)p.tokens);
+    printf("Functions:   %lu\n", (unsigned long)p.functions);
+    printf("Input:       %lu / %lu bytes\n", (unsigned long)p.bytes_in, (unsigned long)p.bytes_total);
+    printf("Output:      %lu bytes\n", (unsigned long)p.bytes_out);
+    printf("Elapsed:     %lu ms\n\n", (unsigned long)p.elapsed_ms);
+    return 0;
+}
+
+static int cmd_watch(int argc, char* argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "start") == 0) {
+        bool restart = argc >= 3 && strcmp(argv[2], "-r") == 0;
+        int task_id = mimic_watch_start(restart);
+        if (task_id < 0) {
+            printf("Error: Cannot start watcher (%d)\n", task_id);
+            return -1;
+        }
+        printf("Watching %s -> %s (task %d%s)\n", MIMIC_CC_SRC_DIR, MIMIC_CC_BIN_DIR,
+               task_id, restart ? ", hot restart" : "");
+        return 0;
+    }
+    
+    if (argc >= 2 && strcmp(argv[1], "stop") == 0) {
+        mimic_watch_stop();
+        printf("Watcher stopped\n");
+        return 0;
+    }
+    
+    if (argc >= 2) {
+        printf("Usage: watch [start [-r] | stop]\n");
+        return -1;
+    }
+    
+    MimicWatchStatus st;
+    mimic_watch_status(&st);
+    printf("\n=== WATCHER ===\n");
+    if (st.running) {
+        printf("State:       running (task %d)%s\n", st.task_id,
+               st.hot_restart ? ", hot restart" : "");
+    } else {
+        printf("State:       stopped\n");
+    }
+    printf("Files:       %lu (%lu pending)\n", (unsigned long)st.files, (unsigned long)st.pending);
+    printf("Scans:       %lu\n", (unsigned long)st.scans);
+    printf("Rebuilds:    %lu (%lu failed)\n", (unsigned long)st.rebuilds, (unsigned long)st.failures);
+    printf("Restarts:    %lu\n\n", (unsigned long)st.restarts);
+    return 0;
+}
+
+static int cmd_make(int argc, char* argv[]) {
+    const char* manifest = argc >= 2 ? argv[1] : MIMIC_MAKE_MANIFEST;
+    
+    int task_id = mimic_make(manifest);
+    if (task_id == MIMIC_ERR_BUSY) {
+        printf("Error: A make is already running\n");
+        return -1;
+    }
+    if (task_id < 0) {
+        printf("Error: Cannot start make from %s (%d)\n", manifest, task_id);
+        return -1;
+    }
+    
+    printf("Building %s (task %d)\n", manifest, task_id);
+    return 0;
+}
+
+static int cmd_trace(int argc, char* argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "on") == 0) {
+        mimic_trace_enable(true);
+    } else if (argc >= 2 && strcmp(argv[1], "off") == 0) {
+        mimic_trace_enable(false);
+    } else if (argc >= 2 && strcmp(argv[1], "clear") == 0) {
+        mimic_trace_clear();
+    } else if (argc >= 2 && strcmp(argv[1], "dump") == 0) {
+        const char* path = argc >= 3 ? argv[2] : MIMIC_TRACE_FILE;
+        int err = mimic_trace_dump(path);
+        if (err != MIMIC_OK) {
+            printf("Error: Cannot dump trace to %s (%d)\n", path, err);
+            return -1;
+        }
+        printf("Trace written to %s\n", path);
+        return 0;
+    } else if (argc >= 2) {
+        printf("Usage: trace [on | off | clear | dump [file]]\n");
+        return -1;
+    }
+    
+    printf("Trace: %s", mimic_trace_on ? "on" : "off");
+    for (uint32_t core = 0; core < MIMIC_CORE_COUNT; core++) {
+        printf(", core %lu: %lu events", (unsigned long)core,
+               (unsigned long)mimic_trace_count(core));
+    }
+    printf("\n");
+    return 0;
+}
+
+static int cmd_perf(int argc, char* argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "reset") == 0) {
+        mimic_perf_reset();
+        printf("Counters reset\n");
+        return 0;
+    }
+    
+    uint32_t interval_ms = argc >= 2 ? (uint32_t)atoi(argv[1]) : 1000;
+    if (interval_ms == 0) {
+        printf("Usage: perf [interval_ms | reset]\n");
+        return -1;
+    }
+    
+    static uint32_t before[MIMIC_PERF_COUNT];
+    static uint32_t after[MIMIC_PERF_COUNT];
+    
+    // Keep background work running while we sample, or the rates are 0
+    mimic_perf_snapshot(before);
+    uint32_t start = mimic_get_uptime_ms();
+    while (mimic_get_uptime_ms() - start < interval_ms) {
+        mimic_kernel_poll();
+    }
+    uint32_t elapsed = mimic_get_uptime_ms() - start;
+    mimic_perf_snapshot(after);
+    
+    printf("\n=== PERF (%lu ms) ===\n", (unsigned long)elapsed);
+    printf("%-22s %12s %10s %10s\n", "COUNTER", "TOTAL", "DELTA", "PER SEC");
+    for (uint32_t id = 0; id < MIMIC_PERF_COUNT; id++) {
+        uint32_t delta = after[id] - before[id];
+        printf("%-22s %12lu %10lu %10lu\n", mimic_perf_name(id),
+               (unsigned long)after[id], (unsigned long)delta,
+               (unsigned long)((uint64_t)delta * 1000 / elapsed));
+    }
+    printf("\n");
+    return 0;
+}
+
+static int cmd_irq(int argc, char* argv[]) {
+    (void)argc; (void)argv;
+    mimic_irq_dump();
+    return 0;
+}
+
 // ============================================================================
 // SHELL
 // ============================================================================
@@ -304,12 +608,13 @@ static void shell_loop(void) {
     char buf[CMD_BUF_SIZE];
     int pos = 0;
     
-    printf("mimic> ");
-    
+    // The console thread prints the first prompt once the host is there
     while (true) {
-        int c = getchar();
+        // Don't block on input: the kernel threads (background compiles)
+        // only make progress while we poll the scheduler here.
+        int c = getchar_timeout_us(0);
         if (c == PICO_ERROR_TIMEOUT) {
-            tight_loop_contents();
+            mimic_kernel_poll();
             continue;
         }
         
@@ -334,42 +639,137 @@ static void shell_loop(void) {
 }
 
 // ============================================================================
-// MAIN
+// BOOT
 // ============================================================================
 
-int main(void) {
-    stdio_init_all();
+static void boot_mark(int phase) {
+    boot_done_us[phase] = time_us_32();
+}
+
+// Start every program listed in the autorun file. Lines are .mimi paths;
+// blank lines and '#' comments are skipped. Returns programs started.
+static int boot_autorun(void) {
+    static char list[MIMIC_AUTORUN_LIST];
+    
+    int fd = mimic_fopen(MIMIC_AUTORUN_FILE, MIMIC_FILE_READ);
+    if (fd < 0) return 0;
+    int len = mimic_fread(fd, list, sizeof(list) - 1);
+    boot_autorun_truncated = len > 0 && mimic_fsize(fd) > len;
+    mimic_fclose(fd);
+    if (len <= 0) return 0;
+    list[len] = '\0';
+    
+    // Don't try to start half a path
+    if (boot_autorun_truncated) {
+        char* cut = strrchr(list, '\n');
+        if (cut) *cut = '\0';
+    }
     
-    // Wait for USB connection
-    sleep_ms(2000);
+    int started = 0;
+    char* save;
+    char* line = strtok_r(list, "\r\n", &save);
+    for (; line && started < MIMIC_AUTORUN_MAX; line = strtok_r(NULL, "\r\n", &save)) {
+        while (*line == ' ' || *line == '\t') line++;
+        char* end = line + strlen(line);
+        while (end > line && (end[-1] == ' ' || end[-1] == '\t')) *--end = '\0';
+        if (*line == '\0' || *line == '#') continue;
+        
+        int task_id = mimic_task_load(line, MIMIC_PRIO_USER);
+        if (task_id < 0) {
+            if (boot_autorun_failures < MIMIC_AUTORUN_MAX) {
+                strncpy(boot_autorun_failed[boot_autorun_failures].path, line,
+                        sizeof(boot_autorun_failed[0].path) - 1);
+                boot_autorun_failed[boot_autorun_failures].err = task_id;
+            }
+            boot_autorun_failures++;
+            continue;
+        }
+        started++;
+    }
+    return started;
+}
+
+// Bring up the console once the programs are running: USB enumeration,
+// the banner and the boot report all happen here, off the critical path.
+static int console_thread(void* arg) {
+    static bool stdio_up;
+    (void)arg;
+    
+    if (!stdio_up) {
+        stdio_init_all();
+        stdio_up = true;
+    }
+    
+#if LIB_PICO_STDIO_USB
+    // Output before the host opens the port would just be discarded
+    if (!stdio_usb_connected()) {
+        mimic_kthread_sleep(MIMIC_CONSOLE_POLL_MS);
+        return MIMIC_ERR_BUSY;
+    }
+#endif
     
+    stdio_set_driver_enabled(&boot_log_driver, false);
     print_banner();
+    stdio_put_string(boot_log, boot_log_len, false, true);
+    if (boot_log_lost > 0) {
+        printf("[BOOT] ... %lu bytes of early output lost\n", (unsigned long)boot_log_lost);
+    }
     
-    // Initialize kernel
-    mimic_kernel_init();
     
-    // Mount filesystem
-    printf("[FS] Mounting SD card...\n");
-    int err = mimic_fat32_mount();
-    if (err == MIMIC_OK) {
+    printf("[BOOT]");
+    for (int i = 0; i < BOOT_PHASES; i++) {
+        printf(" %s %lu us%s", boot_phase_names[i],
+               (unsigned long)boot_done_us[i], i + 1 < BOOT_PHASES ? "," : "\n");
+    }
+    printf("[BOOT] %d autorun program(s) started\n", boot_autorun_count);
+    for (int i = 0; i < boot_autorun_failures && i < MIMIC_AUTORUN_MAX; i++) {
+        printf("[BOOT] autorun %s failed (%d)\n",
+               boot_autorun_failed[i].path, boot_autorun_failed[i].err);
+    }
+    if (boot_autorun_failures > MIMIC_AUTORUN_MAX) {
+        printf("[BOOT] ... and %d more failed\n", boot_autorun_failures - MIMIC_AUTORUN_MAX);
+    }
+    if (boot_autorun_truncated) {
+        printf("[BOOT] %s is longer than %d bytes; the rest was ignored\n",
+               MIMIC_AUTORUN_FILE, MIMIC_AUTORUN_LIST - 1);
+    }
+    mimic_mpu_report();
+    
+    if (boot_mount_err == MIMIC_OK) {
         printf("[FS] SD card mounted successfully!\n");
-        
-        // Show some info
-        MimicFSInfo info;
-        if (mimic_fs_info(&info) == MIMIC_OK) {
-            printf("[FS] Total: %llu MB, Free: %llu MB\n", 
-                   info.total_bytes / (1024*1024),
-                   info.free_bytes / (1024*1024));
-        }
     } else {
-        printf("[FS] Mount failed (error %d)\n", err);
+        printf("[FS] Mount failed (error %d)\n", boot_mount_err);
         printf("[FS] Check SD card and wiring:\n");
         printf("     CS=%d, MOSI=%d, MISO=%d, SCK=%d\n",
                MIMIC_SD_CS, MIMIC_SD_MOSI, MIMIC_SD_MISO, MIMIC_SD_SCK);
     }
     
-    // Start shell
     printf("\nType 'help' for commands\n\n");
+    printf("mimic> ");
+    return MIMIC_OK;
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(void) {
+    // Autorun programs first; console and diagnostics follow in the
+    // background. Free space is left to 'info' since it scans the whole FAT.
+    stdio_set_driver_enabled(&boot_log_driver, true);
+    mimic_kernel_init();
+    boot_mark(BOOT_KERNEL);
+    
+    boot_mount_err = mimic_fat32_mount();
+    boot_mark(BOOT_MOUNT);
+    
+    if (boot_mount_err == MIMIC_OK) {
+        boot_autorun_count = boot_autorun();
+    }
+    boot_mark(BOOT_AUTORUN);
+    
+    mimic_kthread_spawn("console", MIMIC_PRIO_BACKGROUND, console_thread, NULL);
+    
     shell_loop();
     
     return 0;
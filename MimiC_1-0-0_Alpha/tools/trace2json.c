@@ -0,0 +1,193 @@
+/**
+ * ╔═══════════════════════════════════════════════════════════════════════════╗
+ * ║  trace2json - MimiC trace dump to Chrome trace-viewer JSON                ║
+ * ╠═══════════════════════════════════════════════════════════════════════════╣
+ * ║  Host tool: open the output in chrome://tracing or ui.perfetto.dev        ║
+ * ╚═══════════════════════════════════════════════════════════════════════════╝
+ * 
+ * Build:   cc -O2 -DMIMIC_TRACE_HOST -I../include -o trace2json trace2json.c
+ * Usage:   trace2json trace.bin [trace.json]
+ * 
+ * Each core becomes a thread. Kernel thread slices, compile jobs and SD
+ * commands become duration events; everything else is an instant event.
+ * Timestamps are unwrapped per core, so dumps spanning a 32-bit timer
+ * rollover (~71 minutes) still come out in order.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mimic_trace.h"
+
+static char names[256][17];
+static uint32_t name_count;
+
+static const char* task_name(uint32_t id) {
+    static char buf[16];
+    if (id < name_count && names[id][0]) return names[id];
+    snprintf(buf, sizeof(buf), "task %u", (unsigned)id);
+    return buf;
+}
+
+static void emit(FILE* out, int* first, const char* name, char ph,
+                 uint64_t ts, uint32_t core, const char* args) {
+    fprintf(out, "%s\n  {\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":0,\"tid\":%u",
+            *first ? "" : ",", name, ph, (unsigned long long)ts, (unsigned)core);
+    if (ph == 'i') fprintf(out, ",\"s\":\"t\"");
+    if (args) fprintf(out, ",\"args\":{%s}", args);
+    fprintf(out, "}");
+    *first = 0;
+}
+
+static void decode(FILE* out, int* first, uint32_t core,
+                   const MimicTraceRecord* r, uint64_t ts) {
+    char name[48];
+    char args[96];
+    
+    switch (r->event) {
+        case MIMIC_TRACE_SWITCH:
+            snprintf(args, sizeof(args), "\"from\":\"%s\"", task_name(r->a16));
+            snprintf(name, sizeof(name), "switch -> %s", task_name(r->arg));
+            emit(out, first, name, 'i', ts, core, args);
+            break;
+        case MIMIC_TRACE_KTHREAD_BEGIN:
+            emit(out, first, task_name(r->a16), 'B', ts, core, NULL);
+            break;
+        case MIMIC_TRACE_KTHREAD_END:
+            snprintf(args, sizeof(args), "\"result\":%d", (int32_t)r->arg);
+            emit(out, first, task_name(r->a16), 'E', ts, core, args);
+            break;
+        case MIMIC_TRACE_SYSCALL:
+            snprintf(name, sizeof(name), "syscall %u", (unsigned)r->a16);
+            snprintf(args, sizeof(args), "\"task\":\"%s\",\"a0\":%u",
+                     task_name(r->task), (unsigned)r->arg);
+            emit(out, first, name, 'i', ts, core, args);
+            break;
+        case MIMIC_TRACE_ALLOC:
+        case MIMIC_TRACE_FREE:
+            snprintf(args, sizeof(args), "\"owner\":\"%s\",\"%s\":%u",
+                     task_name(r->a16),
+                     r->event == MIMIC_TRACE_ALLOC ? "size" : "addr", (unsigned)r->arg);
+            emit(out, first, r->event == MIMIC_TRACE_ALLOC ? "alloc" : "free",
+                 'i', ts, core, args);
+            break;
+        case MIMIC_TRACE_SD_CMD:
+            snprintf(name, sizeof(name), "SD CMD%u", (unsigned)r->a16);
+            snprintf(args, sizeof(args), "\"arg\":%u", (unsigned)r->arg);
+            emit(out, first, name, 'B', ts, core, args);
+            break;
+        case MIMIC_TRACE_SD_DONE:
+            snprintf(name, sizeof(name), "SD CMD%u", (unsigned)(r->a16 & 0xFF));
+            snprintf(args, sizeof(args), "\"r1\":%u", (unsigned)(r->a16 >> 8));
+            emit(out, first, name, 'E', ts, core, args);
+            break;
+        case MIMIC_TRACE_CC_BEGIN:
+            emit(out, first, "compile", 'B', ts, core, NULL);
+            break;
+        case MIMIC_TRACE_CC_FUNC:
+            snprintf(args, sizeof(args), "\"line\":%u,\"code\":%u",
+                     (unsigned)r->a16, (unsigned)r->arg);
+            emit(out, first, "function", 'i', ts, core, args);
+            break;
+        case MIMIC_TRACE_CC_END:
+            snprintf(args, sizeof(args), "\"result\":%d", (int32_t)r->arg);
+            emit(out, first, "compile", 'E', ts, core, args);
+            break;
+        case MIMIC_TRACE_IRQ:
+            snprintf(name, sizeof(name), "irq %u", (unsigned)r->a16);
+            snprintf(args, sizeof(args), "\"task\":\"%s\",\"latency_us\":%u",
+                     task_name(r->task), (unsigned)r->arg);
+            emit(out, first, name, 'i', ts, core, args);
+            break;
+        default:
+            snprintf(name, sizeof(name), "event %u", (unsigned)r->event);
+            snprintf(args, sizeof(args), "\"task\":\"%s\",\"a16\":%u,\"arg\":%u",
+                     task_name(r->task), (unsigned)r->a16, (unsigned)r->arg);
+            emit(out, first, name, 'i', ts, core, args);
+            break;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s trace.bin [trace.json]\n", argv[0]);
+        return 1;
+    }
+    
+    FILE* in = fopen(argv[1], "rb");
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+    
+    MimicTraceFileHeader hdr;
+    if (fread(&hdr, sizeof(hdr), 1, in) != 1 || hdr.magic != MIMIC_TRACE_MAGIC) {
+        fprintf(stderr, "%s: not a MimiC trace\n", argv[1]);
+        return 1;
+    }
+    if (hdr.version != MIMIC_TRACE_VERSION || hdr.record_size != sizeof(MimicTraceRecord)) {
+        fprintf(stderr, "%s: unsupported trace version %u\n", argv[1], (unsigned)hdr.version);
+        return 1;
+    }
+    
+    for (uint32_t i = 0; i < hdr.name_count; i++) {
+        char name[16];
+        if (fread(name, sizeof(name), 1, in) != 1) {
+            fprintf(stderr, "%s: truncated\n", argv[1]);
+            return 1;
+        }
+        if (i < 256) {
+            memcpy(names[i], name, sizeof(name));
+            names[i][16] = '\0';
+        }
+    }
+    name_count = hdr.name_count < 256 ? hdr.name_count : 256;
+    
+    FILE* out = argc >= 3 ? fopen(argv[2], "w") : stdout;
+    if (!out) {
+        perror(argv[2]);
+        return 1;
+    }
+    
+    int first = 1;
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    
+    for (uint32_t core = 0; core < hdr.cores; core++) {
+        char args[32];
+        snprintf(args, sizeof(args), "\"name\":\"core %u\"", (unsigned)core);
+        emit(out, &first, "thread_name", 'M', 0, core, args);
+        
+        uint32_t count;
+        if (fread(&count, sizeof(count), 1, in) != 1) {
+            fprintf(stderr, "%s: truncated at core %u\n", argv[1], (unsigned)core);
+            break;
+        }
+        
+        uint64_t ts = 0;
+        uint32_t last = 0;
+        bool started = false;
+        for (uint32_t i = 0; i < count; i++) {
+            MimicTraceRecord r;
+            if (fread(&r, sizeof(r), 1, in) != 1) {
+                fprintf(stderr, "%s: truncated at core %u\n", argv[1], (unsigned)core);
+                break;
+            }
+            if (r.event == MIMIC_TRACE_NONE) continue;
+            
+            // Signed deltas: an IRQ can land between a slot being claimed
+            // and stamped, so neighbours may be a few us out of order.
+            ts = started ? ts + (int32_t)(r.time_us - last) : r.time_us;
+            last = r.time_us;
+            started = true;
+            decode(out, &first, core, &r, ts);
+        }
+    }
+    
+    fprintf(out, "\n]}\n");
+    if (out != stdout) fclose(out);
+    fclose(in);
+    return 0;
+}